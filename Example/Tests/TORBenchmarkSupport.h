@@ -0,0 +1,64 @@
+//
+//  TORBenchmarkSupport.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// MARK: Allocation Counting
+
+/**
+ Allocations counted since it was last reset to 0.
+ */
+extern _Atomic uint64_t TORBenchmarkAllocations;
+
+/**
+ Count the allocations of the current thread.
+ */
+extern __thread bool TORBenchmarkCountAllocations;
+
+/**
+ Count the allocations on the queue given to @c TORBenchmarkInstallMallocLogger.
+ */
+extern _Atomic bool TORBenchmarkCountQueueAllocations;
+
+/**
+ Hook into libmalloc's logger, which Instruments and `MallocStackLogging` use, to count allocations.
+ Call from @c +setUp of a benchmark class.
+
+ @param queueLabel The label of a queue to count allocations on, e.g. the control queue. NULL for none.
+ */
+extern void TORBenchmarkInstallMallocLogger(const char * _Nullable queueLabel);
+
+/**
+ Call from @c +tearDown of a benchmark class.
+ */
+extern void TORBenchmarkRemoveMallocLogger(void);
+
+
+/**
+ Helpers shared by the benchmarks.
+ */
+@interface TORBenchmarkSupport : NSObject
+
+/**
+ The physical memory footprint of this process, as Xcode's memory gauge shows it.
+ */
+@property (class, readonly) uint64_t footprint;
+
+/**
+ Sorts the given latencies in place.
+
+ @param latencies Latencies in nanoseconds.
+ @return p50, p90, p99 and max in ms, if max is at least 10 ms, in µs otherwise.
+ */
++ (NSString *)percentiles:(uint64_t *)latencies count:(NSUInteger)count;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,112 @@
+//
+//  TORBenchmarkSupport.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORBenchmarkSupport.h"
+
+#import <mach/mach.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// MARK: Allocation Counting
+
+// libmalloc's hook. Not in a public header.
+typedef void (malloc_logger_t)(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip);
+extern malloc_logger_t *malloc_logger;
+
+#define MALLOC_LOG_TYPE_ALLOCATE 2
+
+_Atomic uint64_t TORBenchmarkAllocations;
+__thread bool TORBenchmarkCountAllocations;
+_Atomic bool TORBenchmarkCountQueueAllocations;
+
+static const char *countedQueue;
+
+static void TORBenchmarkMallocLogger(uint32_t type, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t result, uint32_t num_hot_frames_to_skip)
+{
+    if (!(type & MALLOC_LOG_TYPE_ALLOCATE))
+    {
+        return;
+    }
+
+    if (TORBenchmarkCountAllocations)
+    {
+        atomic_fetch_add_explicit(&TORBenchmarkAllocations, 1, memory_order_relaxed);
+
+        return;
+    }
+
+    if (countedQueue && atomic_load_explicit(&TORBenchmarkCountQueueAllocations, memory_order_relaxed))
+    {
+        const char *label = dispatch_queue_get_label(DISPATCH_CURRENT_QUEUE_LABEL);
+
+        if (label && strcmp(label, countedQueue) == 0)
+        {
+            atomic_fetch_add_explicit(&TORBenchmarkAllocations, 1, memory_order_relaxed);
+        }
+    }
+}
+
+void TORBenchmarkInstallMallocLogger(const char * _Nullable queueLabel)
+{
+    countedQueue = queueLabel;
+    malloc_logger = TORBenchmarkMallocLogger;
+}
+
+void TORBenchmarkRemoveMallocLogger(void)
+{
+    malloc_logger = NULL;
+    countedQueue = NULL;
+}
+
+static int TORCompareUInt64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+
+@implementation TORBenchmarkSupport
+
++ (uint64_t)footprint
+{
+    task_vm_info_data_t info;
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+
+    if (task_info(mach_task_self(), TASK_VM_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+
+    return info.phys_footprint;
+}
+
++ (NSString *)percentiles:(uint64_t *)latencies count:(NSUInteger)count
+{
+    if (count < 1)
+    {
+        return @"-";
+    }
+
+    qsort(latencies, count, sizeof(uint64_t), TORCompareUInt64);
+
+    BOOL ms = latencies[count - 1] >= 10 * NSEC_PER_MSEC;
+    double divisor = ms ? NSEC_PER_MSEC : NSEC_PER_USEC;
+    NSString *unit = ms ? @"ms" : @"µs";
+
+    double (^at)(double) = ^double(double p) {
+        return (double)latencies[MIN(count - 1, (NSUInteger)(p * count))] / divisor;
+    };
+
+    return [NSString stringWithFormat:@"p50 %.1f %@, p90 %.1f %@, p99 %.1f %@, max %.1f %@",
+            at(0.5), unit, at(0.9), unit, at(0.99), unit, at(1), unit];
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
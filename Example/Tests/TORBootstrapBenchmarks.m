@@ -0,0 +1,126 @@
+//
+//  TORBootstrapBenchmarks.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+#import "TORBenchmarkSupport.h"
+
+/**
+ Measures how Tor starts with a populated cache directory: The time until the first circuit is
+ established and the peak memory footprint on the way there.
+
+ Compare builds with and without the patches in `Tor/patches` by building once with the
+ `TOR_SKIP_PATCHES=1` build setting (clean build).
+
+ The cache is populated on first run, which needs network access. Only one Tor can run per
+ process, so this is skipped, when another test already started one. Run it alone.
+ */
+@interface TORBootstrapBenchmarks : XCTestCase
+
+@end
+
+@implementation TORBootstrapBenchmarks
+
+- (void)testWarmBootstrap
+{
+    XCTSkipIf(TORThread.activeThread != nil, @"Another Tor is running in this process.");
+
+    const NSUInteger runs = 5;
+    uint64_t durations[runs];
+    uint64_t peaks[runs];
+
+    NSURL *directory = [[NSFileManager.defaultManager URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask].firstObject
+                        URLByAppendingPathComponent:@"tor-bootstrap-benchmark"];
+
+    TORConfiguration *configuration = [TORConfiguration new];
+    configuration.ignoreMissingTorrc = YES;
+    configuration.clientOnly = YES;
+    configuration.dataDirectory = [directory URLByAppendingPathComponent:@"data"];
+    configuration.cacheDirectory = [directory URLByAppendingPathComponent:@"cache"];
+
+    TORThread *thread = [[TORThread alloc] initWithConfiguration:configuration];
+
+    // Populate the cache, if needed. Not measured.
+    if (![NSFileManager.defaultManager fileExistsAtPath:
+          [configuration.cacheDirectory URLByAppendingPathComponent:@"cached-microdesc-consensus"].path])
+    {
+        [thread start];
+
+        [self waitForCircuitOn:thread timeout:120];
+
+        thread = [thread restartWithArguments:nil timeout:10];
+    }
+    else {
+        [thread start];
+    }
+
+    for (NSUInteger i = 0; i < runs; i++)
+    {
+        if (i > 0)
+        {
+            thread = [thread restartWithArguments:nil timeout:10];
+            XCTAssertNotNil(thread);
+        }
+
+        // The footprint peak of the process can't be reset, so sample it.
+        __block uint64_t peak = 0;
+
+        dispatch_queue_t queue = dispatch_queue_create("org.torproject.Tor.footprint", DISPATCH_QUEUE_SERIAL);
+        dispatch_source_t sampler = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+        dispatch_source_set_timer(sampler, DISPATCH_TIME_NOW, 5 * NSEC_PER_MSEC, NSEC_PER_MSEC);
+        dispatch_source_set_event_handler(sampler, ^{
+            peak = MAX(peak, TORBenchmarkSupport.footprint);
+        });
+        dispatch_resume(sampler);
+
+        uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+        [self waitForCircuitOn:thread timeout:60];
+
+        durations[i] = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+
+        dispatch_source_cancel(sampler);
+        dispatch_sync(queue, ^{});
+
+        peaks[i] = peak;
+    }
+
+    [thread stop];
+    XCTAssertTrue([thread joinWithTimeout:10]);
+
+    for (NSUInteger i = 0; i < runs; i++)
+    {
+        NSLog(@"[Bootstrap] run %lu: first circuit after %.0f ms, peak footprint %.1f MB",
+              (unsigned long)i + 1, (double)durations[i] / NSEC_PER_MSEC, (double)peaks[i] / 1024 / 1024);
+    }
+}
+
+
+// MARK: Helper Methods
+
+- (void)waitForCircuitOn:(TORThread *)thread timeout:(NSTimeInterval)timeout
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"circuit established"];
+
+    TORController *controller = [[TORController alloc] initWithControlSocket:[thread takeControlSocket]];
+
+    __block BOOL fulfilled = NO;
+
+    [controller addObserverForCircuitEstablished:^(BOOL established) {
+        if (established && !fulfilled)
+        {
+            fulfilled = YES;
+
+            [expectation fulfill];
+        }
+    }];
+
+    [self waitForExpectations:@[expectation] timeout:timeout];
+}
+
+@end
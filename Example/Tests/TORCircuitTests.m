@@ -0,0 +1,164 @@
+//
+//  TORCircuitTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+@interface TORCircuitTests : XCTestCase
+
+@end
+
+@implementation TORCircuitTests
+
+- (void)testParse {
+    TORCircuit *circuit = [[TORCircuit alloc] initFromString:
+                           @"12 BUILT $A1B2C3D4E5F60718293A4B5C6D7E8F9012345678~Relay1,$0123456789ABCDEF0123456789ABCDEF01234567=Relay2 "
+                           "BUILD_FLAGS=IS_INTERNAL,NEED_CAPACITY PURPOSE=HS_CLIENT_REND HS_STATE=HSCR_JOINED "
+                           "REND_QUERY=duskgytldkxiuqc6 TIME_CREATED=2023-11-20T10:02:51.713542 "
+                           "SOCKS_USERNAME=\"foo bar\" SOCKS_PASSWORD=\"a\\\"b\""];
+
+    XCTAssertEqualObjects(circuit.circuitId, @"12");
+    XCTAssertEqualObjects(circuit.status, TORCircuit.statusBuilt);
+    XCTAssertEqual(circuit.nodes.count, 2);
+    XCTAssertEqualObjects(circuit.nodes[0].fingerprint, @"$A1B2C3D4E5F60718293A4B5C6D7E8F9012345678");
+    XCTAssertEqualObjects(circuit.nodes[0].nickName, @"Relay1");
+    XCTAssertEqualObjects(circuit.nodes[1].nickName, @"Relay2");
+    XCTAssertEqualObjects(circuit.buildFlags, (@[TORCircuit.buildFlagIsInternal, TORCircuit.buildFlagNeedCapacity]));
+    XCTAssertEqualObjects(circuit.purpose, TORCircuit.purposeHsClientRend);
+    XCTAssertEqualObjects(circuit.hsState, TORCircuit.hsStateHscrJoined);
+    XCTAssertEqualObjects(circuit.rendQuery, @"duskgytldkxiuqc6");
+    XCTAssertEqualWithAccuracy(circuit.timeCreated.timeIntervalSince1970, 1700474571.713542, 0.000001);
+    XCTAssertEqualObjects(circuit.socksUsername, @"foo bar");
+    XCTAssertEqualObjects(circuit.socksPassword, @"a\"b");
+}
+
+- (void)testParseWithoutPath {
+    TORCircuit *circuit = [[TORCircuit alloc] initFromString:
+                           @"3 FAILED BUILD_FLAGS=NEED_CAPACITY PURPOSE=GENERAL REASON=TIMEOUT REMOTE_REASON=DESTROYED"];
+
+    XCTAssertEqualObjects(circuit.circuitId, @"3");
+    XCTAssertEqualObjects(circuit.status, TORCircuit.statusFailed);
+    XCTAssertNil(circuit.nodes);
+    XCTAssertEqualObjects(circuit.reason, TORCircuit.reasonTimeout);
+    XCTAssertEqualObjects(circuit.remoteReason, TORCircuit.reasonDestroyed);
+}
+
+- (void)testCircuitsFromString {
+    NSArray<TORCircuit *> *circuits = [TORCircuit circuitsFromString:[self.class statusWithCircuits:10]];
+
+    XCTAssertEqual(circuits.count, 10);
+    XCTAssertEqualObjects(circuits.lastObject.circuitId, @"10");
+}
+
+/**
+ The tokenizer needs to come to the same result as the old regular expression based parser.
+ */
+- (void)testMatchesRegexParser {
+    NSArray<NSString *> *lines = [[self.class statusWithCircuits:200] componentsSeparatedByString:@"\r\n"];
+
+    for (NSString *line in lines)
+    {
+        TORCircuit *expected = [[TORCircuit alloc] initWithRegexFromString:line];
+        TORCircuit *actual = [[TORCircuit alloc] initFromString:line];
+
+        XCTAssertEqualObjects(actual.raw, expected.raw);
+        XCTAssertEqualObjects(actual.circuitId, expected.circuitId, @"%@", line);
+        XCTAssertEqualObjects(actual.status, expected.status, @"%@", line);
+        XCTAssertEqual(actual.nodes.count, expected.nodes.count, @"%@", line);
+
+        for (NSUInteger i = 0; i < MIN(actual.nodes.count, expected.nodes.count); i++)
+        {
+            XCTAssertEqualObjects(actual.nodes[i].fingerprint, expected.nodes[i].fingerprint, @"%@", line);
+            XCTAssertEqualObjects(actual.nodes[i].nickName, expected.nodes[i].nickName, @"%@", line);
+        }
+
+        XCTAssertEqualObjects(actual.buildFlags, expected.buildFlags, @"%@", line);
+        XCTAssertEqualObjects(actual.purpose, expected.purpose, @"%@", line);
+        XCTAssertEqualObjects(actual.hsState, expected.hsState, @"%@", line);
+        XCTAssertEqualObjects(actual.rendQuery, expected.rendQuery, @"%@", line);
+        XCTAssertEqualObjects(actual.reason, expected.reason, @"%@", line);
+        XCTAssertEqualObjects(actual.remoteReason, expected.remoteReason, @"%@", line);
+        XCTAssertEqualObjects(actual.socksUsername, expected.socksUsername, @"%@", line);
+        XCTAssertEqualObjects(actual.socksPassword, expected.socksPassword, @"%@", line);
+
+        // NSDateFormatter only has millisecond precision.
+        XCTAssertEqualWithAccuracy(actual.timeCreated.timeIntervalSince1970,
+                                   expected.timeCreated.timeIntervalSince1970, 0.001, @"%@", line);
+    }
+}
+
+- (void)testPerformance {
+    NSString *status = [self.class statusWithCircuits:1000];
+
+    [self measureBlock:^{
+        XCTAssertEqual([TORCircuit circuitsFromString:status].count, 1000);
+    }];
+}
+
+- (void)testPerformanceRegex {
+    NSString *status = [self.class statusWithCircuits:1000];
+
+    [self measureBlock:^{
+        NSMutableArray<TORCircuit *> *circuits = [NSMutableArray new];
+
+        for (NSString *line in [status componentsSeparatedByString:@"\r\n"])
+        {
+            [circuits addObject:[[TORCircuit alloc] initWithRegexFromString:line]];
+        }
+
+        XCTAssertEqual(circuits.count, 1000);
+    }];
+}
+
+
+// MARK: Helper Methods
+
+/**
+ A synthetic "GETINFO circuit-status" reply with the given number of circuits, using all
+ the variations Tor produces.
+ */
++ (NSString *)statusWithCircuits:(NSUInteger)count
+{
+    NSArray<NSString *> *statuses = @[@"LAUNCHED", @"EXTENDED", @"BUILT", @"BUILT", @"GUARD_WAIT"];
+    NSArray<NSString *> *purposes = @[@"GENERAL", @"HS_CLIENT_HSDIR", @"HS_CLIENT_INTRO", @"HS_CLIENT_REND", @"CONFLUX_LINKED"];
+    NSArray<NSString *> *flags = @[@"NEED_CAPACITY", @"IS_INTERNAL,NEED_CAPACITY", @"ONEHOP_TUNNEL,IS_INTERNAL,NEED_CAPACITY,NEED_UPTIME"];
+
+    NSMutableArray<NSString *> *lines = [NSMutableArray new];
+
+    for (NSUInteger i = 1; i <= count; i++)
+    {
+        NSMutableString *line = [NSMutableString stringWithFormat:@"%lu %@", (unsigned long)i, statuses[i % statuses.count]];
+
+        NSUInteger hops = i % 4;
+
+        for (NSUInteger h = 0; h < hops; h++)
+        {
+            [line appendFormat:@"%@$%08lX%032lX~Relay%lu", h ? @"," : @" ", (unsigned long)(i * 7 + h), (unsigned long)(i * 31 + h), (unsigned long)(i + h)];
+        }
+
+        [line appendFormat:@" BUILD_FLAGS=%@ PURPOSE=%@", flags[i % flags.count], purposes[i % purposes.count]];
+
+        if (i % purposes.count == 3)
+        {
+            [line appendFormat:@" HS_STATE=HSCR_JOINED REND_QUERY=%016lx", (unsigned long)i];
+        }
+
+        [line appendFormat:@" TIME_CREATED=2023-11-%02luT%02lu:%02lu:%02lu.%06lu",
+         (unsigned long)(i % 28 + 1), (unsigned long)(i % 24), (unsigned long)(i % 60), (unsigned long)(i * 7 % 60), (unsigned long)(i * 7919 % 1000000)];
+
+        if (i % 10 == 0)
+        {
+            [line appendFormat:@" SOCKS_USERNAME=\"user%lu\" SOCKS_PASSWORD=\"pass%lu\"", (unsigned long)i, (unsigned long)i];
+        }
+
+        [lines addObject:line];
+    }
+
+    return [lines componentsJoinedByString:@"\r\n"];
+}
+
+@end
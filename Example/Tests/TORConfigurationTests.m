@@ -6,6 +6,7 @@
 //
 
 #import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
 
 @interface TORConfigurationTests : XCTestCase
 
@@ -23,4 +24,95 @@
     [super tearDown];
 }
 
+- (void)testDiffEmpty {
+    TORConfiguration *configuration = [self.class configuration];
+
+    TORConfigurationDiff *diff = [TORConfigurationDiff diffFrom:configuration to:[self.class configuration]];
+
+    XCTAssertTrue(diff.isEmpty);
+    XCTAssertFalse(diff.needsRestart);
+    XCTAssertEqualObjects(diff.setConfArguments, @[]);
+}
+
+- (void)testDiffHot {
+    TORConfiguration *from = [self.class configuration];
+    TORConfiguration *to = [self.class configuration];
+    to.socksPort = 9150;
+    to.options[@"ExitNodes"] = nil;
+    to.options[@"EntryNodes"] = @"{de}";
+    to.logfile = [NSURL fileURLWithPath:@"/tmp/my tor.log"];
+    [to.arguments addObjectsFromArray:@[@"--UseBridges", @"1", @"--Bridge", @"obfs4 1.2.3.4:443 cert=\"a\"", @"--Bridge", @"snowflake 192.0.2.3:80"]];
+
+    TORConfigurationDiff *diff = [TORConfigurationDiff diffFrom:from to:to];
+
+    XCTAssertFalse(diff.isEmpty);
+    XCTAssertFalse(diff.needsRestart);
+    XCTAssertEqualObjects(diff.hotKeys, (@[@"SocksPort", @"Log", @"UseBridges", @"Bridge", @"EntryNodes", @"ExitNodes"]));
+    XCTAssertEqualObjects(diff.setConfArguments, (@[
+        @"SocksPort=9150",
+        @"Log=\"notice file /tmp/my tor.log\"",
+        @"UseBridges=1",
+        @"Bridge=\"obfs4 1.2.3.4:443 cert=\\\"a\\\"\"",
+        @"Bridge=\"snowflake 192.0.2.3:80\"",
+        @"EntryNodes={de}",
+        @"ExitNodes",
+    ]));
+}
+
+- (void)testDiffRestart {
+    TORConfiguration *from = [self.class configuration];
+    TORConfiguration *to = [self.class configuration];
+    to.dataDirectory = [NSURL fileURLWithPath:@"/tmp/other"];
+    to.dnsPort = 1953;
+
+    TORConfigurationDiff *diff = [TORConfigurationDiff diffFrom:from to:to];
+
+    XCTAssertTrue(diff.needsRestart);
+    XCTAssertEqualObjects(diff.restartKeys, @[@"DataDirectory"]);
+    XCTAssertEqualObjects(diff.setConfArguments, @[@"DnsPort=1953"]);
+}
+
+- (void)testDiffRestartOptions {
+    for (NSString *key in @[@"HiddenServiceSingleHopMode", @"HiddenServiceNonAnonymousMode", @"TokenBucketRefillInterval"]) {
+        TORConfiguration *from = [self.class configuration];
+        TORConfiguration *to = [self.class configuration];
+        to.options[key] = @"1";
+
+        TORConfigurationDiff *diff = [TORConfigurationDiff diffFrom:from to:to];
+
+        XCTAssertTrue(diff.needsRestart, @"%@", key);
+        XCTAssertEqualObjects(diff.restartKeys, @[key]);
+        XCTAssertEqualObjects(diff.setConfArguments, @[]);
+    }
+}
+
+- (void)testDiffHiddenServices {
+    TORConfiguration *from = [self.class configuration];
+    TORConfiguration *to = [self.class configuration];
+    [to.arguments addObjectsFromArray:@[@"--HiddenServiceDir", @"/tmp/a", @"--HiddenServicePort", @"80 127.0.0.1:8080",
+                                        @"--HiddenServiceDir", @"/tmp/b", @"--HiddenServicePort", @"22"]];
+
+    XCTAssertEqualObjects([TORConfigurationDiff diffFrom:from to:to].setConfArguments, (@[
+        @"HiddenServiceDir=/tmp/a", @"HiddenServicePort=\"80 127.0.0.1:8080\"",
+        @"HiddenServiceDir=/tmp/b", @"HiddenServicePort=22",
+    ]));
+
+    XCTAssertEqualObjects([TORConfigurationDiff diffFrom:to to:from].setConfArguments, @[@"HiddenServiceDir"]);
+}
+
+
+// MARK: Helper Methods
+
++ (TORConfiguration *)configuration {
+    TORConfiguration *configuration = [TORConfiguration new];
+    configuration.ignoreMissingTorrc = YES;
+    configuration.cookieAuthentication = YES;
+    configuration.dataDirectory = [NSURL fileURLWithPath:@"/tmp/tor"];
+    configuration.socksPort = 9050;
+    configuration.dnsPort = 1951;
+    configuration.options[@"ExitNodes"] = @"{us}";
+
+    return configuration;
+}
+
 @end
@@ -0,0 +1,254 @@
+//
+//  TORControlReplyParserTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+@interface TORControlReplyParserTests : XCTestCase
+
+@property (nonatomic) NSMutableArray<NSArray<NSNumber *> *> *codes;
+@property (nonatomic) NSMutableArray<NSArray<NSString *> *> *lines;
+@property (nonatomic) TORControlReplyParser *parser;
+
+@end
+
+@implementation TORControlReplyParserTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.codes = [NSMutableArray new];
+    self.lines = [NSMutableArray new];
+
+    __weak TORControlReplyParserTests *weakSelf = self;
+
+    self.parser = [[TORControlReplyParser alloc] initWithHandler:^(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines) {
+        NSMutableArray<NSString *> *strings = [NSMutableArray new];
+
+        for (NSData *line in lines)
+        {
+            [strings addObject:[[NSString alloc] initWithData:line encoding:NSUTF8StringEncoding]];
+        }
+
+        [weakSelf.codes addObject:codes];
+        [weakSelf.lines addObject:strings];
+    }];
+}
+
+- (void)testSingleLineReply {
+    [self feed:@"250 OK\r\n" chunkSize:0];
+
+    XCTAssertEqualObjects(self.codes, (@[@[@250]]));
+    XCTAssertEqualObjects(self.lines, (@[@[@"OK"]]));
+    XCTAssertEqual(self.parser.bufferedLength, 0);
+}
+
+- (void)testMultiLineReply {
+    [self feed:@"250-version=0.4.8.10\r\n250-status/circuit-established=1\r\n250 OK\r\n" chunkSize:0];
+
+    XCTAssertEqualObjects(self.codes, (@[@[@250, @250, @250]]));
+    XCTAssertEqualObjects(self.lines, (@[@[@"version=0.4.8.10", @"status/circuit-established=1", @"OK"]]));
+}
+
+- (void)testDataReply {
+    [self feed:@"250+circuit-status=\r\n1 BUILT $A~a\r\n2 EXTENDED $B~b\r\n.\r\n250 OK\r\n" chunkSize:0];
+
+    XCTAssertEqualObjects(self.codes, (@[@[@250, @250]]));
+    XCTAssertEqualObjects(self.lines, (@[@[@"circuit-status=\r\n1 BUILT $A~a\r\n2 EXTENDED $B~b", @"OK"]]));
+}
+
+- (void)testEmptyDataReply {
+    [self feed:@"250+circuit-status=\r\n.\r\n250 OK\r\n" chunkSize:0];
+    [self feed:@"250+\r\nfoo\r\n.\r\n250 OK\r\n" chunkSize:0];
+
+    XCTAssertEqualObjects(self.lines, (@[@[@"circuit-status=", @"OK"], @[@"foo", @"OK"]]));
+}
+
+- (void)testInvalidLinesAreSkipped {
+    [self feed:@"garbage\r\n25\r\n2x0 nope\r\n250?nope\r\n650 BW 10 20\r\n" chunkSize:0];
+
+    XCTAssertEqualObjects(self.codes, (@[@[@650]]));
+    XCTAssertEqualObjects(self.lines, (@[@[@"BW 10 20"]]));
+}
+
+- (void)testLoneLineFeedDoesNotEndLine {
+    [self feed:@"650 STATUS_CLIENT NOTICE\nBOOTSTRAP\r\n" chunkSize:0];
+
+    XCTAssertEqualObjects(self.lines, (@[@[@"STATUS_CLIENT NOTICE\nBOOTSTRAP"]]));
+}
+
+- (void)testEveryChunkSize {
+    NSString *transcript = [self.class transcriptWithEvents:20];
+
+    [self feed:transcript chunkSize:0];
+
+    NSArray *expectedCodes = self.codes.copy;
+    NSArray *expectedLines = self.lines.copy;
+
+    XCTAssertEqual(expectedCodes.count, 23);
+
+    for (NSUInteger chunkSize = 1; chunkSize < 64; chunkSize++)
+    {
+        [self.codes removeAllObjects];
+        [self.lines removeAllObjects];
+        [self.parser reset];
+
+        [self feed:transcript chunkSize:chunkSize];
+
+        XCTAssertEqualObjects(self.codes, expectedCodes, @"chunkSize=%lu", (unsigned long)chunkSize);
+        XCTAssertEqualObjects(self.lines, expectedLines, @"chunkSize=%lu", (unsigned long)chunkSize);
+        XCTAssertEqual(self.parser.bufferedLength, 0);
+    }
+}
+
+- (void)testPartialLineIsRetained {
+    [self feed:@"250 OK\r\n650 CIRC 1 LAU" chunkSize:0];
+
+    XCTAssertEqual(self.codes.count, 1);
+    XCTAssertEqual(self.parser.bufferedLength, 14);
+
+    [self feed:@"NCHED\r\n" chunkSize:0];
+
+    XCTAssertEqualObjects(self.lines.lastObject, (@[@"CIRC 1 LAUNCHED"]));
+    XCTAssertEqual(self.parser.bufferedLength, 0);
+}
+
+- (void)testDataSink {
+    NSString *transcript = @"250+ns/all=\r\nr A\r\ns Fast\r\nr B\r\ns Exit\r\n.\r\n250 OK\r\n"
+        "650+NEWCONSENSUS\r\nr C\r\n.\r\n650 OK\r\n";
+
+    NSMutableString *streamed = [NSMutableString new];
+
+    self.parser.dataSinkProvider = ^TORControlDataSink _Nullable(NSArray<NSNumber *> *codes, NSData *line) {
+        if (codes.firstObject.integerValue == 650)
+        {
+            return nil;
+        }
+
+        XCTAssertEqualObjects([[NSString alloc] initWithData:line encoding:NSUTF8StringEncoding], @"ns/all=");
+
+        return ^BOOL(dispatch_data_t lines) {
+            [streamed appendString:[[NSString alloc] initWithData:(NSData *)lines encoding:NSUTF8StringEncoding]];
+
+            return YES;
+        };
+    };
+
+    for (NSUInteger chunkSize = 1; chunkSize < 16; chunkSize++)
+    {
+        [self.codes removeAllObjects];
+        [self.lines removeAllObjects];
+        [streamed setString:@""];
+        [self.parser reset];
+
+        [self feed:transcript chunkSize:chunkSize];
+
+        XCTAssertEqualObjects(streamed, @"r A\r\ns Fast\r\nr B\r\ns Exit\r\n", @"chunkSize=%lu", (unsigned long)chunkSize);
+        XCTAssertEqualObjects(self.lines, (@[@[@"ns/all=", @"OK"], @[@"NEWCONSENSUS\r\nr C", @"OK"]]), @"chunkSize=%lu", (unsigned long)chunkSize);
+        XCTAssertEqual(self.parser.bufferedLength, 0);
+    }
+}
+
+- (void)testDataSinkStops {
+    __block NSUInteger calls = 0;
+
+    self.parser.dataSinkProvider = ^TORControlDataSink _Nullable(NSArray<NSNumber *> * __unused codes, NSData * __unused line) {
+        return ^BOOL(dispatch_data_t __unused lines) {
+            calls++;
+
+            return NO;
+        };
+    };
+
+    [self feed:@"250+ns/all=\r\nr A\r\nr B\r\nr C\r\n.\r\n250 OK\r\n" chunkSize:5];
+
+    XCTAssertEqual(calls, 1);
+    XCTAssertEqualObjects(self.lines, (@[@[@"ns/all=", @"OK"]]));
+}
+
+/**
+ Feeds a control port transcript with a heavy 650 event load through the parser in
+ chunks of the size a socket typically delivers.
+ */
+- (void)testPerformance {
+    NSData *transcript = [[self.class transcriptWithEvents:50000] dataUsingEncoding:NSUTF8StringEncoding];
+    __block NSUInteger replies = 0;
+
+    TORControlReplyParser *parser = [[TORControlReplyParser alloc] initWithHandler:
+                                     ^(NSArray<NSNumber *> * __unused codes, NSArray<NSData *> * __unused lines) {
+        replies++;
+    }];
+
+    [self measureBlock:^{
+        replies = 0;
+        [parser reset];
+
+        for (NSUInteger offset = 0; offset < transcript.length; offset += 4096)
+        {
+            NSUInteger length = MIN(4096, transcript.length - offset);
+
+            [parser parseData:dispatch_data_create((const uint8_t *)transcript.bytes + offset, length, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT)];
+        }
+
+        XCTAssertEqual(replies, 50003);
+    }];
+}
+
+
+// MARK: Helper Methods
+
+- (void)feed:(NSString *)string chunkSize:(NSUInteger)chunkSize
+{
+    NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+
+    if (chunkSize < 1)
+    {
+        chunkSize = data.length;
+    }
+
+    for (NSUInteger offset = 0; offset < data.length; offset += chunkSize)
+    {
+        NSUInteger length = MIN(chunkSize, data.length - offset);
+
+        [self.parser parseData:dispatch_data_create((const uint8_t *)data.bytes + offset, length, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT)];
+    }
+}
+
+/**
+ A transcript as recorded from a Tor 0.4.8 control port with `SETEVENTS CIRC STREAM BW STATUS_CLIENT`
+ while browsing, with its event part repeated to the requested length.
+ */
++ (NSString *)transcriptWithEvents:(NSUInteger)count
+{
+    NSArray<NSString *> *events = @[
+        @"650 BW 1536 2048\r\n",
+        @"650 CIRC 11 LAUNCHED BUILD_FLAGS=NEED_CAPACITY PURPOSE=GENERAL TIME_CREATED=2023-11-20T10:02:51.713542\r\n",
+        @"650 CIRC 11 EXTENDED $A1B2C3D4E5F60718293A4B5C6D7E8F9012345678~Relay1 BUILD_FLAGS=NEED_CAPACITY PURPOSE=GENERAL TIME_CREATED=2023-11-20T10:02:51.713542\r\n",
+        @"650 STREAM 42 NEW 0 check.torproject.org:443 SOURCE_ADDR=127.0.0.1:50123 PURPOSE=USER\r\n",
+        @"650 STREAM 42 SUCCEEDED 11 116.202.120.181:443\r\n",
+        @"650 STATUS_CLIENT NOTICE CIRCUIT_ESTABLISHED\r\n",
+        @"650 BW 0 0\r\n",
+    ];
+
+    NSMutableString *transcript = [NSMutableString new];
+
+    [transcript appendString:@"250 OK\r\n"];
+    [transcript appendString:@"250+circuit-status=\r\n"
+     "11 BUILT $A1B2C3D4E5F60718293A4B5C6D7E8F9012345678~Relay1,$0123456789ABCDEF0123456789ABCDEF01234567~Relay2,$FEDCBA9876543210FEDCBA9876543210FEDCBA98~Relay3 BUILD_FLAGS=NEED_CAPACITY PURPOSE=GENERAL TIME_CREATED=2023-11-20T10:02:51.713542\r\n"
+     "12 BUILT $A1B2C3D4E5F60718293A4B5C6D7E8F9012345678~Relay1,$89ABCDEF0123456789ABCDEF0123456789ABCDEF~Relay4 BUILD_FLAGS=IS_INTERNAL,NEED_CAPACITY PURPOSE=HS_CLIENT_HSDIR TIME_CREATED=2023-11-20T10:02:52.001234\r\n"
+     ".\r\n250 OK\r\n"];
+    [transcript appendString:@"250-status/circuit-established=1\r\n250 OK\r\n"];
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [transcript appendString:events[i % events.count]];
+    }
+
+    return transcript;
+}
+
+@end
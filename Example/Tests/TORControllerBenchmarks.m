@@ -0,0 +1,365 @@
+//
+//  TORControllerBenchmarks.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+#import <time.h>
+
+#import "TORBenchmarkSupport.h"
+#import "TORMockControlServer.h"
+
+
+/**
+ Measures @c TORController against @c TORMockControlServer, so the numbers don't depend on a running Tor or the network.
+
+ Results are logged per run as operations/s, latency percentiles from sending to the completion
+ being called, and allocations per operation on the calling thread and on the control queue.
+ */
+@interface TORControllerBenchmarks : XCTestCase
+
+@property (nonatomic) TORMockControlServer *server;
+@property (nonatomic) TORController *controller;
+
+@end
+
+@implementation TORControllerBenchmarks
+
+static const NSUInteger commands = 5000;
+static const NSUInteger relays = 2000;
+static const NSUInteger circuits = 1000;
+static const NSUInteger events = 10000;
+
++ (void)setUp
+{
+    [super setUp];
+
+    TORBenchmarkInstallMallocLogger("org.torproject.ios.control");
+}
+
++ (void)tearDown
+{
+    TORBenchmarkRemoveMallocLogger();
+
+    [super tearDown];
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSError *error;
+    self.server = [TORMockControlServer startedServer:&error];
+    XCTAssertNotNil(self.server, @"%@", error);
+
+    [self.server setInfo:[TORMockControlServer consensusWithRelays:relays] forKey:@"ns/all"];
+    [self.server setInfo:[TORMockControlServer circuitStatusWithCircuits:circuits relays:relays] forKey:@"circuit-status"];
+
+    self.controller = [self.server connectedController];
+    XCTAssertTrue(self.controller.isConnected);
+}
+
+- (void)tearDown
+{
+    [self.controller disconnect];
+    [self.server stop];
+
+    [super tearDown];
+}
+
+
+// MARK: Benchmarks
+
+- (void)testSendCommand
+{
+    TORController *controller = self.controller;
+
+    [self measure:@"sendCommand:" count:commands send:^(NSUInteger i, void (^done)(NSUInteger i)) {
+        [controller sendCommand:@"GETINFO" arguments:@[@"version"] data:nil observer:
+         ^BOOL(NSArray<NSNumber *> *codes, NSArray<NSData *> * __unused lines, BOOL *stop) {
+            XCTAssertEqual(codes.lastObject.integerValue, 250);
+
+            done(i);
+
+            *stop = YES;
+            return YES;
+        }];
+    }];
+}
+
+- (void)testGetInfoForKeys
+{
+    [self measureGetInfo:@"getInfoForKeys:" coalesced:NO];
+}
+
+- (void)testGetInfoForKeysCoalesced
+{
+    [self measureGetInfo:@"getInfoForKeys: (coalesced)" coalesced:YES];
+}
+
+- (void)testDataReply
+{
+    TORController *controller = self.controller;
+
+    [self measure:@"sendCommand: (data reply)" count:commands / 10 send:^(NSUInteger i, void (^done)(NSUInteger i)) {
+        [controller sendCommand:@"GETINFO" arguments:@[@"circuit-status"] data:nil observer:
+         ^BOOL(NSArray<NSNumber *> * __unused codes, NSArray<NSData *> *lines, BOOL *stop) {
+            XCTAssertEqual(lines.count, 2);
+
+            done(i);
+
+            *stop = YES;
+            return YES;
+        }];
+    }];
+}
+
+/**
+ "ns/all" is streamed into the index, while it is read.
+ */
+- (void)testLoadRelayIndex
+{
+    TORController *controller = self.controller;
+
+    [self measure:[NSString stringWithFormat:@"loadRelayIndex: (%lu relays)", (unsigned long)relays] count:20
+             send:^(NSUInteger i, void (^done)(NSUInteger i))
+    {
+        [controller loadRelayIndex:^(TORRelayIndex * _Nullable relayIndex) {
+            XCTAssertEqual(relayIndex.count, relays);
+
+            done(i);
+        }];
+    }];
+}
+
+/**
+ Every call needs its own connection, as the circuit table is only seeded once per connection.
+
+ The relay index is loaded once up front and handed to every connection, like @c TORControllerPool does.
+ */
+- (void)testGetCircuits
+{
+    XCTestExpectation *loaded = [self expectationWithDescription:@"loaded"];
+    __block TORRelayIndex *relayIndex;
+
+    [self.controller loadRelayIndex:^(TORRelayIndex * _Nullable result) {
+        relayIndex = result;
+
+        [loaded fulfill];
+    }];
+
+    [self waitForExpectations:@[loaded] timeout:30];
+
+    NSMutableArray<TORController *> *controllers = [NSMutableArray new];
+
+    [self measure:[NSString stringWithFormat:@"getCircuits: (%lu circuits)", (unsigned long)circuits] count:20
+             send:^(NSUInteger i, void (^done)(NSUInteger i))
+    {
+        TORController *controller = [self.server connectedController];
+        XCTAssertTrue(controller.isConnected);
+
+        controller.relayIndex = relayIndex;
+        [controllers addObject:controller];
+
+        [controller getCircuits:^(NSArray<TORCircuit *> *result) {
+            XCTAssertEqual(result.count, circuits);
+
+            done(i);
+        }];
+    }];
+
+    for (TORController *controller in controllers)
+    {
+        [controller disconnect];
+    }
+}
+
+- (void)testCircuitEvents
+{
+    TORController *controller = self.controller;
+    XCTestExpectation *seeded = [self expectationWithDescription:@"seeded"];
+
+    [controller getCircuits:^(NSArray<TORCircuit *> * __unused circuits) {
+        [seeded fulfill];
+    }];
+
+    [self waitForExpectations:@[seeded] timeout:30];
+
+    __block NSUInteger firstId = circuits + 1;
+
+    [self measureBlock:^{
+        NSString *burst = [TORMockControlServer circuitEvents:events relays:relays firstId:firstId];
+        NSString *lastId = [NSString stringWithFormat:@"%lu", (unsigned long)(firstId + (events - 1) / 2)];
+        firstId += events;
+
+        XCTestExpectation *expectation = [self expectationWithDescription:@"events"];
+
+        id observer = [controller addObserverForCircuitChanges:^(NSArray<TORCircuit *> *changed, NSArray<TORCircuit *> * __unused all) {
+            for (TORCircuit *circuit in changed)
+            {
+                if ([circuit.circuitId isEqualToString:lastId] && [circuit.status isEqualToString:TORCircuit.statusClosed])
+                {
+                    [expectation fulfill];
+                }
+            }
+        }];
+
+        atomic_store(&TORBenchmarkAllocations, 0);
+        atomic_store(&TORBenchmarkCountQueueAllocations, true);
+        uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+        [self.server sendRaw:burst];
+
+        [self waitForExpectations:@[expectation] timeout:30];
+
+        uint64_t nanos = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+        atomic_store(&TORBenchmarkCountQueueAllocations, false);
+
+        [controller removeObserver:observer];
+
+        NSLog(@"[650 CIRC] %.0f events/s, %.0f ns/event, %.2f allocations/event",
+              events / ((double)nanos / NSEC_PER_SEC), (double)nanos / events, (double)atomic_load(&TORBenchmarkAllocations) / events);
+    }];
+}
+
+/**
+ The parser alone, fed with a transcript of mixed replies in socket-sized chunks.
+ */
+- (void)testParseReplies
+{
+    NSMutableString *transcript = [NSMutableString new];
+
+    for (NSUInteger i = 0; i < commands; i++)
+    {
+        [transcript appendString:@"250-version=0.4.8.0 (mock)\r\n250 OK\r\n"];
+
+        if (i % 100 == 0)
+        {
+            [transcript appendString:[TORMockControlServer infoReplyLineForKey:@"circuit-status"
+                                                                         value:[TORMockControlServer circuitStatusWithCircuits:100 relays:relays]]];
+            [transcript appendString:@"250 OK\r\n"];
+        }
+    }
+
+    [transcript appendString:[TORMockControlServer circuitEvents:commands relays:relays firstId:1]];
+
+    NSData *data = [transcript dataUsingEncoding:NSUTF8StringEncoding];
+    const size_t chunkSize = 4096;
+    NSUInteger chunks = (data.length + chunkSize - 1) / chunkSize;
+
+    NSMutableArray *regions = [NSMutableArray new];
+
+    for (NSUInteger offset = 0; offset < data.length; offset += chunkSize)
+    {
+        size_t length = MIN(chunkSize, data.length - offset);
+
+        [regions addObject:dispatch_data_create((const uint8_t *)data.bytes + offset, length, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT)];
+    }
+
+    [self measureBlock:^{
+        __block NSUInteger replies = 0;
+
+        TORControlReplyParser *parser = [[TORControlReplyParser alloc] initWithHandler:
+                                         ^(NSArray<NSNumber *> * __unused codes, NSArray<NSData *> * __unused lines) {
+            replies++;
+        }];
+
+        uint64_t *latencies = malloc(chunks * sizeof(uint64_t));
+
+        atomic_store(&TORBenchmarkAllocations, 0);
+        TORBenchmarkCountAllocations = true;
+        uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+        for (NSUInteger i = 0; i < chunks; i++)
+        {
+            uint64_t chunkStart = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+            [parser parseData:regions[i]];
+
+            latencies[i] = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - chunkStart;
+        }
+
+        uint64_t nanos = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+        TORBenchmarkCountAllocations = false;
+
+        NSLog(@"[TORControlReplyParser] %.0f replies/s, %.1f MB/s, %.2f allocations/reply, per %zu byte chunk: %@",
+              replies / ((double)nanos / NSEC_PER_SEC), data.length / ((double)nanos / NSEC_PER_SEC) / 1000000,
+              (double)atomic_load(&TORBenchmarkAllocations) / replies, chunkSize, [TORBenchmarkSupport percentiles:latencies count:chunks]);
+
+        free(latencies);
+    }];
+}
+
+
+// MARK: Helper Methods
+
+- (void)measureGetInfo:(NSString *)name coalesced:(BOOL)coalesced
+{
+    TORController *controller = self.controller;
+    controller.coalescesCommands = coalesced;
+
+    [self measure:name count:commands send:^(NSUInteger i, void (^done)(NSUInteger i)) {
+        [controller getInfoForKeys:@[@"version", @"config-file"] completion:^(NSArray<NSString *> *values) {
+            XCTAssertEqual(values.count, 2);
+
+            done(i);
+        }];
+    }];
+}
+
+/**
+ Sends @c count operations back-to-back and waits until all are done.
+
+ @param send Needs to start operation @c i and call @c done with @c i, when it finished.
+ */
+- (void)measure:(NSString *)name count:(NSUInteger)count send:(void (^)(NSUInteger i, void (^done)(NSUInteger i)))send
+{
+    [self measureBlock:^{
+        uint64_t *starts = calloc(count, sizeof(uint64_t));
+        uint64_t *latencies = calloc(count, sizeof(uint64_t));
+        __block NSUInteger finished = 0;
+
+        XCTestExpectation *expectation = [self expectationWithDescription:name];
+
+        // Always called on the control queue, which is serial.
+        void (^done)(NSUInteger i) = ^(NSUInteger i) {
+            latencies[i] = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - starts[i];
+
+            if (++finished == count)
+            {
+                [expectation fulfill];
+            }
+        };
+
+        atomic_store(&TORBenchmarkAllocations, 0);
+        atomic_store(&TORBenchmarkCountQueueAllocations, true);
+        TORBenchmarkCountAllocations = true;
+        uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            starts[i] = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+            send(i, done);
+        }
+
+        TORBenchmarkCountAllocations = false;
+
+        [self waitForExpectations:@[expectation] timeout:60];
+
+        uint64_t nanos = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+        atomic_store(&TORBenchmarkCountQueueAllocations, false);
+
+        NSLog(@"[%@] %.0f ops/s, %.2f allocations/op, latency: %@",
+              name, count / ((double)nanos / NSEC_PER_SEC), (double)atomic_load(&TORBenchmarkAllocations) / count,
+              [TORBenchmarkSupport percentiles:latencies count:count]);
+
+        free(starts);
+        free(latencies);
+    }];
+}
+
+@end
@@ -0,0 +1,360 @@
+//
+//  TORControllerPipeliningTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+#import "TORMockControlServer.h"
+
+/**
+ Checks, that pipelined commands get their own replies, even with asynchronous events in between.
+ */
+@interface TORControllerPipeliningTests : XCTestCase
+
+@property (nonatomic) TORMockControlServer *server;
+@property (nonatomic) TORController *controller;
+
+@end
+
+@implementation TORControllerPipeliningTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSError *error;
+    self.server = [TORMockControlServer startedServer:&error];
+    XCTAssertNotNil(self.server, @"%@", error);
+
+    self.controller = [self.server connectedController];
+    XCTAssertTrue(self.controller.isConnected);
+}
+
+- (void)tearDown
+{
+    [self.server stop];
+
+    [super tearDown];
+}
+
+- (void)testRepliesBetweenEvents
+{
+    TORController *controller = self.controller;
+
+    // Events before, between and after the replies, including one with a data block.
+    [self.server setReply:@"650 CIRC 1 LAUNCHED\r\n250 OK\r\n" forCommand:@"SIGNAL NEWNYM"];
+    [self.server setReply:@"650+NEWCONSENSUS\r\nr Relay0 AAAA\r\ns Running\r\n.\r\n650 OK\r\n250-version=1.2.3\r\n250 OK\r\n"
+               forCommand:@"GETINFO version"];
+    [self.server setReply:@"650 CIRC 2 BUILT\r\n552 Unrecognized option: Unknown option 'Foo'.\r\n650 CIRC 2 CLOSED\r\n"
+               forCommand:@"SETCONF Foo=bar"];
+
+    NSMutableArray<NSString *> *events = [NSMutableArray new];
+    NSMutableArray<NSString *> *commands = [NSMutableArray new];
+
+    XCTestExpectation *eventsReceived = [self expectationWithDescription:@"events"];
+    eventsReceived.expectedFulfillmentCount = 4;
+
+    [controller addObserverForEvents:@[@"CIRC", @"NEWCONSENSUS"] block:
+     ^BOOL(NSArray<NSNumber *> * __unused codes, NSArray<NSData *> *lines, BOOL * __unused stop) {
+        [events addObject:[[NSString alloc] initWithData:lines.firstObject encoding:NSUTF8StringEncoding]];
+
+        [eventsReceived fulfill];
+
+        return YES;
+    }];
+
+    XCTestExpectation *replied = [self expectationWithDescription:@"replies"];
+    replied.expectedFulfillmentCount = 3;
+
+    [controller sendCommand:@"SIGNAL" arguments:@[@"NEWNYM"] data:nil timeout:0
+                 completion:^(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, NSError *error)
+    {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(codes, @[@250]);
+        XCTAssertEqualObjects(lines, @[[@"OK" dataUsingEncoding:NSUTF8StringEncoding]]);
+
+        [commands addObject:@"SIGNAL"];
+        [replied fulfill];
+    }];
+
+    [controller sendCommand:@"GETINFO" arguments:@[@"version"] data:nil timeout:0
+                 completion:^(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, NSError *error)
+    {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(codes, (@[@250, @250]));
+        XCTAssertEqualObjects(lines.firstObject, [@"version=1.2.3" dataUsingEncoding:NSUTF8StringEncoding]);
+
+        [commands addObject:@"GETINFO"];
+        [replied fulfill];
+    }];
+
+    [controller sendCommand:@"SETCONF" arguments:@[@"Foo=bar"] data:nil timeout:0
+                 completion:^(NSArray<NSNumber *> *codes, NSArray<NSData *> * __unused lines, NSError *error)
+    {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(codes, @[@552]);
+
+        [commands addObject:@"SETCONF"];
+        [replied fulfill];
+    }];
+
+    [self waitForExpectations:@[replied, eventsReceived] timeout:5];
+
+    // Both only touched on the control queue.
+    dispatch_sync(controller.controlQueue, ^{
+        XCTAssertEqualObjects(commands, (@[@"SIGNAL", @"GETINFO", @"SETCONF"]));
+
+        XCTAssertEqual(events.count, 4);
+        XCTAssertEqualObjects(events[0], @"CIRC 1 LAUNCHED");
+        XCTAssertTrue([events[1] hasPrefix:@"NEWCONSENSUS\r\nr Relay0 AAAA"], @"%@", events[1]);
+        XCTAssertEqualObjects(events[2], @"CIRC 2 BUILT");
+        XCTAssertEqualObjects(events[3], @"CIRC 2 CLOSED");
+    });
+}
+
+- (void)testManyRepliesWithEventBursts
+{
+    const NSUInteger count = 200;
+
+    TORController *controller = self.controller;
+    TORMockControlServer *server = self.server;
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [server setInfo:[NSString stringWithFormat:@"value-%lu", (unsigned long)i]
+                 forKey:[NSString stringWithFormat:@"key/%lu", (unsigned long)i]];
+    }
+
+    __block NSUInteger eventCount = 0;
+
+    [controller addObserverForEvents:@[@"CIRC"] block:
+     ^BOOL(NSArray<NSNumber *> * __unused codes, NSArray<NSData *> * __unused lines, BOOL * __unused stop) {
+        eventCount++;
+
+        return YES;
+    }];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"replies"];
+    expectation.expectedFulfillmentCount = count;
+
+    __block NSUInteger next = 0;
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        NSString *key = [NSString stringWithFormat:@"key/%lu", (unsigned long)i];
+
+        [controller getInfoForKeys:@[key] completion:^(NSArray<NSString *> *values) {
+            XCTAssertEqualObjects(values, @[[NSString stringWithFormat:@"value-%lu", (unsigned long)i]]);
+
+            // Completions are called in the order of the calls.
+            XCTAssertEqual(next, i);
+            next++;
+
+            [expectation fulfill];
+        }];
+
+        // Lands somewhere between the replies.
+        if (i % 10 == 0)
+        {
+            [server sendRaw:[TORMockControlServer circuitEvents:4 relays:10 firstId:i]];
+        }
+    }
+
+    [self waitForExpectations:@[expectation] timeout:10];
+
+    // Events written after the last reply might still be in flight.
+    [server sendRaw:@"650 CIRC 9999 CLOSED $0000000000000000000000000000000000000000~Relay0 REASON=FINISHED\r\n"];
+
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+    __block NSUInteger events = 0;
+
+    do {
+        [NSThread sleepForTimeInterval:0.05];
+
+        dispatch_sync(controller.controlQueue, ^{
+            events = eventCount;
+        });
+    } while (events < (count / 10) * 4 + 1 && timeout.timeIntervalSinceNow > 0);
+
+    XCTAssertEqual(events, (count / 10) * 4 + 1);
+}
+
+/**
+ A merged SETCONF, which fails, is retried before anything called after it, so a later value isn't reverted.
+ */
+- (void)testFailedBatchKeepsOrder
+{
+    TORController *controller = self.controller;
+
+    [self.server setReply:@"552 Unrecognized option: Unknown option 'B'.\r\n" forCommand:@"SETCONF A=1 B=bad"];
+    [self.server setReply:@"552 Unrecognized option: Unknown option 'B'.\r\n" forCommand:@"SETCONF B=bad"];
+    [self.server setInfo:@"1" forKey:@"x"];
+
+    NSMutableArray<NSString *> *completions = [NSMutableArray new];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completions"];
+    expectation.expectedFulfillmentCount = 4;
+
+    NSUInteger first = self.server.commandCount;
+
+    [controller performBatch:^{
+        [controller setConfForKey:@"A" withValue:@"1" completion:^(BOOL success, NSError * __unused error) {
+            XCTAssertTrue(success);
+
+            [completions addObject:@"A=1"];
+            [expectation fulfill];
+        }];
+
+        [controller setConfForKey:@"B" withValue:@"bad" completion:^(BOOL success, NSError * __unused error) {
+            XCTAssertFalse(success);
+
+            [completions addObject:@"B=bad"];
+            [expectation fulfill];
+        }];
+
+        [controller getInfoForKeys:@[@"x"] completion:^(NSArray<NSString *> *values) {
+            XCTAssertEqualObjects(values, @[@"1"]);
+
+            [completions addObject:@"x"];
+            [expectation fulfill];
+        }];
+
+        [controller setConfForKey:@"A" withValue:@"2" completion:^(BOOL success, NSError * __unused error) {
+            XCTAssertTrue(success);
+
+            [completions addObject:@"A=2"];
+            [expectation fulfill];
+        }];
+    }];
+
+    [self waitForExpectations:@[expectation] timeout:5];
+
+    NSArray<NSString *> *commands = self.server.commands;
+
+    XCTAssertEqualObjects([commands subarrayWithRange:NSMakeRange(first, commands.count - first)],
+                          (@[@"SETCONF A=1 B=bad", @"SETCONF A=1", @"SETCONF B=bad", @"GETINFO x", @"SETCONF A=2"]));
+
+    XCTAssertEqualObjects(completions, (@[@"A=1", @"B=bad", @"x", @"A=2"]));
+}
+
+/**
+ A configuration diff re-sends options, which didn't change, so these must keep it from being merged, too.
+ */
+- (void)testConfigurationDiffIsNotMergedWithResentKeys
+{
+    TORController *controller = self.controller;
+
+    TORConfiguration *from = [TORConfiguration new];
+    [from.arguments addObjectsFromArray:@[@"--HiddenServiceDir", @"/tmp/a", @"--HiddenServicePort", @"80"]];
+
+    TORConfiguration *to = [TORConfiguration new];
+    [to.arguments addObjectsFromArray:@[@"--HiddenServiceDir", @"/tmp/a", @"--HiddenServicePort", @"81"]];
+
+    TORConfigurationDiff *diff = [TORConfigurationDiff diffFrom:from to:to];
+    XCTAssertEqualObjects(diff.hotKeys, @[@"HiddenServicePort"]);
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"completions"];
+    expectation.expectedFulfillmentCount = 2;
+
+    NSUInteger first = self.server.commandCount;
+
+    [controller performBatch:^{
+        [controller setConfForKey:@"HiddenServiceDir" withValue:@"/tmp/b" completion:^(BOOL success, NSError * __unused error) {
+            XCTAssertTrue(success);
+
+            [expectation fulfill];
+        }];
+
+        [controller applyConfigurationDiff:diff completion:^(BOOL success, NSError * __unused error) {
+            XCTAssertTrue(success);
+
+            [expectation fulfill];
+        }];
+    }];
+
+    [self waitForExpectations:@[expectation] timeout:5];
+
+    NSArray<NSString *> *commands = self.server.commands;
+
+    XCTAssertEqualObjects([commands subarrayWithRange:NSMakeRange(first, commands.count - first)],
+                          (@[@"SETCONF HiddenServiceDir=/tmp/b", @"SETCONF HiddenServiceDir=/tmp/a HiddenServicePort=81"]));
+}
+
+/**
+ The circuit seed doesn't wait for the whole consensus: Without a relay index, nodes are looked up one by one.
+ */
+- (void)testCircuitsWithoutRelayIndex
+{
+    TORController *controller = self.controller;
+
+    [self.server setInfo:[TORMockControlServer circuitStatusWithCircuits:1 relays:3] forKey:@"circuit-status"];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"circuits"];
+
+    [controller getCircuits:^(NSArray<TORCircuit *> *circuits) {
+        XCTAssertEqual(circuits.count, 1);
+
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectations:@[expectation] timeout:5];
+
+    XCTAssertNil(controller.relayIndex);
+
+    for (NSString *command in self.server.commands)
+    {
+        XCTAssertFalse([command containsString:@"ns/all"], @"%@", command);
+        XCTAssertFalse([command containsString:@"NEWCONSENSUS"], @"%@", command);
+    }
+}
+
+/**
+ Once loaded, the relay index is replaced with the consensus of every NEWCONSENSUS event.
+ */
+- (void)testNewConsensusReplacesRelayIndex
+{
+    TORController *controller = self.controller;
+
+    [self.server setInfo:[TORMockControlServer consensusWithRelays:10] forKey:@"ns/all"];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"loaded"];
+
+    [controller loadRelayIndex:^(TORRelayIndex * _Nullable relayIndex) {
+        XCTAssertEqual(relayIndex.count, 10);
+
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectations:@[expectation] timeout:5];
+
+    // Goes out after the subscription, so the observer is registered, when this returns.
+    [self roundTrip];
+
+    [self.server sendRaw:[NSString stringWithFormat:@"650+NEWCONSENSUS\r\n%@.\r\n650 OK\r\n",
+                          [TORMockControlServer consensusWithRelays:3]]];
+
+    // Goes out after the event, so the event was handled, when this returns.
+    [self roundTrip];
+
+    XCTAssertEqual(controller.relayIndex.count, 3);
+}
+
+
+// MARK: Helper Methods
+
+- (void)roundTrip
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"round trip"];
+
+    [self.controller getInfoForKeys:@[@"version"] completion:^(NSArray<NSString *> * __unused values) {
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectations:@[expectation] timeout:5];
+}
+
+@end
@@ -0,0 +1,138 @@
+//
+//  TORControllerPoolTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+#import "TORMockControlServer.h"
+
+@interface TORControllerPoolTests : XCTestCase
+
+@property (nonatomic) TORMockControlServer *server;
+@property (nonatomic) TORControllerPool *pool;
+
+@end
+
+@implementation TORControllerPoolTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSError *error;
+    self.server = [TORMockControlServer startedServer:&error];
+    XCTAssertNotNil(self.server, @"%@", error);
+
+    [self.server setInfo:[TORMockControlServer consensusWithRelays:10] forKey:@"ns/all"];
+
+    self.pool = [[TORControllerPool alloc] initWithSocketURL:self.server.socketURL bulkConnections:2];
+}
+
+- (void)tearDown
+{
+    [self.pool disconnect];
+    [self.server stop];
+
+    [super tearDown];
+}
+
+- (void)testQueues
+{
+    TORControllerPool *pool = self.pool;
+
+    XCTAssertEqual(pool.bulk.count, 2);
+    XCTAssertNotEqual(pool.primary.controlQueue, pool.bulk[0].controlQueue);
+    XCTAssertNotEqual(pool.bulk[0].controlQueue, pool.bulk[1].controlQueue);
+
+    XCTAssertEqual(dispatch_queue_get_qos_class(pool.primary.controlQueue, NULL), QOS_CLASS_USER_INITIATED);
+    XCTAssertEqual(dispatch_queue_get_qos_class(pool.bulk[0].controlQueue, NULL), QOS_CLASS_UTILITY);
+
+    XCTAssertEqual(pool.nextBulkController, pool.bulk[0]);
+    XCTAssertEqual(pool.nextBulkController, pool.bulk[1]);
+    XCTAssertEqual(pool.nextBulkController, pool.bulk[0]);
+}
+
+- (void)testRouting
+{
+    XCTAssertTrue([TORControllerPool isBulkInfoKey:@"ns/all"]);
+    XCTAssertTrue([TORControllerPool isBulkInfoKey:@"md/all"]);
+    XCTAssertFalse([TORControllerPool isBulkInfoKey:@"ns/id/0036FA36AB435FD5D0F640626636867EBFB72C68"]);
+    XCTAssertFalse([TORControllerPool isBulkInfoKey:@"version"]);
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"callback"];
+    TORControllerPool *pool = self.pool;
+
+    [pool getInfoForKeys:@[@"version"] completion:^(NSArray<NSString *> *values) {
+        XCTAssertEqualObjects(values.firstObject, @"0.4.8.0 (mock)");
+
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testRelayIndex
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"callback"];
+    TORControllerPool *pool = self.pool;
+
+    [pool loadRelayIndex:^(TORRelayIndex * _Nullable relayIndex) {
+        XCTAssertEqual(relayIndex.count, 10);
+        XCTAssertEqual(pool.primary.relayIndex, relayIndex);
+
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+/**
+ The primary connection gets its relay index from a bulk connection, but never sends "GETINFO ns/all" itself.
+ */
+- (void)testPrimaryNeverLoadsConsensus
+{
+    TORControllerPool *pool = self.pool;
+
+    [self.server setInfo:[TORMockControlServer circuitStatusWithCircuits:1 relays:10] forKey:@"circuit-status"];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"circuits"];
+
+    [pool.primary getCircuits:^(NSArray<TORCircuit *> *circuits) {
+        XCTAssertEqual(circuits.count, 1);
+
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectations:@[expectation] timeout:10];
+
+    // Tracking circuits asks the relay index provider on its own.
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:10];
+
+    while (!pool.primary.relayIndex && timeout.timeIntervalSinceNow > 0)
+    {
+        [NSThread sleepForTimeInterval:0.01];
+    }
+
+    XCTAssertEqual(pool.primary.relayIndex.count, 10);
+
+    // The primary connected first, so it is the first client.
+    NSArray<NSString *> *primary = [self.server commandsOfClient:0];
+    BOOL seeded = NO;
+
+    for (NSString *command in primary)
+    {
+        XCTAssertFalse([command containsString:@"ns/all"], @"%@", command);
+
+        seeded = seeded || [command hasPrefix:@"GETINFO circuit-status"];
+    }
+
+    XCTAssertTrue(seeded, @"%@", primary);
+
+    XCTAssertTrue([self.server.commands containsObject:@"GETINFO ns/all"], @"%@", self.server.commands);
+}
+
+@end
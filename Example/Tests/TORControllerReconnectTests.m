@@ -0,0 +1,136 @@
+//
+//  TORControllerReconnectTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+#import "TORMockControlServer.h"
+
+@interface TORControllerReconnectTests : XCTestCase
+
+@property (nonatomic) TORMockControlServer *server;
+@property (nonatomic) TORController *controller;
+
+@end
+
+@implementation TORControllerReconnectTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSError *error;
+    self.server = [TORMockControlServer startedServer:&error];
+    XCTAssertNotNil(self.server, @"%@", error);
+
+    self.controller = [self.server connectedController];
+    XCTAssertTrue(self.controller.isConnected);
+
+    self.controller.automaticallyReconnects = YES;
+    self.controller.maximumReconnectDelay = 1;
+}
+
+- (void)tearDown
+{
+    self.controller.automaticallyReconnects = NO;
+    [self.server stop];
+
+    [super tearDown];
+}
+
+- (void)testReconnect
+{
+    TORController *controller = self.controller;
+
+    [controller addObserverForCircuitEstablished:^(BOOL __unused established) {}];
+
+    [self waitUntil:^BOOL{
+        return [controller.events containsObject:@"STATUS_CLIENT"];
+    }];
+
+    // Tor restarts.
+    [self.server stop];
+
+    [self waitUntil:^BOOL{
+        return !controller.isConnected;
+    }];
+
+    NSError *error;
+    XCTAssertTrue([self.server start:&error], @"%@", error);
+
+    // Event subscriptions are restored.
+    [self waitUntil:^BOOL{
+        return controller.isConnected && [controller.events containsObject:@"STATUS_CLIENT"];
+    }];
+
+    XCTestExpectation *expectation = [self expectationWithDescription:@"callback after reconnect"];
+
+    [controller getInfoForKeys:@[@"version"] timeout:5 completion:^(NSArray<NSString *> *values, NSError *error) {
+        XCTAssertNil(error);
+        XCTAssertEqualObjects(values, (@[@"0.4.8.0 (mock)"]));
+
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (void)testPendingRequestFails
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"callback"];
+
+    // Never answered.
+    [self.server setReply:@"" forCommand:@"SIGNAL NEWNYM"];
+
+    [self.controller sendCommand:@"SIGNAL" arguments:@[@"NEWNYM"] data:nil timeout:0
+                      completion:^(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, NSError *error)
+    {
+        XCTAssertEqual(codes.count, 0);
+        XCTAssertEqualObjects(error.domain, TORControllerErrorDomain);
+        XCTAssertEqual(error.code, TORControllerErrorDisconnected);
+
+        [expectation fulfill];
+    }];
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.2 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
+        [self.server stop];
+    });
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (void)testNoReconnectAfterDisconnect
+{
+    TORController *controller = self.controller;
+
+    [controller disconnect];
+
+    [self waitUntil:^BOOL{
+        return !controller.isConnected;
+    }];
+
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:1.5]];
+
+    XCTAssertFalse(controller.isConnected);
+}
+
+
+// MARK: Helper Methods
+
+- (void)waitUntil:(BOOL (^)(void))condition
+{
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+
+    while (!condition() && timeout.timeIntervalSinceNow > 0)
+    {
+        [NSThread sleepForTimeInterval:0.05];
+    }
+
+    XCTAssertTrue(condition());
+}
+
+@end
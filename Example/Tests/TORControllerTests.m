@@ -7,6 +7,7 @@
 
 #import <XCTest/XCTest.h>
 #import <Tor/Tor.h>
+#import <sys/socket.h>
 
 @interface TORControllerTests : XCTestCase
 
@@ -144,6 +145,139 @@
     [self waitForExpectationsWithTimeout:120 handler:nil];
 }
 
+- (void)testBatch
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"batch callbacks"];
+    expectation.expectedFulfillmentCount = 4;
+
+    TORController *controller = self.controller;
+
+    [controller authenticateWithData:self.cookie completion:^(BOOL success, NSError * _Nullable error) {
+        XCTAssertTrue(success);
+
+        [controller performBatch:^{
+            [controller getInfoForKeys:@[@"version", @"config-file"] completion:^(NSArray<NSString *> *values) {
+                XCTAssertEqual(values.count, 2);
+                [expectation fulfill];
+            }];
+
+            // Fails the merged command, so all are retried individually.
+            [controller getInfoForKeys:@[@"no-such-key"] completion:^(NSArray<NSString *> *values) {
+                XCTAssertEqual(values.count, 0);
+                [expectation fulfill];
+            }];
+
+            [controller setConfForKey:@"MaxCircuitDirtiness" withValue:@"600" completion:^(BOOL success, NSError * _Nullable error) {
+                XCTAssertTrue(success);
+                [expectation fulfill];
+            }];
+
+            [controller getInfoForKeys:@[@"version"] completion:^(NSArray<NSString *> *values) {
+                XCTAssertEqual(values.count, 1);
+                [expectation fulfill];
+            }];
+        }];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testInfoCache
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"cached callback"];
+
+    TORController *controller = self.controller;
+    controller.cachesInfo = YES;
+
+    [controller authenticateWithData:self.cookie completion:^(BOOL success, NSError * _Nullable error) {
+        XCTAssertTrue(success);
+
+        [controller getInfoForKeys:@[@"version", @"config-file"] completion:^(NSArray<NSString *> *values) {
+            XCTAssertEqual(values.count, 2);
+
+            [controller getInfoForKeys:@[@"version"] completion:^(NSArray<NSString *> *cached) {
+                XCTAssertEqualObjects(cached.firstObject, values.firstObject);
+
+                // "config-file" has no lifetime, so it's never cached.
+                XCTAssertEqual(controller.infoCacheHits, 1);
+                XCTAssertEqual(controller.infoCacheMisses, 2);
+
+                [expectation fulfill];
+            }];
+        }];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testRequest
+{
+    XCTestExpectation *cancelled = [self expectationWithDescription:@"cancelled callback"];
+    XCTestExpectation *expectation = [self expectationWithDescription:@"callback"];
+
+    TORController *controller = self.controller;
+
+    [controller authenticateWithData:self.cookie completion:^(BOOL success, NSError * _Nullable error) {
+        XCTAssertTrue(success);
+
+        TORControlRequest *request = [controller sendCommand:@"GETINFO" arguments:@[@"config-file"] data:nil timeout:10
+                                                  completion:^(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, NSError *error)
+        {
+            XCTAssertEqual(codes.count, 0);
+            XCTAssertEqualObjects(error.domain, TORControllerErrorDomain);
+            XCTAssertEqual(error.code, TORControllerErrorCancelled);
+
+            [cancelled fulfill];
+        }];
+
+        [request cancel];
+
+        // Whether the cancelled command was sent or not, this still needs to get its own reply.
+        [controller getInfoForKeys:@[@"version"] timeout:10 completion:^(NSArray<NSString *> *values, NSError *error) {
+            XCTAssertNil(error);
+            XCTAssertEqual(values.count, 1);
+            XCTAssertTrue([values.firstObject isKindOfClass:NSString.class]);
+
+            XCTAssertTrue(request.isCancelled);
+
+            [expectation fulfill];
+        }];
+    }];
+
+    [self waitForExpectationsWithTimeout:10 handler:nil];
+}
+
+- (void)testControlSocket
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"callback"];
+
+    int fds[2];
+    XCTAssertEqual(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    TORController *controller = [[TORController alloc] initWithControlSocket:fds[0]];
+    XCTAssertTrue(controller.isConnected);
+
+    // No authentication needed.
+    [controller getInfoForKeys:@[@"version"] completion:^(NSArray<NSString *> *values) {
+        XCTAssertEqualObjects(values, (@[@"0.4.8.0"]));
+
+        [expectation fulfill];
+    }];
+
+    // Plays Tor on the other end.
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+        char command[64];
+        XCTAssertGreaterThan(read(fds[1], command, sizeof(command)), 0);
+
+        const char *reply = "250-version=0.4.8.0\r\n250 OK\r\n";
+        write(fds[1], reply, strlen(reply));
+    });
+
+    [self waitForExpectationsWithTimeout:5 handler:nil];
+
+    close(fds[1]);
+}
+
 
 // MARK: Helper Properties and Methods
 
@@ -0,0 +1,142 @@
+//
+//  TORDirCacheTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+#import <CommonCrypto/CommonDigest.h>
+
+@interface TORDirCacheTests : XCTestCase
+
+@property (nonatomic) NSURL *directory;
+@property (nonatomic) NSURL *cacheDirectory;
+
+@end
+
+@implementation TORDirCacheTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    self.directory = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:NSUUID.UUID.UUIDString];
+    self.cacheDirectory = [self.directory URLByAppendingPathComponent:@"cache"];
+}
+
+- (void)tearDown
+{
+    [NSFileManager.defaultManager removeItemAtURL:self.directory error:nil];
+
+    [super tearDown];
+}
+
+- (void)testInstall
+{
+    NSBundle *bundle = [self bundleValidAfter:@"2026-10-17 12:00:00" tamper:NO];
+
+    XCTAssertEqualObjects(bundle.dirCacheValidAfter, [NSDate dateWithTimeIntervalSince1970:1792238400]);
+
+    NSError *error;
+    XCTAssertTrue([bundle installDirCacheTo:self.cacheDirectory error:&error], @"%@", error);
+
+    XCTAssertEqualObjects([self contentOf:@"cached-microdescs"], @"microdescs");
+    XCTAssertEqualObjects([self contentOf:@"cached-certs"], @"certs");
+
+    NSArray *files = [NSFileManager.defaultManager contentsOfDirectoryAtPath:self.cacheDirectory.path error:nil];
+    XCTAssertEqual(files.count, 3);
+}
+
+- (void)testNewerCacheIsKept
+{
+    NSError *error;
+    XCTAssertTrue([[self bundleValidAfter:@"2026-10-17 13:00:00" tamper:NO] installDirCacheTo:self.cacheDirectory error:&error], @"%@", error);
+
+    NSString *consensus = [self contentOf:@"cached-microdesc-consensus"];
+
+    // Older bundle, e.g. after an app downgrade.
+    XCTAssertTrue([[self bundleValidAfter:@"2026-10-17 12:00:00" tamper:NO] installDirCacheTo:self.cacheDirectory error:&error], @"%@", error);
+    XCTAssertEqualObjects([self contentOf:@"cached-microdesc-consensus"], consensus);
+
+    // Newer bundle, e.g. after an app update.
+    XCTAssertTrue([[self bundleValidAfter:@"2026-10-18 12:00:00" tamper:NO] installDirCacheTo:self.cacheDirectory error:&error], @"%@", error);
+    XCTAssertTrue([[self contentOf:@"cached-microdesc-consensus"] containsString:@"valid-after 2026-10-18 12:00:00"]);
+}
+
+- (void)testCorruptBundle
+{
+    NSError *error;
+    XCTAssertFalse([[self bundleValidAfter:@"2026-10-17 12:00:00" tamper:YES] installDirCacheTo:self.cacheDirectory error:&error]);
+    XCTAssertEqual(error.code, NSFileReadCorruptFileError);
+
+    // Nothing installed, nothing left behind.
+    XCTAssertEqual([NSFileManager.defaultManager contentsOfDirectoryAtPath:self.cacheDirectory.path error:nil].count, 0);
+}
+
+- (void)testEmptyBundle
+{
+    NSError *error;
+    XCTAssertNil(NSBundle.mainBundle.dirCacheValidAfter);
+    XCTAssertFalse([NSBundle.mainBundle installDirCacheTo:self.cacheDirectory error:&error]);
+    XCTAssertEqual(error.code, NSFileReadNoSuchFileError);
+}
+
+
+// MARK: Helper Methods
+
+/**
+ A bundle as packed by `Tor/dircache.sh`.
+ */
+- (NSBundle *)bundleValidAfter:(NSString *)validAfter tamper:(BOOL)tamper
+{
+    NSURL *url = [self.directory URLByAppendingPathComponent:[NSString stringWithFormat:@"%@.bundle", NSUUID.UUID.UUIDString]];
+    [NSFileManager.defaultManager createDirectoryAtURL:url withIntermediateDirectories:YES attributes:nil error:nil];
+
+    NSDictionary<NSString *, NSString *> *files = @{
+        @"cached-microdesc-consensus": [NSString stringWithFormat:
+                                        @"network-status-version 3 microdesc\nvote-status consensus\nconsensus-method 33\nvalid-after %@\n", validAfter],
+        @"cached-microdescs": @"microdescs",
+        @"cached-certs": @"certs",
+    };
+
+    NSMutableDictionary<NSString *, NSString *> *digests = [NSMutableDictionary new];
+
+    for (NSString *name in files)
+    {
+        NSData *data = [files[name] dataUsingEncoding:NSUTF8StringEncoding];
+
+        unsigned char hash[CC_SHA256_DIGEST_LENGTH];
+        CC_SHA256(data.bytes, (CC_LONG)data.length, hash);
+
+        NSMutableString *hex = [NSMutableString new];
+
+        for (NSUInteger i = 0; i < CC_SHA256_DIGEST_LENGTH; i++)
+        {
+            [hex appendFormat:@"%02x", hash[i]];
+        }
+
+        digests[name] = hex;
+
+        if (tamper && [name isEqualToString:@"cached-microdescs"])
+        {
+            data = [@"tampered" dataUsingEncoding:NSUTF8StringEncoding];
+        }
+
+        [data writeToURL:[url URLByAppendingPathComponent:name] atomically:NO];
+    }
+
+    NSData *manifest = [NSJSONSerialization dataWithJSONObject:@{@"valid-after": validAfter, @"files": digests} options:0 error:nil];
+    [manifest writeToURL:[url URLByAppendingPathComponent:@"manifest.json"] atomically:NO];
+
+    return [NSBundle bundleWithURL:url];
+}
+
+- (NSString *)contentOf:(NSString *)name
+{
+    return [NSString stringWithContentsOfURL:[self.cacheDirectory URLByAppendingPathComponent:name]
+                                    encoding:NSUTF8StringEncoding error:nil];
+}
+
+@end
@@ -0,0 +1,128 @@
+//
+//  TORGeoIPDatabaseTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+@interface TORGeoIPDatabaseTests : XCTestCase
+
+@property (nonatomic) TORGeoIPDatabase *database;
+
+@end
+
+@implementation TORGeoIPDatabaseTests
+
+- (void)setUp {
+    [super setUp];
+
+    // Excerpts in the format of Tor's src/config/geoip and geoip6, deliberately out of order.
+    NSString *geoip = @"# Last updated based on February 7 2023 Maxmind GeoLite2 Country\n"
+    "# wget https://geolite.maxmind.com/download/geoip/database/GeoLite2-Country.mmdb.gz\n"
+    "16777216,16777471,AU\n"
+    "3118228736,3118228991,DE\n"
+    "16777472,16778239,CN\n"
+    "3116854784,3116855039,US\r\n";
+
+    NSString *geoip6 = @"# Last updated based on February 7 2023 Maxmind GeoLite2 Country\n"
+    "2001:200::,2001:200:ffff:ffff:ffff:ffff:ffff:ffff,JP\n"
+    "2a0b:f4c0::,2a0b:f4c7:ffff:ffff:ffff:ffff:ffff:ffff,DE\n"
+    "2001:218::,2001:218:ffff:ffff:ffff:ffff:ffff:ffff,JP\n";
+
+    self.database = [[TORGeoIPDatabase alloc] initWithGeoipFile:[self write:geoip name:@"geoip"]
+                                                     geoip6File:[self write:geoip6 name:@"geoip6"]];
+}
+
+- (void)testLoad {
+    XCTAssertEqual(self.database.ipv4RangeCount, 4);
+    XCTAssertEqual(self.database.ipv6RangeCount, 3);
+
+    XCTAssertNil([[TORGeoIPDatabase alloc] initWithGeoipFile:[NSURL fileURLWithPath:@"/nonexistent"] geoip6File:nil]);
+}
+
+- (void)testIpv4 {
+    XCTAssertEqualObjects([self.database countryCodeForAddress:@"1.0.0.0"], @"au");
+    XCTAssertEqualObjects([self.database countryCodeForAddress:@"1.0.0.255"], @"au");
+    XCTAssertEqualObjects([self.database countryCodeForAddress:@"1.0.1.0"], @"cn");
+    XCTAssertEqualObjects([self.database countryCodeForAddress:@"185.220.101.33"], @"de");
+    XCTAssertEqualObjects([self.database countryCodeForAddress:@"185.199.110.1"], @"us");
+
+    XCTAssertNil([self.database countryCodeForAddress:@"0.255.255.255"]);
+    XCTAssertNil([self.database countryCodeForAddress:@"1.0.4.0"]);
+    XCTAssertNil([self.database countryCodeForAddress:@"255.255.255.255"]);
+    XCTAssertNil([self.database countryCodeForAddress:@"no address"]);
+}
+
+- (void)testIpv6 {
+    XCTAssertEqualObjects([self.database countryCodeForAddress:@"2001:200::1"], @"jp");
+    XCTAssertEqualObjects([self.database countryCodeForAddress:@"2a0b:f4c2:2::33"], @"de");
+
+    XCTAssertNil([self.database countryCodeForAddress:@"2001:210::1"]);
+    XCTAssertNil([self.database countryCodeForAddress:@"::1"]);
+}
+
+- (void)testBatch {
+    NSDictionary *countryCodes = [self.database countryCodesForAddresses:@[@"1.0.0.1", @"2001:218::1", @"127.0.0.1"]];
+
+    XCTAssertEqualObjects(countryCodes, (@{@"1.0.0.1": @"au", @"2001:218::1": @"jp"}));
+
+    TORNode *node1 = [TORNode new];
+    node1.ipv4Address = @"185.220.101.33";
+    node1.ipv6Address = @"2001:200::1";
+
+    TORNode *node2 = [TORNode new];
+    node2.ipv6Address = @"2001:200::1";
+
+    TORNode *node3 = [TORNode new];
+    node3.ipv4Address = @"1.0.0.1";
+    node3.countryCode = @"at";
+
+    [self.database resolveCountriesOfNodes:@[node1, node2, node3]];
+
+    XCTAssertEqualObjects(node1.countryCode, @"de");
+    XCTAssertEqualObjects(node2.countryCode, @"jp");
+    XCTAssertEqualObjects(node3.countryCode, @"at");
+}
+
+- (void)testPerformance {
+    NSMutableString *geoip = [NSMutableString new];
+
+    for (uint32_t i = 0; i < 200000; i++)
+    {
+        [geoip appendFormat:@"%u,%u,%c%c\n", i * 16384, i * 16384 + 8191, 'A' + i % 26, 'A' + i / 26 % 26];
+    }
+
+    TORGeoIPDatabase *database = [[TORGeoIPDatabase alloc] initWithGeoipFile:[self write:geoip name:@"geoip-large"] geoip6File:nil];
+
+    XCTAssertEqual(database.ipv4RangeCount, 200000);
+
+    NSMutableArray<NSString *> *addresses = [NSMutableArray new];
+
+    for (uint32_t i = 0; i < 100000; i++)
+    {
+        uint32_t address = arc4random();
+
+        [addresses addObject:[NSString stringWithFormat:@"%u.%u.%u.%u", address >> 24, address >> 16 & 255, address >> 8 & 255, address & 255]];
+    }
+
+    [self measureBlock:^{
+        [database countryCodesForAddresses:addresses];
+    }];
+}
+
+
+// MARK: Helper Methods
+
+- (NSURL *)write:(NSString *)content name:(NSString *)name
+{
+    NSURL *url = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:name];
+
+    [content writeToURL:url atomically:YES encoding:NSUTF8StringEncoding error:nil];
+
+    return url;
+}
+
+@end
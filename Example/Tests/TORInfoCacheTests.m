@@ -0,0 +1,141 @@
+//
+//  TORInfoCacheTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+#import "TORMockControlServer.h"
+
+/**
+ Checks, which events the info cache of @c TORController subscribes to and how they evict cached values.
+ */
+@interface TORInfoCacheTests : XCTestCase
+
+@property (nonatomic) TORMockControlServer *server;
+@property (nonatomic) TORController *controller;
+
+@end
+
+@implementation TORInfoCacheTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSError *error;
+    self.server = [TORMockControlServer startedServer:&error];
+    XCTAssertNotNil(self.server, @"%@", error);
+
+    [self.server setInfo:@"r Relay0 AAAA 2026-10-17 00:00:00 10.0.0.1 9001 0" forKey:@"ns/id/AAAA"];
+
+    self.controller = [self.server connectedController];
+    XCTAssertTrue(self.controller.isConnected);
+}
+
+- (void)tearDown
+{
+    [self.server stop];
+
+    [super tearDown];
+}
+
+- (void)testNewConsensusEvictsNetworkStatus
+{
+    TORController *controller = self.controller;
+    controller.cachesInfo = YES;
+
+    // Nothing from "ns/" cached, yet, so no consensus is sent.
+    NSString *events = [self waitForSetEvents:^BOOL(NSString *command) {
+        return [command containsString:@"CONF_CHANGED"];
+    }];
+
+    XCTAssertFalse([events containsString:@"NEWCONSENSUS"], @"%@", events);
+
+    XCTAssertEqual([self infoForKeys:@[@"ns/id/AAAA"]].count, 1);
+    XCTAssertEqual([self infoForKeys:@[@"ns/id/AAAA"]].count, 1);
+    XCTAssertEqual(controller.infoCacheHits, 1);
+
+    [self waitForSetEvents:^BOOL(NSString *command) {
+        return [command containsString:@"NEWCONSENSUS"];
+    }];
+
+    NSUInteger misses = controller.infoCacheMisses;
+
+    // The keyword is followed by the data block, not by a space.
+    [self.server sendRaw:@"650+NEWCONSENSUS\r\nr Relay0 AAAA 2026-10-17 01:00:00 10.0.0.1 9001 0\r\n.\r\n650 OK\r\n"];
+
+    // Goes out after the event, so the event was handled, when this returns.
+    [self infoForKeys:@[@"config-file"]];
+
+    // No "ns/" key left, so the subscription ends.
+    events = [self waitForSetEvents:^BOOL(NSString *command) {
+        return ![command containsString:@"NEWCONSENSUS"];
+    }];
+
+    XCTAssertFalse([events containsString:@"NEWCONSENSUS"], @"%@", events);
+
+    XCTAssertEqual([self infoForKeys:@[@"ns/id/AAAA"]].count, 1);
+    XCTAssertEqual(controller.infoCacheHits, 1);
+    XCTAssertEqual(controller.infoCacheMisses, misses + 2);
+}
+
+
+// MARK: Helper Methods
+
+- (NSArray<NSString *> *)infoForKeys:(NSArray<NSString *> *)keys
+{
+    XCTestExpectation *expectation = [self expectationWithDescription:@"info"];
+    __block NSArray<NSString *> *result;
+
+    [self.controller getInfoForKeys:keys completion:^(NSArray<NSString *> *values) {
+        result = values;
+
+        [expectation fulfill];
+    }];
+
+    [self waitForExpectations:@[expectation] timeout:5];
+
+    return result ?: @[];
+}
+
+/**
+ Subscriptions are sent asynchronously, so wait until the last one matches.
+
+ @return The last @c SETEVENTS command sent.
+ */
+- (nullable NSString *)waitForSetEvents:(BOOL (^)(NSString *command))condition
+{
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+    NSString *last;
+
+    while (timeout.timeIntervalSinceNow > 0)
+    {
+        last = nil;
+
+        for (NSString *command in self.server.commands.reverseObjectEnumerator)
+        {
+            if ([command hasPrefix:@"SETEVENTS"])
+            {
+                last = command;
+                break;
+            }
+        }
+
+        if (last && condition(last))
+        {
+            return last;
+        }
+
+        [NSThread sleepForTimeInterval:0.01];
+    }
+
+    XCTFail(@"Last SETEVENTS didn't match: %@", last);
+
+    return last;
+}
+
+@end
@@ -0,0 +1,102 @@
+//
+//  TORLogFileWriterTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+@interface TORLogFileWriterTests : XCTestCase
+
+@property (nonatomic) NSURL *url;
+
+@end
+
+@implementation TORLogFileWriterTests
+
+- (void)setUp {
+    [super setUp];
+
+    self.url = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:NSUUID.UUID.UUIDString];
+}
+
+- (void)tearDown {
+    NSFileManager *fm = NSFileManager.defaultManager;
+
+    for (NSString *suffix in @[@"", @".1", @".2", @".3"])
+    {
+        [fm removeItemAtPath:[self.url.path stringByAppendingString:suffix] error:nil];
+    }
+
+    [super tearDown];
+}
+
+- (void)testStripAnsiEscapes {
+    char message[] = "\x1b[2m2023-02-02T12:00:00Z\x1b[0m \x1b[32m INFO\x1b[0m arti: \x1b[1;31mDirectory\x1b[0m is complete. \x1b[2J\x1b[";
+
+    size_t length = [TORLogFileWriter stripAnsiEscapes:message length:strlen(message)];
+
+    XCTAssertEqualObjects([[NSString alloc] initWithBytes:message length:length encoding:NSUTF8StringEncoding],
+                          @"2023-02-02T12:00:00Z  INFO arti: Directory is complete. \x1b[2J\x1b[");
+}
+
+- (void)testWrite {
+    TORLogFileWriter *writer = [[TORLogFileWriter alloc] initWithURL:self.url];
+
+    [writer writeCString:"\x1b[32mfirst\x1b[0m\n"];
+    [writer writeLine:@"second"];
+    [writer flush];
+
+    XCTAssertEqualObjects([self read:self.url.path], @"first\nsecond\n");
+
+    [writer writeLine:@"third"];
+    [writer close];
+    [writer writeLine:@"ignored"];
+
+    XCTAssertEqualObjects([self read:self.url.path], @"first\nsecond\nthird\n");
+}
+
+- (void)testRotation {
+    TORLogFileWriter *writer = [[TORLogFileWriter alloc] initWithURL:self.url maxFileSize:10 maxFiles:2];
+    writer.flushThreshold = 1;
+
+    for (NSString *line in @[@"aaaaaa", @"bbbbbb", @"cccccc", @"dddddd"])
+    {
+        [writer writeLine:line];
+        [writer flush];
+    }
+
+    [writer close];
+
+    XCTAssertEqualObjects([self read:self.url.path], @"dddddd\n");
+    XCTAssertEqualObjects([self read:[self.url.path stringByAppendingString:@".1"]], @"cccccc\n");
+    XCTAssertEqualObjects([self read:[self.url.path stringByAppendingString:@".2"]], @"bbbbbb\n");
+    XCTAssertNil([self read:[self.url.path stringByAppendingString:@".3"]]);
+}
+
+- (void)testPerformance {
+    TORLogFileWriter *writer = [[TORLogFileWriter alloc] initWithURL:self.url maxFileSize:10 * 1024 * 1024 maxFiles:1];
+
+    const char *message = "\x1b[2m2023-02-02T12:00:00.123456Z\x1b[0m \x1b[32m INFO\x1b[0m \x1b[2mtor_dirmgr\x1b[0m\x1b[2m:\x1b[0m Marked consensus usable.\n";
+
+    [self measureBlock:^{
+        for (int i = 0; i < 100000; i++)
+        {
+            [writer writeCString:message];
+        }
+
+        [writer flush];
+    }];
+}
+
+
+// MARK: Helper Methods
+
+- (nullable NSString *)read:(NSString *)path
+{
+    return [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:nil];
+}
+
+@end
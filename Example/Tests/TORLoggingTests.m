@@ -0,0 +1,240 @@
+//
+//  TORLoggingTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+#import <Tor/TORLogRing.h>
+#import <stdatomic.h>
+
+static _Atomic NSUInteger debugMessages;
+
+static void TORLoggingTestsCallback(os_log_type_t type, const char * __unused msg)
+{
+    if (type == OS_LOG_TYPE_DEBUG)
+    {
+        atomic_fetch_add(&debugMessages, 1);
+    }
+}
+
+@interface TORLoggingTests : XCTestCase
+
+@end
+
+@implementation TORLoggingTests
+{
+    TORLogRing *_ring;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    _ring = calloc(1, sizeof(TORLogRing));
+}
+
+- (void)tearDown
+{
+    free(_ring);
+
+    TORSetLogSeverity(TORLogDomainAll, TORLogSeverityDebug);
+
+    [super tearDown];
+}
+
+
+// MARK: Ring Buffer
+
+- (void)testRingWrapAround
+{
+    [self push:1000 from:0];
+
+    NSArray<NSArray<NSString *> *> *runs = [self drain];
+    XCTAssertEqual(runs.count, 1);
+    XCTAssertEqual(runs.firstObject.count, 1000);
+
+    // 24 slots left before the end of the buffer, the rest starts at its beginning again.
+    [self push:100 from:1000];
+
+    runs = [self drain];
+    XCTAssertEqual(runs.count, 2);
+    XCTAssertEqual(runs[0].count, 24);
+    XCTAssertEqual(runs[1].count, 76);
+    XCTAssertEqualObjects(runs[0].firstObject, @"message 1000");
+    XCTAssertEqualObjects(runs[0].lastObject, @"message 1023");
+    XCTAssertEqualObjects(runs[1].firstObject, @"message 1024");
+    XCTAssertEqualObjects(runs[1].lastObject, @"message 1099");
+
+    XCTAssertEqual([self drain].count, 0);
+    XCTAssertEqual(atomic_load(&_ring->dropped), 0);
+}
+
+- (void)testRingOverflow
+{
+    [self push:TOR_LOG_RING_CAPACITY from:0];
+
+    XCTAssertFalse(TORLogRingPush(_ring, OS_LOG_TYPE_INFO, TORLogDomainGeneral, "dropped 1"));
+    XCTAssertFalse(TORLogRingPush(_ring, OS_LOG_TYPE_INFO, TORLogDomainGeneral, "dropped 2"));
+    XCTAssertEqual(atomic_load(&_ring->dropped), 2);
+
+    __block uint64_t dropped = 0;
+    __block size_t count = 0;
+
+    TORLogRingDrain(_ring, ^(const TORLogEntry *entries, size_t c, uint64_t d) {
+        count += c;
+        dropped = d;
+
+        // The entries which made it in are untouched.
+        XCTAssertEqual(strcmp(entries[c - 1].message, "message 1023"), 0);
+    });
+
+    XCTAssertEqual(count, TOR_LOG_RING_CAPACITY);
+    XCTAssertEqual(dropped, 2);
+
+    // Room again.
+    [self push:1 from:TOR_LOG_RING_CAPACITY];
+    XCTAssertEqual(atomic_load(&_ring->dropped), 2);
+    XCTAssertEqualObjects([self drain].firstObject, @[@"message 1024"]);
+}
+
+- (void)testRingHalfFull
+{
+    for (NSUInteger i = 0; i < TOR_LOG_RING_CAPACITY; i++)
+    {
+        BOOL halfFull = TORLogRingPush(_ring, OS_LOG_TYPE_INFO, TORLogDomainGeneral, "message");
+
+        // Asks for an early drain exactly once on the way up.
+        XCTAssertEqual(halfFull, i + 1 == TOR_LOG_RING_CAPACITY / 2, @"i=%lu", (unsigned long)i);
+    }
+
+    // Again, after draining and filling up.
+    [self drain];
+
+    NSUInteger signals = 0;
+
+    for (NSUInteger i = 0; i < TOR_LOG_RING_CAPACITY / 2; i++)
+    {
+        signals += TORLogRingPush(_ring, OS_LOG_TYPE_INFO, TORLogDomainGeneral, "message");
+    }
+
+    XCTAssertEqual(signals, 1);
+}
+
+- (void)testRingEntry
+{
+    char message[TOR_LOG_ENTRY_MESSAGE_SIZE + 100];
+    memset(message, 'x', sizeof(message) - 1);
+    message[sizeof(message) - 1] = 0;
+
+    TORLogRingPush(_ring, OS_LOG_TYPE_ERROR, TORLogDomainCirc, message);
+
+    TORLogRingDrain(_ring, ^(const TORLogEntry *entries, size_t count, uint64_t __unused dropped) {
+        XCTAssertEqual(count, 1);
+        XCTAssertEqual(entries[0].type, OS_LOG_TYPE_ERROR);
+        XCTAssertEqual(entries[0].domain, TORLogDomainCirc);
+        XCTAssertGreaterThan(entries[0].timestamp.tv_sec, 0);
+
+        // Truncated, but terminated.
+        XCTAssertEqual(strlen(entries[0].message), TOR_LOG_ENTRY_MESSAGE_SIZE - 1);
+    });
+}
+
+
+// MARK: Severities
+
+- (void)testSeverityPerDomain
+{
+    TORSetLogSeverity(TORLogDomainAll, TORLogSeverityNotice);
+    TORSetLogSeverity(TORLogDomainCirc | TORLogDomainGuard, TORLogSeverityDebug);
+    TORSetLogSeverity(TORLogDomainBug, TORLogSeverityNone);
+
+    XCTAssertEqual(TORGetLogSeverity(TORLogDomainNet), TORLogSeverityNotice);
+    XCTAssertEqual(TORGetLogSeverity(TORLogDomainCirc), TORLogSeverityDebug);
+    XCTAssertEqual(TORGetLogSeverity(TORLogDomainGuard), TORLogSeverityDebug);
+    XCTAssertEqual(TORGetLogSeverity(TORLogDomainBug), TORLogSeverityNone);
+
+    XCTAssertTrue(TORLogSeverityEnabled(TORLogDomainNet, TORLogSeverityNotice));
+    XCTAssertFalse(TORLogSeverityEnabled(TORLogDomainNet, TORLogSeverityInfo));
+    XCTAssertTrue(TORLogSeverityEnabled(TORLogDomainCirc, TORLogSeverityDebug));
+    XCTAssertFalse(TORLogSeverityEnabled(TORLogDomainBug, TORLogSeverityError));
+
+    // Of several domains, the lowest one counts: Circ is below Bug, Net is below Circ.
+    XCTAssertTrue(TORLogSeverityEnabled(TORLogDomainCirc | TORLogDomainBug, TORLogSeverityDebug));
+    XCTAssertFalse(TORLogSeverityEnabled(TORLogDomainNet | TORLogDomainCirc, TORLogSeverityDebug));
+    XCTAssertEqual(TORGetLogSeverity(TORLogDomainNet | TORLogDomainCirc), TORLogSeverityNotice);
+
+    // Tor's flags in the upper bits, like LD_NOFUNCNAME, are no domains.
+    XCTAssertTrue(TORLogSeverityEnabled(TORLogDomainCirc | (1ULL << 63), TORLogSeverityDebug));
+
+    // Messages without a domain aren't filtered.
+    XCTAssertTrue(TORLogSeverityEnabled(0, TORLogSeverityDebug));
+    XCTAssertEqual(TORGetLogSeverity(0), TORLogSeverityNone);
+}
+
+/**
+ Thresholds changed after installation need to reach Tor, which otherwise never hands over more than it did at install time.
+ */
+- (void)testSeverityAfterInstall
+{
+    XCTSkipIf(TORThread.activeThread == nil, @"Needs a running Tor, e.g. the one TORControllerTests starts.");
+
+    TORSetLogSeverity(TORLogDomainAll, TORLogSeverityNotice);
+    TORInstallTorLoggingCallback(TORLoggingTestsCallback);
+
+    [NSThread sleepForTimeInterval:0.5];
+    atomic_store(&debugMessages, 0);
+    [NSThread sleepForTimeInterval:1];
+
+    XCTAssertEqual(atomic_load(&debugMessages), 0);
+
+    TORSetLogSeverity(TORLogDomainAll, TORLogSeverityDebug);
+
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:10];
+
+    while (atomic_load(&debugMessages) == 0 && timeout.timeIntervalSinceNow > 0)
+    {
+        [NSThread sleepForTimeInterval:0.1];
+    }
+
+    XCTAssertGreaterThan(atomic_load(&debugMessages), 0);
+}
+
+
+// MARK: Helper Methods
+
+- (void)push:(NSUInteger)count from:(NSUInteger)first
+{
+    for (NSUInteger i = first; i < first + count; i++)
+    {
+        char message[32];
+        snprintf(message, sizeof(message), "message %lu", (unsigned long)i);
+
+        TORLogRingPush(_ring, OS_LOG_TYPE_INFO, TORLogDomainGeneral, message);
+    }
+}
+
+/**
+ @return The messages of each contiguous run handed to the consumer.
+ */
+- (NSArray<NSArray<NSString *> *> *)drain
+{
+    NSMutableArray<NSArray<NSString *> *> *runs = [NSMutableArray new];
+
+    TORLogRingDrain(_ring, ^(const TORLogEntry *entries, size_t count, uint64_t __unused dropped) {
+        NSMutableArray<NSString *> *run = [NSMutableArray new];
+
+        for (size_t i = 0; i < count; i++)
+        {
+            [run addObject:@(entries[i].message)];
+        }
+
+        [runs addObject:run];
+    });
+
+    return runs;
+}
+
+@end
@@ -0,0 +1,113 @@
+//
+//  TORMockControlServer.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+
+@class TORController;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ An in-process stand-in for Tor's control port on a Unix socket, which replays canned replies.
+
+ Commands are answered strictly in order, like Tor does. All replies to the commands found in one
+ read are written back in one go.
+
+ - Commands, for which a reply was set with @c -setReply:forCommand:, get exactly that reply.
+ - @c GETINFO is answered from the values set with @c -setInfo:forKey:. Multi-line values are sent
+   as data blocks. Unknown keys get a 552 reply.
+ - Everything else gets "250 OK".
+ */
+@interface TORMockControlServer : NSObject
+
+/**
+ The socket to connect a @c TORController to.
+ */
+@property (readonly) NSURL *socketURL;
+
+/**
+ The number of commands answered so far.
+ */
+@property (readonly) NSUInteger commandCount;
+
+/**
+ All command lines answered so far, in the order they were read, without CR-LF and data blocks.
+ */
+@property (readonly) NSArray<NSString *> *commands;
+
+/**
+ @param index The number of the client in the order they connected, starting at 0.
+
+ @return The command lines answered so far to that client only, like @c commands.
+ */
+- (NSArray<NSString *> *)commandsOfClient:(NSUInteger)index;
+
+/**
+ A new server, which already listens.
+
+ @return nil, if it couldn't be started.
+ */
++ (nullable instancetype)startedServer:(out NSError **)error;
+
+- (BOOL)start:(out NSError **)error;
+
+- (void)stop;
+
+/**
+ A new controller connected to this server.
+
+ Only returns, once the server accepted the connection, so raw text sent afterwards reaches it.
+ Check @c isConnected on the result.
+ */
+- (TORController *)connectedController;
+
+/**
+ @param reply The raw reply including all CR-LFs, e.g. "250 OK\r\n".
+ @param command The full command line without CR-LF, e.g. "SIGNAL NEWNYM".
+ */
+- (void)setReply:(NSString *)reply forCommand:(NSString *)command;
+
+/**
+ @param value The value to answer @c GETINFO with, or nil to make the key unknown.
+    Lines may be separated by CR-LF or LF.
+ */
+- (void)setInfo:(nullable NSString *)value forKey:(NSString *)key;
+
+/**
+ Write raw text to all connected clients, e.g. a burst of asynchronous events.
+
+ Goes out after all replies to commands read so far.
+ */
+- (void)sendRaw:(NSString *)text;
+
+
+// MARK: Transcripts
+
+/**
+ A reply line for one @c GETINFO key, as a data block, if the value has more than one line.
+ */
++ (NSString *)infoReplyLineForKey:(NSString *)key value:(NSString *)value;
+
+/**
+ A consensus as returned by "GETINFO ns/all" with the given number of relays.
+ */
++ (NSString *)consensusWithRelays:(NSUInteger)count;
+
+/**
+ A value for "GETINFO circuit-status" with the given number of built 3-hop circuits over the
+ relays of @c +consensusWithRelays:.
+ */
++ (NSString *)circuitStatusWithCircuits:(NSUInteger)count relays:(NSUInteger)relays;
+
+/**
+ A burst of 650 CIRC events, which alternately build and close circuits, starting at the given ID.
+ */
++ (NSString *)circuitEvents:(NSUInteger)count relays:(NSUInteger)relays firstId:(NSUInteger)firstId;
+
+@end
+
+NS_ASSUME_NONNULL_END
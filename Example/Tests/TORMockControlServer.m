@@ -0,0 +1,538 @@
+//
+//  TORMockControlServer.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORMockControlServer.h"
+
+#import <Tor/Tor.h>
+#import <sys/socket.h>
+#import <sys/un.h>
+#import <unistd.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation TORMockControlServer {
+    dispatch_queue_t _queue;
+    int _listener;
+    dispatch_source_t _acceptSource;
+
+    // All of these are only accessed on `_queue`.
+    NSMutableArray<dispatch_io_t> *_clients;
+    NSMutableDictionary<NSString *, NSString *> *_replies;
+    NSMutableDictionary<NSString *, NSString *> *_info;
+    NSUInteger _commandCount;
+    NSMutableArray<NSString *> *_commands;
+    NSMutableArray<NSMutableArray<NSString *> *> *_clientCommands;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+
+    if (self)
+    {
+        static NSUInteger counter = 0;
+
+        // Socket paths are limited to 104 bytes. The temporary directory of an app is too deep for that.
+        _socketURL = [NSURL fileURLWithPath:[NSString stringWithFormat:@"/tmp/tor-mock-%d-%lu.sock",
+                                             getpid(), (unsigned long)++counter]];
+
+        _queue = dispatch_queue_create("org.torproject.Tor.mockcontrol", DISPATCH_QUEUE_SERIAL);
+        _listener = -1;
+        _clients = [NSMutableArray new];
+        _replies = [NSMutableDictionary new];
+        _commands = [NSMutableArray new];
+        _clientCommands = [NSMutableArray new];
+        _info = [@{
+            @"version": @"0.4.8.0 (mock)",
+            @"config-file": @"/dev/null",
+            @"net/listeners/socks": @"\"127.0.0.1:9050\"",
+            @"status/circuit-established": @"1",
+            @"ip-to-country/ipv4-available": @"0",
+            @"ip-to-country/ipv6-available": @"0",
+            @"circuit-status": @"",
+            @"ns/all": @"",
+        } mutableCopy];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [self stop];
+}
+
+
+// MARK: Public Properties
+
+- (NSUInteger)commandCount
+{
+    __block NSUInteger count;
+
+    dispatch_sync(_queue, ^{
+        count = self->_commandCount;
+    });
+
+    return count;
+}
+
+- (NSArray<NSString *> *)commands
+{
+    __block NSArray<NSString *> *commands;
+
+    dispatch_sync(_queue, ^{
+        commands = [self->_commands copy];
+    });
+
+    return commands;
+}
+
+
+// MARK: Public Methods
+
+- (NSArray<NSString *> *)commandsOfClient:(NSUInteger)index
+{
+    __block NSArray<NSString *> *commands;
+
+    dispatch_sync(_queue, ^{
+        commands = index < self->_clientCommands.count ? [self->_clientCommands[index] copy] : @[];
+    });
+
+    return commands;
+}
+
++ (nullable instancetype)startedServer:(out NSError **)error
+{
+    TORMockControlServer *server = [self new];
+
+    return [server start:error] ? server : nil;
+}
+
+- (BOOL)start:(out NSError **)error
+{
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, _socketURL.fileSystemRepresentation, sizeof(addr.sun_path) - 1);
+    addr.sun_len = (unsigned char)SUN_LEN(&addr);
+
+    unlink(addr.sun_path);
+
+    _listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (_listener < 0
+        || bind(_listener, (struct sockaddr *)&addr, addr.sun_len) != 0
+        || listen(_listener, 16) != 0)
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        }
+
+        [self stop];
+
+        return NO;
+    }
+
+    _acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, (uintptr_t)_listener, 0, _queue);
+
+    __weak TORMockControlServer *weakSelf = self;
+
+    dispatch_source_set_event_handler(_acceptSource, ^{
+        [weakSelf acceptClient];
+    });
+
+    int listener = _listener;
+
+    dispatch_source_set_cancel_handler(_acceptSource, ^{
+        close(listener);
+    });
+
+    dispatch_resume(_acceptSource);
+
+    return YES;
+}
+
+- (TORController *)connectedController
+{
+    __block NSUInteger accepted;
+
+    dispatch_sync(_queue, ^{
+        accepted = self->_clientCommands.count;
+    });
+
+    // Connects right away.
+    TORController *controller = [[TORController alloc] initWithSocketURL:_socketURL];
+
+    NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:5];
+
+    while (controller.isConnected && timeout.timeIntervalSinceNow > 0)
+    {
+        __block BOOL done;
+
+        dispatch_sync(_queue, ^{
+            done = self->_clientCommands.count > accepted;
+        });
+
+        if (done)
+        {
+            break;
+        }
+
+        [NSThread sleepForTimeInterval:0.001];
+    }
+
+    return controller;
+}
+
+- (void)stop
+{
+    if (_acceptSource)
+    {
+        dispatch_source_cancel(_acceptSource);
+        _acceptSource = nil;
+    }
+    else if (_listener >= 0)
+    {
+        close(_listener);
+    }
+
+    _listener = -1;
+
+    NSMutableArray<dispatch_io_t> *clients = _clients;
+
+    dispatch_async(_queue, ^{
+        for (dispatch_io_t channel in clients)
+        {
+            dispatch_io_close(channel, DISPATCH_IO_STOP);
+        }
+
+        [clients removeAllObjects];
+    });
+
+    unlink(_socketURL.fileSystemRepresentation);
+}
+
+- (void)setReply:(NSString *)reply forCommand:(NSString *)command
+{
+    dispatch_async(_queue, ^{
+        self->_replies[command] = reply;
+    });
+}
+
+- (void)setInfo:(nullable NSString *)value forKey:(NSString *)key
+{
+    dispatch_async(_queue, ^{
+        self->_info[key] = value;
+    });
+}
+
+- (void)sendRaw:(NSString *)text
+{
+    NSData *data = [text dataUsingEncoding:NSUTF8StringEncoding];
+
+    dispatch_async(_queue, ^{
+        for (dispatch_io_t channel in self->_clients)
+        {
+            [self write:data to:channel];
+        }
+    });
+}
+
+
+// MARK: Transcripts
+
++ (NSString *)infoReplyLineForKey:(NSString *)key value:(NSString *)value
+{
+    if ([value rangeOfString:@"\n"].location == NSNotFound)
+    {
+        return [NSString stringWithFormat:@"250-%@=%@\r\n", key, value];
+    }
+
+    NSMutableString *reply = [NSMutableString stringWithFormat:@"250+%@=\r\n", key];
+
+    for (NSString *line in [[value stringByReplacingOccurrencesOfString:@"\r\n" withString:@"\n"]
+                            componentsSeparatedByString:@"\n"])
+    {
+        // Dot-stuffing, see https://spec.torproject.org/control-spec/protocol-outline.html
+        [reply appendString:[line hasPrefix:@"."] ? @"." : @""];
+        [reply appendString:line];
+        [reply appendString:@"\r\n"];
+    }
+
+    [reply appendString:@".\r\n"];
+
+    return reply;
+}
+
++ (NSString *)consensusWithRelays:(NSUInteger)count
+{
+    NSMutableString *consensus = [NSMutableString new];
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        NSString *identity = [[[self identityOfRelay:i] base64EncodedStringWithOptions:0]
+                              stringByReplacingOccurrencesOfString:@"=" withString:@""];
+
+        [consensus appendFormat:@"r Relay%lu %@ epP7Gxm+NYhwC3V7SPORQCPoVgc 2022-11-18 00:01:48 10.%lu.%lu.%lu 9001 0\r\n"
+         "s Fast Guard Running Stable Valid\r\n"
+         "w Bandwidth=%lu\r\n",
+         (unsigned long)i, identity, (unsigned long)(i >> 16 & 0xff), (unsigned long)(i >> 8 & 0xff), (unsigned long)(i & 0xff),
+         (unsigned long)(1000 + i)];
+    }
+
+    return consensus;
+}
+
++ (NSString *)circuitStatusWithCircuits:(NSUInteger)count relays:(NSUInteger)relays
+{
+    NSMutableArray<NSString *> *lines = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        [lines addObject:[NSString stringWithFormat:@"%lu BUILT %@ BUILD_FLAGS=NEED_CAPACITY PURPOSE=GENERAL TIME_CREATED=2022-11-18T00:01:48.000000",
+                          (unsigned long)(i + 1), [self pathOfCircuit:i relays:relays]]];
+    }
+
+    return [lines componentsJoinedByString:@"\r\n"];
+}
+
++ (NSString *)circuitEvents:(NSUInteger)count relays:(NSUInteger)relays firstId:(NSUInteger)firstId
+{
+    NSMutableString *events = [NSMutableString new];
+
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        NSUInteger circuitId = firstId + i / 2;
+
+        if (i % 2 == 0)
+        {
+            [events appendFormat:@"650 CIRC %lu BUILT %@ PURPOSE=GENERAL TIME_CREATED=2022-11-18T00:01:48.000000\r\n",
+             (unsigned long)circuitId, [self pathOfCircuit:circuitId relays:relays]];
+        }
+        else {
+            [events appendFormat:@"650 CIRC %lu CLOSED %@ PURPOSE=GENERAL REASON=FINISHED\r\n",
+             (unsigned long)circuitId, [self pathOfCircuit:circuitId relays:relays]];
+        }
+    }
+
+    return events;
+}
+
+
+// MARK: Private Methods
+
+/**
+ Needs to be called on `_queue`.
+ */
+- (void)acceptClient
+{
+    int fd = accept(_listener, NULL, NULL);
+
+    if (fd < 0)
+    {
+        return;
+    }
+
+    dispatch_io_t channel = dispatch_io_create(DISPATCH_IO_STREAM, fd, _queue, ^(int __unused error) {
+        close(fd);
+    });
+
+    if (!channel)
+    {
+        close(fd);
+
+        return;
+    }
+
+    [_clients addObject:channel];
+
+    NSMutableArray<NSString *> *commands = [NSMutableArray new];
+    [_clientCommands addObject:commands];
+
+    NSMutableData *buffer = [NSMutableData new];
+    __weak TORMockControlServer *weakSelf = self;
+
+    dispatch_io_set_low_water(channel, 1);
+    dispatch_io_read(channel, 0, SIZE_MAX, _queue, ^(bool done, dispatch_data_t _Nullable data, int __unused error) {
+        TORMockControlServer *strongSelf = weakSelf;
+
+        if (data && strongSelf)
+        {
+            dispatch_data_apply(data, ^bool(dispatch_data_t __unused region, size_t __unused offset, const void *bytes, size_t size) {
+                [buffer appendBytes:bytes length:size];
+
+                return true;
+            });
+
+            NSData *replies = [strongSelf repliesForBuffer:buffer commands:commands];
+
+            if (replies.length > 0)
+            {
+                [strongSelf write:replies to:channel];
+            }
+        }
+
+        if (done)
+        {
+            if (strongSelf)
+            {
+                [strongSelf->_clients removeObject:channel];
+            }
+
+            dispatch_io_close(channel, DISPATCH_IO_STOP);
+        }
+    });
+}
+
+/**
+ Consumes all complete commands from the buffer.
+
+ Needs to be called on `_queue`.
+
+ @param commands The commands of the client, the buffer belongs to.
+
+ @return The replies to these commands.
+ */
+- (NSData *)repliesForBuffer:(NSMutableData *)buffer commands:(NSMutableArray<NSString *> *)commands
+{
+    NSMutableData *replies = [NSMutableData new];
+
+    const char *bytes = buffer.bytes;
+    size_t length = buffer.length;
+    size_t pos = 0;
+
+    while (pos < length)
+    {
+        const char *crlf = memmem(bytes + pos, length - pos, "\r\n", 2);
+
+        if (!crlf)
+        {
+            break;
+        }
+
+        size_t lineEnd = (size_t)(crlf - bytes);
+        size_t next = lineEnd + 2;
+        BOOL hasData = bytes[pos] == '+';
+
+        if (hasData)
+        {
+            // The data block ends with a line containing only a dot.
+            const char *end = memmem(bytes + lineEnd, length - lineEnd, "\r\n.\r\n", 5);
+
+            if (!end)
+            {
+                break;
+            }
+
+            next = (size_t)(end - bytes) + 5;
+        }
+
+        size_t start = pos + (hasData ? 1 : 0);
+        NSString *command = [[NSString alloc] initWithBytes:bytes + start length:lineEnd - start encoding:NSUTF8StringEncoding];
+
+        [replies appendData:(NSData * _Nonnull)[[self replyForCommand:command ?: @""] dataUsingEncoding:NSUTF8StringEncoding]];
+
+        _commandCount++;
+        [_commands addObject:command ?: @""];
+        [commands addObject:command ?: @""];
+        pos = next;
+    }
+
+    [buffer replaceBytesInRange:NSMakeRange(0, pos) withBytes:NULL length:0];
+
+    return replies;
+}
+
+/**
+ Needs to be called on `_queue`.
+ */
+- (NSString *)replyForCommand:(NSString *)command
+{
+    NSString *reply = _replies[command];
+
+    if (reply)
+    {
+        return reply;
+    }
+
+    NSArray<NSString *> *arguments = [command componentsSeparatedByString:@" "];
+
+    if (![arguments.firstObject.uppercaseString isEqualToString:@"GETINFO"] || arguments.count < 2)
+    {
+        return @"250 OK\r\n";
+    }
+
+    NSMutableString *info = [NSMutableString new];
+
+    for (NSString *key in [arguments subarrayWithRange:NSMakeRange(1, arguments.count - 1)])
+    {
+        NSString *value = _info[key];
+
+        if (!value)
+        {
+            return [NSString stringWithFormat:@"552 Unrecognized key \"%@\"\r\n", key];
+        }
+
+        [info appendString:[self.class infoReplyLineForKey:key value:value]];
+    }
+
+    [info appendString:@"250 OK\r\n"];
+
+    return info;
+}
+
+- (void)write:(NSData *)data to:(dispatch_io_t)channel
+{
+    dispatch_data_t dispatchData = dispatch_data_create(data.bytes, data.length, _queue, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+
+    dispatch_io_write(channel, 0, dispatchData, _queue, ^(bool __unused done, dispatch_data_t _Nullable __unused data, int __unused error) {
+    });
+}
+
++ (NSData *)identityOfRelay:(NSUInteger)index
+{
+    uint8_t identity[20];
+
+    identity[0] = (uint8_t)(index >> 24);
+    identity[1] = (uint8_t)(index >> 16);
+    identity[2] = (uint8_t)(index >> 8);
+    identity[3] = (uint8_t)index;
+
+    for (NSUInteger i = 4; i < sizeof(identity); i++)
+    {
+        identity[i] = (uint8_t)(index * 131 + i * 17);
+    }
+
+    return [NSData dataWithBytes:identity length:sizeof(identity)];
+}
+
++ (NSString *)pathOfCircuit:(NSUInteger)index relays:(NSUInteger)relays
+{
+    NSMutableArray<NSString *> *hops = [NSMutableArray new];
+
+    for (NSUInteger hop = 0; hop < 3; hop++)
+    {
+        NSUInteger relay = relays > 0 ? (index * 3 + hop) % relays : hop;
+        NSData *identity = [self identityOfRelay:relay];
+        const uint8_t *bytes = identity.bytes;
+
+        NSMutableString *fingerprint = [NSMutableString stringWithString:@"$"];
+
+        for (NSUInteger i = 0; i < identity.length; i++)
+        {
+            [fingerprint appendFormat:@"%02X", bytes[i]];
+        }
+
+        [hops addObject:[NSString stringWithFormat:@"%@~Relay%lu", fingerprint, (unsigned long)relay]];
+    }
+
+    return [hops componentsJoinedByString:@","];
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
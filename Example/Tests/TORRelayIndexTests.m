@@ -0,0 +1,119 @@
+//
+//  TORRelayIndexTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+@interface TORRelayIndexTests : XCTestCase
+
+@end
+
+@implementation TORRelayIndexTests
+
+static NSString *ns = @"ns/all=\r\n"
+"r ForPrivacyNET ADb6NqtDX9XQ9kBiZjaGfr+3LGg epP7Gxm+NYhwC3V7SPORQCPoVgc 2022-11-18 00:01:48 185.220.101.33 10133 0\r\n"
+"a [2a0b:f4c2:2::33]:10133\r\n"
+"s Exit Fast Running V2Dir Valid\r\n"
+"w Bandwidth=37000\r\n"
+"r Unnamed AAECAwQFBgcICQoLDA0ODxAREhM epP7Gxm+NYhwC3V7SPORQCPoVgc 2022-11-18 00:01:48 10.0.0.1 9001 0\r\n"
+"s Fast Guard Running Stable Valid\r\n"
+"r Unnamed FBUWFxgZGhscHR4fICEiIyQlJic epP7Gxm+NYhwC3V7SPORQCPoVgc 2022-11-18 00:01:48 10.0.0.2 9001 0\r\n"
+"s BadExit Exit Running\r\n";
+
+- (void)testParse {
+    TORRelayIndex *index = [[TORRelayIndex alloc] initWithNsString:ns];
+
+    XCTAssertEqual(index.count, 3);
+
+    TORNode *node = [index nodeForFingerprint:@"$0036FA36AB435FD5D0F640626636867EBFB72C68"];
+
+    XCTAssertEqualObjects(node.fingerprint, @"$0036FA36AB435FD5D0F640626636867EBFB72C68");
+    XCTAssertEqualObjects(node.nickName, @"ForPrivacyNET");
+    XCTAssertEqualObjects(node.ipv4Address, @"185.220.101.33");
+    XCTAssertEqualObjects(node.ipv6Address, @"2a0b:f4c2:2::33");
+    XCTAssertTrue(node.isExit);
+
+    XCTAssertEqual([index flagsForFingerprint:@"000102030405060708090a0b0c0d0e0f10111213"],
+                   TORRelayFlagFast | TORRelayFlagGuard | TORRelayFlagRunning | TORRelayFlagStable | TORRelayFlagValid);
+
+    XCTAssertFalse([index containsFingerprint:@"$FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"]);
+    XCTAssertFalse([index containsFingerprint:@"invalid"]);
+}
+
+- (void)testFillNode {
+    TORRelayIndex *index = [[TORRelayIndex alloc] initWithNsString:ns];
+
+    TORNode *node = [[TORNode alloc] initFromString:@"$000102030405060708090A0B0C0D0E0F10111213~Unnamed"];
+
+    XCTAssertTrue([index fillNode:node]);
+    XCTAssertEqualObjects(node.ipv4Address, @"10.0.0.1");
+    XCTAssertNil(node.ipv6Address);
+    XCTAssertFalse(node.isExit);
+}
+
+- (void)testNodesWithFlags {
+    TORRelayIndex *index = [[TORRelayIndex alloc] initWithNsString:ns];
+
+    XCTAssertEqual([index nodesWithFlags:0].count, 3);
+    XCTAssertEqual([index nodesWithFlags:TORRelayFlagExit].count, 2);
+    XCTAssertEqual([index nodesWithFlags:TORRelayFlagExit | TORRelayFlagBadExit].count, 1);
+
+    NSArray<TORNode *> *exits = [TORNode parseFromNsString:ns exitOnly:YES];
+
+    XCTAssertEqual(exits.count, 2);
+    XCTAssertEqualObjects(exits.firstObject.nickName, @"ForPrivacyNET");
+}
+
+- (void)testEveryChunkSize {
+    NSData *data = [ns dataUsingEncoding:NSUTF8StringEncoding];
+
+    for (NSUInteger chunkSize = 1; chunkSize < 64; chunkSize++)
+    {
+        TORRelayIndex *index = [TORRelayIndex new];
+
+        for (NSUInteger offset = 0; offset < data.length; offset += chunkSize)
+        {
+            [index parseBytes:(const uint8_t *)data.bytes + offset length:MIN(chunkSize, data.length - offset)];
+        }
+
+        [index finish];
+
+        XCTAssertEqual(index.count, 3, @"chunkSize=%lu", (unsigned long)chunkSize);
+        XCTAssertEqualObjects([index nodeForFingerprint:@"$0036FA36AB435FD5D0F640626636867EBFB72C68"].ipv6Address,
+                              @"2a0b:f4c2:2::33", @"chunkSize=%lu", (unsigned long)chunkSize);
+    }
+}
+
+/**
+ Builds an index of a network status with the size of a full consensus.
+ */
+- (void)testPerformance {
+    NSMutableString *consensus = [NSMutableString new];
+
+    for (uint32_t i = 0; i < 7000; i++)
+    {
+        uint8_t digest[20] = {0};
+        memcpy(digest, &i, sizeof(i));
+        digest[19] = 0xAA;
+
+        NSString *identity = [[[NSData dataWithBytes:digest length:sizeof(digest)] base64EncodedStringWithOptions:0]
+                              stringByTrimmingCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@"="]];
+
+        [consensus appendFormat:@"r Relay%u %@ epP7Gxm+NYhwC3V7SPORQCPoVgc 2022-11-18 00:01:48 10.%u.%u.%u 9001 0\n"
+         "a [2001:db8::%x]:9001\ns Fast Running Stable Valid%@\nw Bandwidth=%u\n",
+         i % 500, identity, i >> 16 & 255, i >> 8 & 255, i & 255, i, i % 5 ? @"" : @" Exit", i];
+    }
+
+    [self measureBlock:^{
+        TORRelayIndex *index = [[TORRelayIndex alloc] initWithNsString:consensus];
+
+        XCTAssertEqual(index.count, 7000);
+        XCTAssertEqual([index nodesWithFlags:TORRelayFlagExit].count, 1400);
+    }];
+}
+
+@end
@@ -0,0 +1,94 @@
+//
+//  TORThreadBenchmarks.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+#import "TORBenchmarkSupport.h"
+
+/**
+ Starts and stops Tor in-process over and over again.
+
+ Only one Tor can run per process, so this is skipped, when another test already started one.
+ Run it alone.
+ */
+@interface TORThreadBenchmarks : XCTestCase
+
+@end
+
+@implementation TORThreadBenchmarks
+
+/**
+ Logs the time from (re-)start to the first reply on the control socket and from stop to join,
+ and how much the memory footprint grows per cycle after the first, which hints at leaks.
+ */
+- (void)testStartStop
+{
+    XCTSkipIf(TORThread.activeThread != nil, @"Another Tor is running in this process.");
+
+    const NSUInteger cycles = 100;
+    uint64_t latencies[cycles];
+    uint64_t footprint = 0;
+
+    TORConfiguration *configuration = [TORConfiguration new];
+    configuration.ignoreMissingTorrc = YES;
+    configuration.clientOnly = YES;
+    configuration.dataDirectory = [NSURL fileURLWithPath:NSTemporaryDirectory()];
+    configuration.options[@"DisableNetwork"] = @"1";
+
+    TORThread *thread = [[TORThread alloc] initWithConfiguration:configuration];
+
+    for (NSUInteger i = 0; i < cycles; i++)
+    {
+        uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+        if (i > 0)
+        {
+            thread = [thread restartWithArguments:nil timeout:10];
+            XCTAssertNotNil(thread, @"cycle=%lu", (unsigned long)i);
+        }
+        else {
+            [thread start];
+        }
+
+        XCTestExpectation *expectation = [self expectationWithDescription:@"Tor up"];
+
+        TORController *controller = [[TORController alloc] initWithControlSocket:[thread takeControlSocket]];
+
+        [controller getInfoForKeys:@[@"version"] completion:^(NSArray<NSString *> *values) {
+            XCTAssertEqual(values.count, 1);
+
+            [expectation fulfill];
+        }];
+
+        [self waitForExpectations:@[expectation] timeout:10];
+
+        latencies[i] = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+
+        if (i == 0)
+        {
+            footprint = TORBenchmarkSupport.footprint;
+        }
+    }
+
+    uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+    [thread stop];
+    XCTAssertTrue([thread joinWithTimeout:10]);
+
+    uint64_t stopLatency = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+
+    int64_t growth = (int64_t)TORBenchmarkSupport.footprint - (int64_t)footprint;
+
+    NSLog(@"[TORThread] %lu cycles, restart to first reply: %@, stop to join: %.1f ms, footprint growth: %.1f KB/cycle",
+          (unsigned long)cycles, [TORBenchmarkSupport percentiles:latencies count:cycles],
+          (double)stopLatency / NSEC_PER_MSEC, (double)growth / 1024 / (cycles - 1));
+
+    XCTAssertNil(TORThread.activeThread);
+}
+
+@end
@@ -0,0 +1,225 @@
+//
+//  OnionmasqBenchmarks.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <stdatomic.h>
+#import <time.h>
+
+#import <Tor/Tor.h>
+#import "OnionmasqPcapReplay.h"
+#import "TORBenchmarkSupport.h"
+
+/**
+ Onionmasq's C writer callback, as called by the Rust side for every outgoing packet.
+ */
+extern bool writerCb(const uint8_t *packet, size_t len);
+
+
+/**
+ Drives the Onionmasq packet bridge with replayed traffic through an in-memory stand-in for the TUN interface.
+
+ Needs neither network access nor a VPN entitlement: Packets are handed to Onionmasq directly, and the
+ writer side is driven through the same C callback, which Onionmasq calls for outgoing packets.
+
+ Set the environment variable @c ONIONMASQ_BENCHMARK_PCAP to a PCAP file, e.g. one recorded with
+ `+[Onionmasq setPcapPath:]`, to replay real traffic. Otherwise synthetic traffic is used.
+
+ Results are logged per run as packets/s, bytes/s, nanoseconds and allocations per packet.
+ */
+@interface OnionmasqBenchmarks : XCTestCase
+
+@property (nonatomic) OnionmasqPcapReplay *replay;
+
+@end
+
+@implementation OnionmasqBenchmarks
+
+static const NSUInteger burstSize = 64;
+
+static _Atomic uint64_t writtenPackets;
+
+static dispatch_semaphore_t readerCalled;
+
++ (void)setUp
+{
+    [super setUp];
+
+    TORBenchmarkInstallMallocLogger(NULL);
+}
+
++ (void)tearDown
+{
+    TORBenchmarkRemoveMallocLogger();
+
+    [super tearDown];
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSString *path = NSProcessInfo.processInfo.environment[@"ONIONMASQ_BENCHMARK_PCAP"];
+    NSError *error;
+
+    if (path.length > 0)
+    {
+        self.replay = [[OnionmasqPcapReplay alloc] initWithURL:[NSURL fileURLWithPath:path] error:&error];
+
+        XCTAssertNotNil(self.replay, @"%@", error);
+    }
+    else {
+        // Round-trip through a file, so the PCAP reader is exercised, too.
+        NSURL *url = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:@"onionmasq-benchmark.pcap"];
+
+        XCTAssertTrue([[[OnionmasqPcapReplay alloc] initWithSyntheticPackets:20000] writeToURL:url]);
+
+        self.replay = [[OnionmasqPcapReplay alloc] initWithURL:url error:&error];
+
+        XCTAssertEqual(self.replay.count, 20000, @"%@", error);
+    }
+
+    atomic_store(&writtenPackets, 0);
+    readerCalled = dispatch_semaphore_create(0);
+}
+
+- (void)tearDown
+{
+    [Onionmasq stop];
+
+    [super tearDown];
+}
+
+
+// MARK: Benchmarks
+
+- (void)testReceive
+{
+    [self startWithBatchWriter:NO];
+
+    OnionmasqPcapReplay *replay = self.replay;
+
+    [self measurePackets:replay.count bytes:replay.totalBytes name:@"receive:" block:^{
+        for (NSUInteger i = 0; i < replay.count; i += burstSize)
+        {
+            @autoreleasepool {
+                [Onionmasq receive:[replay packetsInRange:NSMakeRange(i, MIN(burstSize, replay.count - i))]];
+            }
+        }
+    }];
+}
+
+- (void)testReceiveArena
+{
+    [self startWithBatchWriter:NO];
+
+    OnionmasqPcapReplay *replay = self.replay;
+
+    [self measurePackets:replay.count bytes:replay.totalBytes name:@"receiveArena:lengths:count:" block:^{
+        for (NSUInteger i = 0; i < replay.count; i += burstSize)
+        {
+            [Onionmasq receiveArena:replay.pointers[i]
+                            lengths:replay.lengths + i
+                              count:MIN(burstSize, replay.count - i)];
+        }
+    }];
+}
+
+- (void)testWriter
+{
+    [self startWithBatchWriter:NO];
+
+    [self measureWriter:@"writerCb -> WriterCb"];
+}
+
+- (void)testBatchWriter
+{
+    [self startWithBatchWriter:YES];
+
+    [self measureWriter:@"writerCb -> BatchWriterCb"];
+}
+
+
+// MARK: Helper Methods
+
+/**
+ Starts Onionmasq with the fake TUN interface and waits, until it wants to read.
+ */
+- (void)startWithBatchWriter:(BOOL)batched
+{
+    ReaderCb reader = ^{
+        dispatch_semaphore_signal(readerCalled);
+    };
+
+    NSURL *stateDir = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:@"onionmasq-benchmark-state"];
+    NSURL *cacheDir = [[NSURL fileURLWithPath:NSTemporaryDirectory()] URLByAppendingPathComponent:@"onionmasq-benchmark-cache"];
+
+    // The fake TUN's write side only counts. Packets are gone after it returns, like on a real interface.
+    NSThread *thread = [[NSThread alloc] initWithBlock:^{
+        if (batched)
+        {
+            [Onionmasq startWithReader:reader batchWriter:^(const OnionmasqPacket *packets, NSUInteger count) {
+                atomic_fetch_add(&writtenPackets, count);
+            } stateDir:stateDir cacheDir:cacheDir pcapFile:nil onEvent:nil onLog:nil];
+        }
+        else {
+            [Onionmasq startWithReader:reader writer:^bool(NSData *packet, NSNumber *version) {
+                atomic_fetch_add(&writtenPackets, 1);
+
+                return true;
+            } stateDir:stateDir cacheDir:cacheDir pcapFile:nil onEvent:nil onLog:nil];
+        }
+    }];
+
+    thread.name = @"Onionmasq";
+    [thread start];
+
+    if (dispatch_semaphore_wait(readerCalled, dispatch_time(DISPATCH_TIME_NOW, 10 * NSEC_PER_SEC)) != 0)
+    {
+        XCTFail(@"Onionmasq didn't start reading.");
+    }
+}
+
+- (void)measureWriter:(NSString *)name
+{
+    OnionmasqPcapReplay *replay = self.replay;
+
+    [self measurePackets:replay.count bytes:replay.totalBytes name:name block:^{
+        uint64_t target = atomic_load(&writtenPackets) + replay.count;
+
+        for (NSUInteger i = 0; i < replay.count; i++)
+        {
+            writerCb(replay.pointers[i], replay.lengths[i]);
+        }
+
+        // Batches are delivered asynchronously. Only done, when all arrived.
+        while (atomic_load(&writtenPackets) < target)
+        {
+            sched_yield();
+        }
+    }];
+}
+
+- (void)measurePackets:(NSUInteger)packets bytes:(NSUInteger)bytes name:(NSString *)name block:(void (^)(void))block
+{
+    [self measureBlock:^{
+        atomic_store(&TORBenchmarkAllocations, 0);
+        TORBenchmarkCountAllocations = true;
+        uint64_t start = clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+
+        block();
+
+        uint64_t nanos = clock_gettime_nsec_np(CLOCK_UPTIME_RAW) - start;
+        TORBenchmarkCountAllocations = false;
+
+        double seconds = (double)nanos / NSEC_PER_SEC;
+
+        NSLog(@"[%@] %.0f packets/s, %.1f MB/s, %.0f ns/packet, %.2f allocations/packet",
+              name, packets / seconds, bytes / seconds / 1000000, (double)nanos / packets, (double)atomic_load(&TORBenchmarkAllocations) / packets);
+    }];
+}
+
+@end
@@ -0,0 +1,76 @@
+//
+//  OnionmasqPcapReplay.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ IP packets loaded into one contiguous arena, ready to be replayed into a (fake) TUN interface.
+
+ Reads PCAP files as written by `+[Onionmasq setPcapPath:]`, `tcpdump` or Wireshark. Supported link types are
+ RAW (IPv4/IPv6 without link layer), NULL/loopback and Ethernet. Non-IP frames are skipped.
+ */
+@interface OnionmasqPcapReplay : NSObject
+
+/**
+ Number of packets.
+ */
+@property (readonly) NSUInteger count;
+
+/**
+ Sum of the lengths of all packets.
+ */
+@property (readonly) NSUInteger totalBytes;
+
+/**
+ All packets, back to back.
+ */
+@property (readonly) const uint8_t *arena;
+
+/**
+ The length of each packet.
+ */
+@property (readonly) const size_t *lengths;
+
+/**
+ The start of each packet in the arena.
+ */
+@property (readonly) const uint8_t * _Nonnull const * _Nonnull pointers;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ @param url A PCAP file.
+ @param error Set, if the file couldn't be read or isn't a supported PCAP file.
+ */
+- (nullable instancetype)initWithURL:(NSURL *)url error:(NSError **)error;
+
+/**
+ Generates a mix of IPv4/UDP and IPv6/TCP packets of typical sizes, for when no recording is available.
+
+ @param count Number of packets to generate.
+ */
+- (instancetype)initWithSyntheticPackets:(NSUInteger)count;
+
+/**
+ Writes the packets as a PCAP file with link type RAW.
+
+ @param url The file to write to.
+ @return NO, if the file couldn't be written.
+ */
+- (BOOL)writeToURL:(NSURL *)url;
+
+/**
+ @param range A range of packet indexes.
+ @return The packets in the given range, wrapping the arena without copying.
+ */
+- (NSArray<NSData *> *)packetsInRange:(NSRange)range;
+
+@end
+
+NS_ASSUME_NONNULL_END
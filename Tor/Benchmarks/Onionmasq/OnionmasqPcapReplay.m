@@ -0,0 +1,346 @@
+//
+//  OnionmasqPcapReplay.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "OnionmasqPcapReplay.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// See https://www.tcpdump.org/manpages/pcap-savefile.5.txt
+#define PCAP_MAGIC 0xa1b2c3d4
+#define PCAP_MAGIC_NS 0xa1b23c4d
+
+// See https://www.tcpdump.org/linktypes.html
+#define LINKTYPE_NULL 0
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW_BSD 12
+#define LINKTYPE_RAW 101
+#define LINKTYPE_IPV4 228
+#define LINKTYPE_IPV6 229
+
+
+// MARK: Helpers
+
+static uint32_t OnionmasqRead32(const uint8_t *p, BOOL swap)
+{
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+
+    return swap ? OSSwapInt32(value) : value;
+}
+
+/**
+ Finds the IP packet in a captured frame.
+
+ @return The offset of the IP header in the frame or -1, if the frame doesn't contain an IP packet.
+ */
+static ssize_t OnionmasqIpOffset(uint32_t linkType, const uint8_t *frame, size_t length)
+{
+    ssize_t offset;
+
+    switch (linkType)
+    {
+        case LINKTYPE_RAW:
+        case LINKTYPE_RAW_BSD:
+        case LINKTYPE_IPV4:
+        case LINKTYPE_IPV6:
+            offset = 0;
+            break;
+
+        case LINKTYPE_NULL:
+            // 4 bytes address family in the byte order of the capturing host.
+            offset = 4;
+            break;
+
+        case LINKTYPE_ETHERNET: {
+            if (length < 14)
+            {
+                return -1;
+            }
+
+            size_t typeOffset = 12;
+            uint16_t type = (uint16_t)(frame[typeOffset] << 8 | frame[typeOffset + 1]);
+
+            // Skip 802.1Q VLAN tags.
+            while ((type == 0x8100 || type == 0x88a8) && length >= typeOffset + 6)
+            {
+                typeOffset += 4;
+                type = (uint16_t)(frame[typeOffset] << 8 | frame[typeOffset + 1]);
+            }
+
+            if (type != 0x0800 && type != 0x86dd)
+            {
+                return -1;
+            }
+
+            offset = (ssize_t)typeOffset + 2;
+            break;
+        }
+
+        default:
+            return -1;
+    }
+
+    if ((size_t)offset >= length)
+    {
+        return -1;
+    }
+
+    uint8_t version = frame[offset] >> 4;
+
+    return version == 4 || version == 6 ? offset : -1;
+}
+
+static uint16_t OnionmasqIpv4Checksum(const uint8_t *header)
+{
+    uint32_t sum = 0;
+
+    for (int i = 0; i < 20; i += 2)
+    {
+        sum += (uint32_t)(header[i] << 8 | header[i + 1]);
+    }
+
+    while (sum >> 16)
+    {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+
+    return (uint16_t)~sum;
+}
+
+
+@implementation OnionmasqPcapReplay {
+    NSMutableData *_arena;
+    NSMutableData *_lengths;
+    NSMutableData *_pointers;
+}
+
+- (nullable instancetype)initWithURL:(NSURL *)url error:(NSError **)error
+{
+    self = [self initEmpty];
+
+    if (self)
+    {
+        NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:error];
+
+        if (!data)
+        {
+            return nil;
+        }
+
+        const uint8_t *p = data.bytes;
+        const uint8_t *end = p + data.length;
+
+        uint32_t magic = data.length >= 24 ? OnionmasqRead32(p, NO) : 0;
+        BOOL swap = magic == OSSwapInt32(PCAP_MAGIC) || magic == OSSwapInt32(PCAP_MAGIC_NS);
+
+        if (!swap && magic != PCAP_MAGIC && magic != PCAP_MAGIC_NS)
+        {
+            if (error)
+            {
+                *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError
+                                         userInfo:@{NSURLErrorKey: url,
+                                                    NSLocalizedDescriptionKey: @"Not a PCAP file."}];
+            }
+
+            return nil;
+        }
+
+        uint32_t linkType = OnionmasqRead32(p + 20, swap) & 0xffff;
+        p += 24;
+
+        while (end - p >= 16)
+        {
+            uint32_t capturedLength = OnionmasqRead32(p + 8, swap);
+            p += 16;
+
+            if ((size_t)(end - p) < capturedLength)
+            {
+                break;
+            }
+
+            ssize_t offset = OnionmasqIpOffset(linkType, p, capturedLength);
+
+            if (offset >= 0)
+            {
+                [self appendPacket:p + offset length:capturedLength - (size_t)offset];
+            }
+
+            p += capturedLength;
+        }
+
+        [self finish];
+    }
+
+    return self;
+}
+
+- (instancetype)initWithSyntheticPackets:(NSUInteger)count
+{
+    self = [self initEmpty];
+
+    if (self)
+    {
+        // Typical mix on a TUN interface: Mostly full-size and ACK-only packets, some in-between.
+        static const size_t sizes[] = {1280, 1280, 52, 1280, 40, 576, 1280, 52};
+
+        uint8_t packet[1280];
+
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            size_t length = sizes[i % (sizeof(sizes) / sizeof(sizes[0]))];
+
+            memset(packet, (int)(i & 0xff), length);
+
+            if (i % 4 == 3)
+            {
+                // IPv6, next header TCP, fd00::1 -> fd00::2
+                memset(packet, 0, 40);
+                packet[0] = 0x60;
+                packet[4] = (uint8_t)((length - 40) >> 8);
+                packet[5] = (uint8_t)(length - 40);
+                packet[6] = 6;
+                packet[7] = 64;
+                packet[8] = 0xfd;
+                packet[23] = 1;
+                packet[24] = 0xfd;
+                packet[39] = 2;
+            }
+            else {
+                // IPv4, protocol UDP, 10.0.0.1 -> 10.0.0.2, no UDP checksum.
+                memset(packet, 0, 28);
+                packet[0] = 0x45;
+                packet[2] = (uint8_t)(length >> 8);
+                packet[3] = (uint8_t)length;
+                packet[8] = 64;
+                packet[9] = 17;
+                packet[12] = 10;
+                packet[15] = 1;
+                packet[16] = 10;
+                packet[19] = 2;
+
+                uint16_t checksum = OnionmasqIpv4Checksum(packet);
+                packet[10] = (uint8_t)(checksum >> 8);
+                packet[11] = (uint8_t)checksum;
+
+                uint16_t port = (uint16_t)(49152 + i % 1024);
+                packet[20] = (uint8_t)(port >> 8);
+                packet[21] = (uint8_t)port;
+                packet[22] = 0;
+                packet[23] = 53;
+                packet[24] = (uint8_t)((length - 20) >> 8);
+                packet[25] = (uint8_t)(length - 20);
+            }
+
+            [self appendPacket:packet length:length];
+        }
+
+        [self finish];
+    }
+
+    return self;
+}
+
+- (instancetype)initEmpty
+{
+    self = [super init];
+
+    if (self)
+    {
+        _arena = [NSMutableData new];
+        _lengths = [NSMutableData new];
+        _pointers = [NSMutableData new];
+    }
+
+    return self;
+}
+
+
+// MARK: Public Properties
+
+- (const uint8_t *)arena
+{
+    return _arena.bytes;
+}
+
+- (const size_t *)lengths
+{
+    return _lengths.bytes;
+}
+
+- (const uint8_t * _Nonnull const *)pointers
+{
+    return _pointers.bytes;
+}
+
+
+// MARK: Public Methods
+
+- (BOOL)writeToURL:(NSURL *)url
+{
+    NSMutableData *data = [NSMutableData new];
+
+    uint32_t header[6] = {PCAP_MAGIC, 2 | 4 << 16, 0, 0, 65535, LINKTYPE_RAW};
+    [data appendBytes:header length:sizeof(header)];
+
+    for (NSUInteger i = 0; i < _count; i++)
+    {
+        uint32_t length = (uint32_t)self.lengths[i];
+        uint32_t record[4] = {(uint32_t)(i / 1000), (uint32_t)(i % 1000 * 1000), length, length};
+
+        [data appendBytes:record length:sizeof(record)];
+        [data appendBytes:self.pointers[i] length:length];
+    }
+
+    return [data writeToURL:url atomically:YES];
+}
+
+- (NSArray<NSData *> *)packetsInRange:(NSRange)range
+{
+    NSMutableArray<NSData *> *packets = [[NSMutableArray alloc] initWithCapacity:range.length];
+
+    for (NSUInteger i = range.location; i < NSMaxRange(range) && i < _count; i++)
+    {
+        [packets addObject:[[NSData alloc] initWithBytesNoCopy:(void *)self.pointers[i]
+                                                        length:self.lengths[i]
+                                                  freeWhenDone:NO]];
+    }
+
+    return packets;
+}
+
+
+// MARK: Private Methods
+
+- (void)appendPacket:(const uint8_t *)bytes length:(size_t)length
+{
+    [_arena appendBytes:bytes length:length];
+    [_lengths appendBytes:&length length:sizeof(length)];
+
+    _count++;
+    _totalBytes += length;
+}
+
+/**
+ The arena doesn't move anymore, so the pointers can be calculated.
+ */
+- (void)finish
+{
+    _pointers.length = _count * sizeof(const uint8_t *);
+
+    const uint8_t **pointers = _pointers.mutableBytes;
+    const uint8_t *p = _arena.bytes;
+
+    for (NSUInteger i = 0; i < _count; i++)
+    {
+        pointers[i] = p;
+        p += self.lengths[i];
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -7,12 +7,11 @@
 
 #import "TORArti.h"
 #import "arti-mobile.h"
+#import "TORLogFileWriter.h"
 
 @implementation TORArti
 
-NSString *logfilePath;
-
-NSRegularExpression *regex;
+TORLogFileWriter *logWriter;
 
 typedef void (^Completed)(void);
 
@@ -28,14 +27,12 @@ Completed completedBlock;
                     bridge:(NSString * _Nullable)bridge
                  completed:(nullable void (^)(void))completed
 {
-    logfilePath = logfile.path;
     completedBlock = completed;
 
-    NSFileManager *fm = NSFileManager.defaultManager;
+    [logWriter close];
+    logWriter = logfile ? [[TORLogFileWriter alloc] initWithURL:logfile maxFileSize:10 * 1024 * 1024 maxFiles:2] : nil;
 
-    if (![fm fileExistsAtPath:logfilePath]) {
-        [fm createFileAtPath:logfilePath contents:nil attributes:nil];
-    }
+    NSFileManager *fm = NSFileManager.defaultManager;
 
     if (!stateDir) {
         stateDir = [[[fm URLsForDirectory:NSApplicationSupportDirectory inDomains:NSUserDomainMask]
@@ -49,9 +46,6 @@ Completed completedBlock;
                     URLByAppendingPathComponent:@"org.torproject.Arti"];
     }
 
-    // Remove ANSI colors.
-    regex = [[NSRegularExpression alloc] initWithPattern:@"\\x1b\\[[0-9;]*m" options:NSRegularExpressionDotMatchesLineSeparators error:nil];
-
     start_arti([stateDir.path cStringUsingEncoding:NSUTF8StringEncoding],
                [cacheDir.path cStringUsingEncoding:NSUTF8StringEncoding],
                [obfs4proxyPath.path cStringUsingEncoding:NSUTF8StringEncoding],
@@ -88,21 +82,13 @@ Completed completedBlock;
 
 void loggingCb(const char * message)
 {
-    NSMutableString *msg = [[NSMutableString alloc] initWithUTF8String:message];
-
-    if (completedBlock && [msg containsString:@"Directory is complete"]) {
+    if (completedBlock && strstr(message, "Directory is complete")) {
         completedBlock();
         completedBlock = nil;
     }
 
-    if (logfilePath.length < 1) return;
-
-    [regex replaceMatchesInString:msg options:0 range:NSMakeRange(0, msg.length) withTemplate:@""];
-
-    NSFileHandle *fh = [NSFileHandle fileHandleForUpdatingAtPath: logfilePath];
-    [fh seekToEndOfFile];
-    [fh writeData:[msg dataUsingEncoding:NSUTF8StringEncoding]];
-    [fh closeFile];
+    // Buffered, ANSI colors are removed while copying.
+    [logWriter writeCString:message];
 }
 
 
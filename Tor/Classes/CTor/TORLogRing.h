@@ -0,0 +1,61 @@
+//
+//  TORLogRing.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+
+#import "TORLogging.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Number of entries a @c TORLogRing holds.
+ */
+#define TOR_LOG_RING_CAPACITY 1024
+
+/**
+ A fixed-size lock-free ring buffer of log entries for exactly one producer and one consumer.
+
+ This is what @c TORInstallTorLoggingBuffered uses internally. Zero-initialized memory is an empty ring.
+ */
+typedef struct {
+    TORLogEntry entries[TOR_LOG_RING_CAPACITY];
+
+    // Both only ever grow. Their difference is the number of used entries.
+    _Atomic size_t head;
+    _Atomic size_t tail;
+
+    _Atomic uint64_t dropped;
+} TORLogRing;
+
+/**
+ Called with contiguous runs of entries.
+
+ @param entries The entries. Only valid during the call.
+ @param count The number of entries.
+ @param dropped The total number of entries dropped so far, because the ring was full.
+ */
+typedef void (^TORLogRingConsumer)(const TORLogEntry *entries, size_t count, uint64_t dropped);
+
+/**
+ Copy a message into the ring. Drops and counts it, if the ring is full.
+
+ Only to be called by the producer.
+
+ @return YES, if this message made the ring half full, so the consumer should drain it before it usually would.
+ */
+extern BOOL TORLogRingPush(TORLogRing *ring, os_log_type_t type, uint64_t domain, const char *msg);
+
+/**
+ Hand all entries in the ring to the consumer in place, in at most two contiguous runs around the wrap,
+ and free their slots.
+
+ Only to be called by the consumer.
+ */
+extern void TORLogRingDrain(TORLogRing *ring, NS_NOESCAPE TORLogRingConsumer consumer);
+
+NS_ASSUME_NONNULL_END
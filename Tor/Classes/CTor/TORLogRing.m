@@ -0,0 +1,52 @@
+//
+//  TORLogRing.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORLogRing.h"
+
+#import <time.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+BOOL TORLogRingPush(TORLogRing *ring, os_log_type_t type, uint64_t domain, const char *msg) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t used = head - tail;
+
+    if (used >= TOR_LOG_RING_CAPACITY) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return NO;
+    }
+
+    TORLogEntry *entry = &ring->entries[head % TOR_LOG_RING_CAPACITY];
+    entry->type = type;
+    entry->domain = domain;
+    clock_gettime(CLOCK_REALTIME, &entry->timestamp);
+    strlcpy(entry->message, msg, sizeof(entry->message));
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return used + 1 == TOR_LOG_RING_CAPACITY / 2;
+}
+
+void TORLogRingDrain(TORLogRing *ring, NS_NOESCAPE TORLogRingConsumer consumer) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    while (tail != head) {
+        size_t start = tail % TOR_LOG_RING_CAPACITY;
+        size_t count = MIN(head - tail, TOR_LOG_RING_CAPACITY - start);
+
+        consumer(&ring->entries[start], count, atomic_load_explicit(&ring->dropped, memory_order_relaxed));
+
+        tail += count;
+
+        // Hand the slots back to the producer.
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+}
+
+NS_ASSUME_NONNULL_END
@@ -12,6 +12,102 @@ NS_ASSUME_NONNULL_BEGIN
 
 typedef void(* tor_log_cb)(os_log_type_t severity, const char* msg);
 
+/**
+ Maximum size of a message in a @c TORLogEntry including the terminating NUL. Longer messages are truncated.
+ */
+#define TOR_LOG_ENTRY_MESSAGE_SIZE 512
+
+typedef struct {
+    /**
+     The type Tor's severity maps to: @c LOG_ERR to @c OS_LOG_TYPE_FAULT, @c LOG_WARN to @c OS_LOG_TYPE_ERROR,
+     @c LOG_NOTICE and @c LOG_INFO to @c OS_LOG_TYPE_INFO, @c LOG_DEBUG to @c OS_LOG_TYPE_DEBUG.
+     */
+    os_log_type_t type;
+    uint64_t domain;
+    struct timespec timestamp;
+    char message[TOR_LOG_ENTRY_MESSAGE_SIZE];
+} TORLogEntry;
+
+/**
+ Receives log messages in batches on a background queue.
+
+ @param entries The entries. Only valid during the call.
+ @param count The number of entries.
+ @param dropped The total number of messages dropped, because the buffer was full.
+ */
+typedef void(* tor_log_batch_cb)(const TORLogEntry *entries, size_t count, uint64_t dropped);
+
+/**
+ Tor's log domains, mirroring the @c LD_* constants of Tor's log.h.
+ */
+typedef NS_OPTIONS(uint64_t, TORLogDomain) {
+    TORLogDomainGeneral   = 1ULL << 0,
+    TORLogDomainCrypto    = 1ULL << 1,
+    TORLogDomainNet       = 1ULL << 2,
+    TORLogDomainConfig    = 1ULL << 3,
+    TORLogDomainFs        = 1ULL << 4,
+    TORLogDomainProtocol  = 1ULL << 5,
+    TORLogDomainMm        = 1ULL << 6,
+    TORLogDomainHttp      = 1ULL << 7,
+    TORLogDomainApp       = 1ULL << 8,
+    TORLogDomainControl   = 1ULL << 9,
+    TORLogDomainCirc      = 1ULL << 10,
+    TORLogDomainRend      = 1ULL << 11,
+    TORLogDomainBug       = 1ULL << 12,
+    TORLogDomainDir       = 1ULL << 13,
+    TORLogDomainDirserv   = 1ULL << 14,
+    TORLogDomainOr        = 1ULL << 15,
+    TORLogDomainEdge      = 1ULL << 16,
+    TORLogDomainAcct      = 1ULL << 17,
+    TORLogDomainHist      = 1ULL << 18,
+    TORLogDomainHandshake = 1ULL << 19,
+    TORLogDomainHeartbeat = 1ULL << 20,
+    TORLogDomainChannel   = 1ULL << 21,
+    TORLogDomainSched     = 1ULL << 22,
+    TORLogDomainGuard     = 1ULL << 23,
+    TORLogDomainAll       = UINT64_MAX,
+} NS_SWIFT_NAME(TorLogDomain);
+
+/**
+ Tor's log severities, mirroring the @c LOG_* constants of Tor's log.h.
+ */
+typedef NS_ENUM(int, TORLogSeverity) {
+    TORLogSeverityNone   = 0,
+    TORLogSeverityError  = 3,
+    TORLogSeverityWarn   = 4,
+    TORLogSeverityNotice = 5,
+    TORLogSeverityInfo   = 6,
+    TORLogSeverityDebug  = 7,
+} NS_SWIFT_NAME(TorLogSeverity);
+
+/**
+ Set the most verbose severity, which is still logged for the given domains. Defaults to @c TORLogSeverityDebug for all domains.
+
+ Can be changed at any time, before or after installing Tor logging. Messages of filtered domains are dropped
+ first thing in the callback, before any dispatch. Tor itself doesn't even format messages more verbose than
+ the loosest threshold of all domains. At install time, Tor also skips formatting for all filtered domains.
+
+ @param domains The domains to set the threshold for.
+ @param severity The most verbose severity to log. @c TORLogSeverityNone to drop all messages of these domains.
+ */
+extern void TORSetLogSeverity(TORLogDomain domains, TORLogSeverity severity);
+
+/**
+ @param domain A single domain. Of several, the lowest one counts.
+ @return The most verbose severity, which is currently logged for that domain.
+ */
+extern TORLogSeverity TORGetLogSeverity(TORLogDomain domain);
+
+/**
+ A message, which is filed under several domains, is filtered by the lowest one of them. Its os_log category is
+ the one of that domain, too.
+
+ @param domains The domains of a message.
+ @param severity The severity of a message.
+ @return YES, if a message like that passes the thresholds set with @c TORSetLogSeverity.
+ */
+extern BOOL TORLogSeverityEnabled(TORLogDomain domains, TORLogSeverity severity);
+
 extern void TORInstallEventLogging(void);
 
 extern void TORInstallEventLoggingCallback(tor_log_cb cb);
@@ -20,4 +116,26 @@ extern void TORInstallTorLogging(void);
 
 extern void TORInstallTorLoggingCallback(tor_log_cb cb);
 
+/**
+ Install Tor logging, where Tor's threads only copy messages into a fixed-size lock-free ring buffer.
+
+ A background queue drains the buffer at least every 100 ms and delivers the messages in batches.
+ Slow consumers can't stall Tor this way. When the buffer is full, messages are dropped and counted instead.
+
+ @param cb Callback for the batches. If NULL, messages go to the unified logging system.
+ */
+extern void TORInstallTorLoggingBuffered(tor_log_batch_cb _Nullable cb);
+
+/**
+ Add Tor logging again, the way it was installed last, as Tor removes all its logs when it exits.
+
+ @c TORThread calls this before every run but the first. Does nothing, if Tor logging was never installed.
+ */
+extern void TORReinstallTorLogging(void);
+
+/**
+ @return The total number of messages dropped by the buffered logging, because its buffer was full.
+ */
+extern uint64_t TORLogDroppedCount(void);
+
 NS_ASSUME_NONNULL_END
@@ -6,20 +6,103 @@
 //
 
 #import "TORLogging.h"
+#import "TORLogRing.h"
 
 #import <event2/event.h>
 #import <asl.h>
+#import <stdatomic.h>
 // XXXX This is not an exposed or supported Tor API.
 // XXXX If Tor changes this header, then this code might break.
 #import <lib/log/log.h>
 
 tor_log_cb tor_log_callback;
 tor_log_cb event_log_callback;
+tor_log_batch_cb tor_log_batch_callback;
 
 NS_ASSUME_NONNULL_BEGIN
 
 static char *subsystem = "org.torproject.Tor";
 
+#define TOR_ASSERT_DOMAIN(ours, tors) _Static_assert(ours == tors, #ours " doesn't match " #tors)
+
+TOR_ASSERT_DOMAIN(TORLogDomainGeneral, LD_GENERAL);
+TOR_ASSERT_DOMAIN(TORLogDomainCrypto, LD_CRYPTO);
+TOR_ASSERT_DOMAIN(TORLogDomainNet, LD_NET);
+TOR_ASSERT_DOMAIN(TORLogDomainConfig, LD_CONFIG);
+TOR_ASSERT_DOMAIN(TORLogDomainFs, LD_FS);
+TOR_ASSERT_DOMAIN(TORLogDomainProtocol, LD_PROTOCOL);
+TOR_ASSERT_DOMAIN(TORLogDomainMm, LD_MM);
+TOR_ASSERT_DOMAIN(TORLogDomainHttp, LD_HTTP);
+TOR_ASSERT_DOMAIN(TORLogDomainApp, LD_APP);
+TOR_ASSERT_DOMAIN(TORLogDomainControl, LD_CONTROL);
+TOR_ASSERT_DOMAIN(TORLogDomainCirc, LD_CIRC);
+TOR_ASSERT_DOMAIN(TORLogDomainRend, LD_REND);
+TOR_ASSERT_DOMAIN(TORLogDomainBug, LD_BUG);
+TOR_ASSERT_DOMAIN(TORLogDomainDir, LD_DIR);
+TOR_ASSERT_DOMAIN(TORLogDomainDirserv, LD_DIRSERV);
+TOR_ASSERT_DOMAIN(TORLogDomainOr, LD_OR);
+TOR_ASSERT_DOMAIN(TORLogDomainEdge, LD_EDGE);
+TOR_ASSERT_DOMAIN(TORLogDomainAcct, LD_ACCT);
+TOR_ASSERT_DOMAIN(TORLogDomainHist, LD_HIST);
+TOR_ASSERT_DOMAIN(TORLogDomainHandshake, LD_HANDSHAKE);
+TOR_ASSERT_DOMAIN(TORLogDomainHeartbeat, LD_HEARTBEAT);
+TOR_ASSERT_DOMAIN(TORLogDomainChannel, LD_CHANNEL);
+TOR_ASSERT_DOMAIN(TORLogDomainSched, LD_SCHED);
+TOR_ASSERT_DOMAIN(TORLogDomainGuard, LD_GUARD);
+_Static_assert(TORLogSeverityError == LOG_ERR && TORLogSeverityDebug == LOG_DEBUG, "Severities don't match Tor's");
+
+#undef TOR_ASSERT_DOMAIN
+
+// Most verbose severity logged per domain index. Read on every message, so lock-free.
+static _Atomic uint8_t log_thresholds[N_LOGGING_DOMAINS] = { [0 ... N_LOGGING_DOMAINS - 1] = LOG_DEBUG };
+static _Atomic bool tor_logging_installed = false;
+
+static int TORLoosestLogThreshold(void) {
+    int loosest = 0;
+    for (int i = 0; i < N_LOGGING_DOMAINS; i++) {
+        loosest = MAX(loosest, atomic_load_explicit(&log_thresholds[i], memory_order_relaxed));
+    }
+    return loosest;
+}
+
+/**
+ Builds the list of domains Tor should hand to us per severity from the thresholds.
+ */
+static void TORLogSeverityList(log_severity_list_t *list) {
+    memset(list, 0, sizeof(*list));
+
+    for (int i = 0; i < N_LOGGING_DOMAINS; i++) {
+        int threshold = atomic_load_explicit(&log_thresholds[i], memory_order_relaxed);
+        for (int severity = LOG_ERR; severity <= threshold; severity++) {
+            list->masks[severity - LOG_ERR] |= (log_domain_mask_t)1 << i;
+        }
+    }
+}
+
+/**
+ The one domain a message is filed under: The lowest one it has. Used for filtering and for the os_log category.
+
+ @return The index of that domain, or -1, if the message has none.
+ */
+static inline int TORLogDomainIndex(uint64_t domain) {
+    uint64_t domains = domain & LD_ALL_DOMAINS;
+    if (!domains) {
+        return -1;
+    }
+
+    int index = __builtin_ctzll(domains);
+    return index < N_LOGGING_DOMAINS ? index : -1;
+}
+
+static inline bool TORLogWanted(int severity, uint64_t domain) {
+    int index = TORLogDomainIndex(domain);
+    if (index < 0) {
+        return true;
+    }
+
+    return severity <= atomic_load_explicit(&log_thresholds[index], memory_order_relaxed);
+}
+
 static inline const char *TORLegacyLevelFromOSLogType(os_log_type_t type) {
     switch (type) {
         case OS_LOG_TYPE_ERROR:
@@ -161,28 +244,14 @@ static inline os_log_type_t TORLogTypeFromSeverity(int severity) {
     }
 }
 
-static void TORLogCallback(int severity, uint64_t domain, const char *msg) {
-    if (domain & LD_NOCB) {
-        return;
-    }
-
-    os_log_type_t type = TORLogTypeFromSeverity(severity);
-
-    if (tor_log_callback) {
-        tor_log_callback(type, msg);
-    } else if (@available(iOS 10.0, macOS 10.12, *)) {
-        int index = 0;
-        while (domain >>= 1) {
-            ++index;
-        }
-        if (index >= N_LOGGING_DOMAINS) {
-            return;
-        }
+static void TORLogToSystem(os_log_type_t type, uint64_t domain, const char *msg) {
+    if (@available(iOS 10.0, macOS 10.12, *)) {
+        int index = MAX(TORLogDomainIndex(domain), 0);
 
         static os_log_t logs[N_LOGGING_DOMAINS] = { NULL };
         os_log_t log = logs[index];
         if (log == NULL) {
-            log = os_log_create(subsystem, TORCategoryForDomain(1u << index));
+            log = os_log_create(subsystem, TORCategoryForDomain(1u << index) ?: "other");
             logs[index] = log;
         }
 
@@ -192,6 +261,99 @@ static void TORLogCallback(int severity, uint64_t domain, const char *msg) {
     }
 }
 
+#pragma mark - Ring Buffer
+
+// Tor calls log callbacks while holding its log mutex, so there is only ever one
+// producer at a time. The drainer queue is the only consumer.
+
+#define TOR_LOG_DRAIN_INTERVAL (100 * NSEC_PER_MSEC)
+
+static TORLogRing log_ring;
+static _Atomic bool log_ring_enabled = false;
+
+static dispatch_source_t log_ring_signal = NULL;
+
+static void TORLogRingDeliver(void) {
+    TORLogRingDrain(&log_ring, ^(const TORLogEntry *entries, size_t count, uint64_t dropped) {
+        if (tor_log_batch_callback) {
+            tor_log_batch_callback(entries, count, dropped);
+        } else {
+            for (size_t i = 0; i < count; i++) {
+                TORLogToSystem(entries[i].type, entries[i].domain, entries[i].message);
+            }
+        }
+    });
+}
+
+static void TORLogRingStart(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        dispatch_queue_t queue = dispatch_queue_create("org.torproject.Tor.log", DISPATCH_QUEUE_SERIAL);
+
+        dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+        dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, TOR_LOG_DRAIN_INTERVAL),
+                                  TOR_LOG_DRAIN_INTERVAL, TOR_LOG_DRAIN_INTERVAL / 2);
+        dispatch_source_set_event_handler(timer, ^{
+            TORLogRingDeliver();
+        });
+
+        log_ring_signal = dispatch_source_create(DISPATCH_SOURCE_TYPE_DATA_OR, 0, 0, queue);
+        dispatch_source_set_event_handler(log_ring_signal, ^{
+            TORLogRingDeliver();
+        });
+
+        dispatch_resume(timer);
+        dispatch_resume(log_ring_signal);
+    });
+}
+
+static void TORLogCallback(int severity, uint64_t domain, const char *msg) {
+    if (domain & LD_NOCB || !TORLogWanted(severity, domain)) {
+        return;
+    }
+
+    os_log_type_t type = TORLogTypeFromSeverity(severity);
+
+    if (atomic_load_explicit(&log_ring_enabled, memory_order_relaxed)) {
+        // Don't wait for the timer, when the ring fills up.
+        if (TORLogRingPush(&log_ring, type, domain, msg)) {
+            dispatch_source_merge_data(log_ring_signal, 1);
+        }
+    } else if (tor_log_callback) {
+        tor_log_callback(type, msg);
+    } else {
+        TORLogToSystem(type, domain, msg);
+    }
+}
+
+void TORSetLogSeverity(TORLogDomain domains, TORLogSeverity severity) {
+    for (int i = 0; i < N_LOGGING_DOMAINS; i++) {
+        if (domains & (1ULL << i)) {
+            atomic_store_explicit(&log_thresholds[i], (uint8_t)severity, memory_order_relaxed);
+        }
+    }
+
+    // Let Tor skip formatting everything nobody wants. Tor can't take per-domain
+    // changes after installation, so that part is left to the callback.
+    if (atomic_load(&tor_logging_installed)) {
+        int loosest = TORLoosestLogThreshold();
+        change_callback_log_severity(MAX(loosest, LOG_ERR), LOG_ERR, TORLogCallback);
+    }
+}
+
+TORLogSeverity TORGetLogSeverity(TORLogDomain domain) {
+    int index = TORLogDomainIndex(domain);
+    if (index < 0) {
+        return TORLogSeverityNone;
+    }
+
+    return (TORLogSeverity)atomic_load_explicit(&log_thresholds[index], memory_order_relaxed);
+}
+
+BOOL TORLogSeverityEnabled(TORLogDomain domains, TORLogSeverity severity) {
+    return severity != TORLogSeverityNone && TORLogWanted(severity, domains);
+}
+
 void TORInstallEventLogging(void) {
     event_log_callback = NULL;
     event_set_log_callback(TOREventLogCallback);
@@ -206,16 +368,44 @@ void TORInstallEventLoggingCallback(tor_log_cb cb) {
 
 void TORInstallTorLogging(void) {
     tor_log_callback = NULL;
+    atomic_store(&log_ring_enabled, false);
     log_severity_list_t list;
-    set_log_severity_config(LOG_DEBUG, LOG_ERR, &list);
+    TORLogSeverityList(&list);
     add_callback_log(&list, TORLogCallback);
+    atomic_store(&tor_logging_installed, true);
 }
 
 extern void TORInstallTorLoggingCallback(tor_log_cb cb) {
     tor_log_callback = cb;
+    atomic_store(&log_ring_enabled, false);
     log_severity_list_t list;
-    set_log_severity_config(LOG_DEBUG, LOG_ERR, &list);
+    TORLogSeverityList(&list);
     add_callback_log(&list, TORLogCallback);
+    atomic_store(&tor_logging_installed, true);
+}
+
+void TORInstallTorLoggingBuffered(tor_log_batch_cb _Nullable cb) {
+    tor_log_callback = NULL;
+    tor_log_batch_callback = cb;
+    TORLogRingStart();
+    atomic_store(&log_ring_enabled, true);
+    log_severity_list_t list;
+    TORLogSeverityList(&list);
+    add_callback_log(&list, TORLogCallback);
+    atomic_store(&tor_logging_installed, true);
+}
+
+void TORReinstallTorLogging(void) {
+    if (!atomic_load(&tor_logging_installed))
+        return;
+
+    log_severity_list_t list;
+    TORLogSeverityList(&list);
+    add_callback_log(&list, TORLogCallback);
+}
+
+uint64_t TORLogDroppedCount(void) {
+    return atomic_load_explicit(&log_ring.dropped, memory_order_relaxed);
 }
 
 NS_ASSUME_NONNULL_END
@@ -20,9 +20,71 @@ NS_SWIFT_NAME(TorThread)
 + (nullable TORThread *)activeThread;
 #endif
 
+/**
+ One end of a Unix socket pair, which Tor takes as an already authenticated control connection.
+
+ The thread owns it and closes it, when Tor finishes or the thread goes away. Use @c -takeControlSocket
+ to hand it to a controller instead.
+
+ It's -1, if the socket pair couldn't be created or was taken.
+ */
+@property (nonatomic, readonly) int controlSocket;
+
+/**
+ Take over @c controlSocket, e.g. to hand it to @c -[TORController initWithControlSocket:] to send commands
+ right away, without waiting for a control port file or socket to appear. Commands sent before Tor is up
+ are answered once it is.
+
+ The caller is responsible for closing it from then on. The thread's @c controlSocket becomes -1.
+
+ @return The control socket, or -1, if it couldn't be created or was taken already.
+ */
+- (int)takeControlSocket;
+
+/**
+ Only one thread can run Tor at a time. Create the next one after the last one finished,
+ e.g. with @c -restartWithArguments:timeout:.
+ */
 - (instancetype)initWithConfiguration:(nullable TORConfiguration *)configuration;
 - (instancetype)initWithArguments:(nullable NSArray<NSString *> *)arguments NS_DESIGNATED_INITIALIZER;
 
+/**
+ Make Tor exit by closing its control connection. Returns immediately, use @c -joinWithTimeout: to wait for Tor to finish.
+
+ A controller attached to the control socket loses its connection.
+ */
+- (void)stop;
+
+/**
+ Wait for Tor to finish and free its global state.
+
+ @param timeout Seconds to wait at most. 0 to wait forever.
+ @return YES, if Tor finished or never started, NO, if the timeout was hit.
+ */
+- (BOOL)joinWithTimeout:(NSTimeInterval)timeout;
+
+/**
+ Stop Tor, wait for it to finish and start a new thread.
+
+ Tor's data and cache directories are reused as they are, so the new run starts with a warm cache.
+ Attach a new controller to the control socket of the new thread, see @c -takeControlSocket.
+
+ Tor doesn't guarantee, that all of its global state is reset between runs in the same process, see
+ Tor's bug 23847. Restart the process instead, if Tor misbehaves after a restart.
+
+ @param arguments The arguments for the new run. nil to reuse the current ones.
+ @param timeout Seconds to wait for Tor to finish at most. 0 to wait forever.
+ @return The new, started thread, or nil, if Tor didn't finish in time.
+ */
+- (nullable TORThread *)restartWithArguments:(nullable NSArray<NSString *> *)arguments timeout:(NSTimeInterval)timeout;
+
+/**
+ See @c -restartWithArguments:timeout:.
+
+ @param configuration The configuration for the new run. nil to reuse the current arguments.
+ */
+- (nullable TORThread *)restartWithConfiguration:(nullable TORConfiguration *)configuration timeout:(NSTimeInterval)timeout;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -6,6 +6,7 @@
 //
 
 #import <feature/api/tor_api.h>
+#import <sys/socket.h>
 
 #import "TORThread.h"
 #import "TORLogging.h"
@@ -15,16 +16,28 @@ NS_ASSUME_NONNULL_BEGIN
 
 static __weak TORThread *_thread = nil;
 
+// Number of times Tor ran to its end in this process.
+static NSUInteger _runs = 0;
+
 @interface TORThread ()
 
 @property (nonatomic, readonly, copy, nullable) NSArray<NSString *> *arguments;
 
 @end
 
-@implementation TORThread
+@implementation TORThread {
+    tor_main_configuration_t *_cfg;
+
+    // Our own duplicate of the control socket, so Tor can be stopped, whatever happens to `controlSocket`.
+    int _ownerSocket;
+
+    dispatch_group_t _running;
+}
 
 + (nullable TORThread *)activeThread {
-    return _thread;
+    @synchronized (TORThread.class) {
+        return _thread;
+    }
 }
 
 - (instancetype)init {
@@ -36,19 +49,43 @@ static __weak TORThread *_thread = nil;
 }
 
 - (instancetype)initWithArguments:(nullable NSArray<NSString *> *)arguments {
-    NSAssert(_thread == nil, @"There can only be one TORThread per process");
     self = [super init];
     if (!self)
         return nil;
-    
-    _thread = self;
+
+    @synchronized (TORThread.class) {
+        NSAssert(_thread == nil, @"There can only be one running TORThread per process");
+        _thread = self;
+    }
+
     _arguments = [arguments copy];
+    _running = dispatch_group_create();
+
+    // Needs to be set up before Tor runs, so a controller can attach before the thread starts.
+    _cfg = tor_main_configuration_new();
+    _controlSocket = (int)tor_main_configuration_setup_control_socket(_cfg);
+    _ownerSocket = _controlSocket >= 0 ? dup(_controlSocket) : -1;
     
     self.name = @"Tor";
     
     return self;
 }
 
+- (int)takeControlSocket {
+    @synchronized (self) {
+        int socket = _controlSocket;
+        _controlSocket = -1;
+
+        return socket;
+    }
+}
+
+- (void)start {
+    dispatch_group_enter(_running);
+
+    [super start];
+}
+
 - (void)main {
     NSArray *arguments = self.arguments;
     int argc = (int)(arguments.count + 1);
@@ -62,10 +99,83 @@ static __weak TORThread *_thread = nil;
 //    event_enable_debug_mode();
 //#endif
 
-    tor_main_configuration_t *cfg = tor_main_configuration_new();
+    tor_main_configuration_t *cfg = _cfg;
+    _cfg = NULL;
+
+    // Tor frees all its global state, including logs, when it exits.
+    if (_runs > 0)
+        TORReinstallTorLogging();
+
     tor_main_configuration_set_command_line(cfg, argc, argv);
     tor_run_main(cfg);
     tor_main_configuration_free(cfg);
+
+    _runs++;
+
+    [self cleanUp];
+
+    dispatch_group_leave(_running);
+}
+
+- (void)stop {
+    @synchronized (self) {
+        // Tor exits, as soon as its owning controller connection closes.
+        if (_ownerSocket >= 0)
+            shutdown(_ownerSocket, SHUT_RDWR);
+    }
+}
+
+- (BOOL)joinWithTimeout:(NSTimeInterval)timeout {
+    dispatch_time_t deadline = timeout > 0 ? dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC)) : DISPATCH_TIME_FOREVER;
+
+    return dispatch_group_wait(_running, deadline) == 0;
+}
+
+- (nullable TORThread *)restartWithArguments:(nullable NSArray<NSString *> *)arguments timeout:(NSTimeInterval)timeout {
+    [self stop];
+
+    if (![self joinWithTimeout:timeout])
+        return nil;
+
+    // Never started, so `-main` didn't clean up.
+    [self cleanUp];
+
+    TORThread *thread = [[TORThread alloc] initWithArguments:arguments ?: self.arguments];
+    [thread start];
+
+    return thread;
+}
+
+- (nullable TORThread *)restartWithConfiguration:(nullable TORConfiguration *)configuration timeout:(NSTimeInterval)timeout {
+    return [self restartWithArguments:configuration ? [configuration compile] : nil timeout:timeout];
+}
+
+- (void)cleanUp {
+    @synchronized (self) {
+        if (_ownerSocket >= 0) {
+            close(_ownerSocket);
+            _ownerSocket = -1;
+        }
+
+        // Nobody took it.
+        if (_controlSocket >= 0) {
+            close(_controlSocket);
+            _controlSocket = -1;
+        }
+    }
+
+    @synchronized (TORThread.class) {
+        if (_thread == self)
+            _thread = nil;
+    }
+}
+
+- (void)dealloc {
+    [self cleanUp];
+
+    // Never started.
+    if (_cfg)
+        tor_main_configuration_free(_cfg);
 }
 
 @end
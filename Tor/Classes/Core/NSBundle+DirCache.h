@@ -0,0 +1,47 @@
+//
+//  NSBundle+DirCache.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A directory cache packed with `Tor/dircache.sh`, so a fresh install doesn't need to download
+ the consensus and all microdescriptors, before it can build a circuit.
+
+ Even when the packed consensus is outdated, Tor only needs to fetch a new one and the
+ microdescriptors which changed since.
+ */
+@interface NSBundle (DirCache)
+
+/**
+ The "DirCache" bundle of the @c DirCache subspec.
+ */
+@property (class, readonly, nullable) NSBundle *dirCacheBundle;
+
+/**
+ The time, from which the packed consensus is valid, or nil, if this bundle contains no directory cache.
+ */
+@property (readonly, nullable) NSDate *dirCacheValidAfter;
+
+/**
+ Copy the packed directory cache to a cache directory, if that is empty or holds an older consensus.
+
+ Files are cloned, where the file system supports it, and checked against the manifest. They replace
+ existing files atomically.
+
+ Needs to be called before Tor is started with that cache directory.
+
+ @param cacheDirectory @c TORConfiguration.cacheDirectory, or @c dataDirectory, if that isn't set.
+ @param error Set, if NO is returned.
+ @return YES, if the cache directory holds a consensus at least as recent as the packed one now.
+ */
+- (BOOL)installDirCacheTo:(NSURL *)cacheDirectory error:(out NSError **)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,206 @@
+//
+//  NSBundle+DirCache.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "NSBundle+DirCache.h"
+#import "TORConfiguration.h"
+
+#import <CommonCrypto/CommonDigest.h>
+#import <copyfile.h>
+
+static NSString * const TORDirCacheConsensus = @"cached-microdesc-consensus";
+
+@implementation NSBundle (DirCache)
+
++ (NSBundle *)dirCacheBundle
+{
+    NSURL *url = [[NSBundle bundleForClass:TORConfiguration.class] URLForResource:@"DirCache" withExtension:@"bundle"];
+    if (!url) return nil;
+
+    return [NSBundle bundleWithURL:url];
+}
+
+- (NSDate *)dirCacheValidAfter
+{
+    return [self.class dateFromValidAfter:self.dirCacheManifest[@"valid-after"]];
+}
+
+- (BOOL)installDirCacheTo:(NSURL *)cacheDirectory error:(out NSError **)error
+{
+    NSDictionary *manifest = self.dirCacheManifest;
+    NSDate *validAfter = [self.class dateFromValidAfter:manifest[@"valid-after"]];
+    NSDictionary<NSString *, NSString *> *files = manifest[@"files"];
+
+    if (!validAfter || ![files isKindOfClass:NSDictionary.class] || !files[TORDirCacheConsensus])
+    {
+        if (error)
+        {
+            *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadNoSuchFileError
+                                     userInfo:@{NSLocalizedDescriptionKey: @"Bundle contains no directory cache."}];
+        }
+
+        return NO;
+    }
+
+    NSDate *installed = [self.class validAfterOfConsensus:[cacheDirectory URLByAppendingPathComponent:TORDirCacheConsensus]];
+
+    if (installed && [installed compare:validAfter] != NSOrderedAscending)
+    {
+        return YES;
+    }
+
+    if (![NSFileManager.defaultManager createDirectoryAtURL:cacheDirectory withIntermediateDirectories:YES attributes:nil error:error])
+    {
+        return NO;
+    }
+
+    // The consensus goes last: If anything fails before, the old one stays and this is tried again next time.
+    NSMutableArray<NSString *> *names = [files.allKeys mutableCopy];
+    [names removeObject:TORDirCacheConsensus];
+    [names addObject:TORDirCacheConsensus];
+
+    // Stage all files first, so a broken bundle doesn't leave a mix of old and new.
+    NSMutableArray<NSURL *> *staged = [NSMutableArray new];
+    BOOL success = YES;
+
+    for (NSString *name in names)
+    {
+        NSURL *source = [self URLForResource:name withExtension:nil];
+        NSURL *temp = [cacheDirectory URLByAppendingPathComponent:[name stringByAppendingString:@".dircache"]];
+
+        if (!source || ![self.class fileAt:source hasDigest:files[name]])
+        {
+            if (error)
+            {
+                *error = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadCorruptFileError
+                                         userInfo:@{NSLocalizedDescriptionKey: [NSString stringWithFormat:@"\"%@\" doesn't match the manifest.", name]}];
+            }
+
+            success = NO;
+            break;
+        }
+
+        unlink(temp.fileSystemRepresentation);
+
+        // Clones, where possible, falls back to a copy otherwise.
+        if (copyfile(source.fileSystemRepresentation, temp.fileSystemRepresentation, NULL, COPYFILE_CLONE) != 0)
+        {
+            if (error)
+            {
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            }
+
+            success = NO;
+            break;
+        }
+
+        [staged addObject:temp];
+    }
+
+    for (NSUInteger i = 0; i < staged.count; i++)
+    {
+        NSURL *temp = staged[i];
+
+        if (success && rename(temp.fileSystemRepresentation, [cacheDirectory URLByAppendingPathComponent:names[i]].fileSystemRepresentation) != 0)
+        {
+            if (error)
+            {
+                *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+            }
+
+            success = NO;
+        }
+
+        if (!success)
+        {
+            unlink(temp.fileSystemRepresentation);
+        }
+    }
+
+    return success;
+}
+
+
+// MARK: Private Methods
+
+- (nullable NSDictionary *)dirCacheManifest
+{
+    NSURL *url = [self URLForResource:@"manifest" withExtension:@"json"];
+    if (!url) return nil;
+
+    NSData *data = [NSData dataWithContentsOfURL:url];
+    if (!data) return nil;
+
+    NSDictionary *manifest = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+
+    return [manifest isKindOfClass:NSDictionary.class] ? manifest : nil;
+}
+
+/**
+ @return The "valid-after" time from the head of a consensus file, or nil, if there is none.
+ */
++ (nullable NSDate *)validAfterOfConsensus:(NSURL *)url
+{
+    NSFileHandle *fh = [NSFileHandle fileHandleForReadingFromURL:url error:nil];
+    if (!fh) return nil;
+
+    // It's in the first few lines.
+    NSData *head = [fh readDataOfLength:1024];
+    [fh closeFile];
+
+    NSString *content = [[NSString alloc] initWithData:head encoding:NSASCIIStringEncoding];
+
+    for (NSString *line in [content componentsSeparatedByString:@"\n"])
+    {
+        if ([line hasPrefix:@"valid-after "])
+        {
+            return [self dateFromValidAfter:[line substringFromIndex:12]];
+        }
+    }
+
+    return nil;
+}
+
++ (nullable NSDate *)dateFromValidAfter:(nullable NSString *)validAfter
+{
+    static NSDateFormatter *formatter;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        formatter = [NSDateFormatter new];
+        formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+        formatter.dateFormat = @"yyyy-MM-dd HH:mm:ss";
+    });
+
+    if (![validAfter isKindOfClass:NSString.class]) return nil;
+
+    return [formatter dateFromString:validAfter];
+}
+
++ (BOOL)fileAt:(NSURL *)url hasDigest:(NSString *)digest
+{
+    NSData *data = [NSData dataWithContentsOfURL:url options:NSDataReadingMappedIfSafe error:nil];
+
+    if (!data || ![digest isKindOfClass:NSString.class])
+    {
+        return NO;
+    }
+
+    unsigned char hash[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256(data.bytes, (CC_LONG)data.length, hash);
+
+    NSMutableString *hex = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+
+    for (NSUInteger i = 0; i < CC_SHA256_DIGEST_LENGTH; i++)
+    {
+        [hex appendFormat:@"%02x", hash[i]];
+    }
+
+    return [hex caseInsensitiveCompare:digest] == NSOrderedSame;
+}
+
+@end
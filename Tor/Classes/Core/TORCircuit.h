@@ -371,8 +371,24 @@ See https://torproject.gitlab.io/torspec/control-spec.html#getinfo
 + (NSArray<TORCircuit *> *)circuitsFromString:(NSString *)circuitsString;
 
 
+/**
+ Parses a line as returned by "GETINFO circuit-status" or contained in a CIRC event (without the "CIRC" keyword).
+
+ Works in a single pass over the UTF-8 bytes of the line.
+
+ @param circuitString A circuit status line.
+ */
 - (instancetype)initFromString:(NSString *)circuitString;
 
+/**
+ The former regular expression based parser. Slow, but easy to verify.
+
+ Kept as a reference to test @c initFromString: against. Don't use in production code.
+
+ @param circuitString A circuit status line.
+ */
+- (instancetype)initWithRegexFromString:(NSString *)circuitString;
+
 
 @end
 
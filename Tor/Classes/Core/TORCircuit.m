@@ -8,6 +8,8 @@
 #import "TORCircuit.h"
 #import "NSCharacterSet+PredefinedSets.h"
 
+#import <time.h>
+
 @implementation TORCircuit
 
 
@@ -304,21 +306,385 @@ static NSDateFormatter *_timestampFormatter;
 {
     NSMutableArray<TORCircuit *> *circuits = [NSMutableArray new];
 
-    for (NSString *circuitString in [circuitsString componentsSeparatedByString:@"\r\n"]) {
-        if (circuitString.length > 0)
+    const uint8_t *p = (const uint8_t *)circuitsString.UTF8String;
+    const uint8_t *end = p ? p + strlen((const char *)p) : NULL;
+
+    while (p < end)
+    {
+        const uint8_t *lf = memchr(p, '\n', (size_t)(end - p));
+        const uint8_t *lineEnd = lf ?: end;
+        const uint8_t *next = lf ? lf + 1 : end;
+
+        if (lineEnd > p && lineEnd[-1] == '\r')
+        {
+            lineEnd--;
+        }
+
+        if (lineEnd > p)
         {
-            [circuits addObject:
-             [[TORCircuit alloc] initFromString:circuitString]];
+            NSString *raw = [[NSString alloc] initWithBytes:p length:(NSUInteger)(lineEnd - p) encoding:NSUTF8StringEncoding];
+
+            if (raw)
+            {
+                [circuits addObject:
+                 [[TORCircuit alloc] initWithRaw:raw bytes:p length:(size_t)(lineEnd - p)]];
+            }
         }
+
+        p = next;
     }
 
     return circuits;
 }
 
 
+// MARK: Tokenizer
+
+/**
+ Returns the next token separated by spaces and advances @c p behind it.
+ Spaces inside quoted strings don't end a token.
+
+ @return The start of the token or NULL, if there are no more tokens.
+ */
+static const uint8_t *TORNextToken(const uint8_t **p, const uint8_t *end, size_t *length)
+{
+    const uint8_t *c = *p;
+
+    while (c < end && *c == ' ')
+    {
+        c++;
+    }
+
+    if (c >= end)
+    {
+        *p = end;
+        *length = 0;
+
+        return NULL;
+    }
+
+    const uint8_t *start = c;
+    BOOL quoted = NO;
+
+    for (; c < end; c++)
+    {
+        if (quoted && *c == '\\' && c + 1 < end)
+        {
+            c++;
+        }
+        else if (*c == '"')
+        {
+            quoted = !quoted;
+        }
+        else if (*c == ' ' && !quoted)
+        {
+            break;
+        }
+    }
+
+    *p = c;
+    *length = (size_t)(c - start);
+
+    return start;
+}
+
+static BOOL TORIsWord(const uint8_t *bytes, size_t length)
+{
+    if (!bytes || length < 1)
+    {
+        return NO;
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t c = bytes[i];
+
+        if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_'))
+        {
+            return NO;
+        }
+    }
+
+    return YES;
+}
+
+static NSString *TORStringFromBytes(const uint8_t *bytes, size_t length)
+{
+    return [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+}
+
+/**
+ Removes the quotes of a QuotedString and resolves its backslash escapes.
+ Unquoted values are returned as they are.
+ */
+static NSString *TORStringFromQuotedBytes(const uint8_t *bytes, size_t length)
+{
+    if (length < 2 || bytes[0] != '"' || bytes[length - 1] != '"')
+    {
+        return TORStringFromBytes(bytes, length);
+    }
+
+    bytes++;
+    length -= 2;
+
+    if (!memchr(bytes, '\\', length))
+    {
+        return TORStringFromBytes(bytes, length);
+    }
+
+    NSMutableData *unescaped = [NSMutableData dataWithCapacity:length];
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (bytes[i] == '\\' && i + 1 < length)
+        {
+            i++;
+        }
+
+        [unescaped appendBytes:bytes + i length:1];
+    }
+
+    return TORStringFromBytes(unescaped.bytes, unescaped.length);
+}
+
+/**
+ Maps the status to the class constants, so no string needs to be created for it.
+ */
+static NSString *TORStatusFromToken(const uint8_t *bytes, size_t length)
+{
+    if (!bytes)
+    {
+        return nil;
+    }
+
+    static NSArray<NSString *> *statuses;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        statuses = @[TORCircuit.statusBuilt, TORCircuit.statusExtended, TORCircuit.statusLaunched,
+                     TORCircuit.statusGuardWait, TORCircuit.statusFailed, TORCircuit.statusClosed];
+    });
+
+    for (NSString *status in statuses)
+    {
+        // The constants are ASCII, so their length equals their byte length.
+        if (status.length == length && strncasecmp((const char *)bytes, status.UTF8String, length) == 0)
+        {
+            return status;
+        }
+    }
+
+    return nil;
+}
+
+/**
+ Splits a path of comma separated "LongNames" into @c TORNode objects.
+ */
+static NSArray<TORNode *> *TORNodesFromPath(const uint8_t *bytes, size_t length)
+{
+    NSMutableArray<TORNode *> *nodes = [NSMutableArray new];
+    const uint8_t *end = bytes + length;
+
+    while (bytes < end)
+    {
+        const uint8_t *comma = memchr(bytes, ',', (size_t)(end - bytes));
+        const uint8_t *nodeEnd = comma ?: end;
+
+        const uint8_t *divider = bytes;
+
+        while (divider < nodeEnd && *divider != '~' && *divider != '=')
+        {
+            divider++;
+        }
+
+        TORNode *node = [TORNode new];
+        node.fingerprint = TORStringFromBytes(bytes, (size_t)(divider - bytes));
+
+        if (divider < nodeEnd)
+        {
+            node.nickName = TORStringFromBytes(divider + 1, (size_t)(nodeEnd - divider - 1));
+        }
+
+        [nodes addObject:node];
+
+        bytes = comma ? comma + 1 : end;
+    }
+
+    return nodes;
+}
+
+static BOOL TORParseDigits(const uint8_t *bytes, size_t count, int *value)
+{
+    *value = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (bytes[i] < '0' || bytes[i] > '9')
+        {
+            return NO;
+        }
+
+        *value = *value * 10 + (bytes[i] - '0');
+    }
+
+    return YES;
+}
+
+/**
+ Parses an ISOTime2Frac like "2023-11-20T10:02:51.713542", which is always in UTC.
+ */
+static NSDate *TORDateFromTimestamp(const uint8_t *b, size_t length)
+{
+    if (length < 19 || b[4] != '-' || b[7] != '-' || b[10] != 'T' || b[13] != ':' || b[16] != ':')
+    {
+        return nil;
+    }
+
+    int year, month, day, hour, minute, second;
+
+    if (!TORParseDigits(b, 4, &year) || !TORParseDigits(b + 5, 2, &month)
+        || !TORParseDigits(b + 8, 2, &day) || !TORParseDigits(b + 11, 2, &hour)
+        || !TORParseDigits(b + 14, 2, &minute) || !TORParseDigits(b + 17, 2, &second))
+    {
+        return nil;
+    }
+
+    struct tm tm = {0};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = second;
+
+    NSTimeInterval fraction = 0;
+
+    if (length > 20 && b[19] == '.')
+    {
+        NSTimeInterval scale = 0.1;
+
+        for (size_t i = 20; i < length && b[i] >= '0' && b[i] <= '9'; i++, scale /= 10)
+        {
+            fraction += (b[i] - '0') * scale;
+        }
+    }
+
+    return [NSDate dateWithTimeIntervalSince1970:(NSTimeInterval)timegm(&tm) + fraction];
+}
+
+
 // MARK: Initializers
 
 - (instancetype)initFromString:(NSString *)circuitString
+{
+    const char *bytes = circuitString.UTF8String;
+
+    return [self initWithRaw:circuitString bytes:(const uint8_t *)bytes length:bytes ? strlen(bytes) : 0];
+}
+
+/**
+ Tokenizes the circuit line in a single pass over its UTF-8 bytes.
+
+ Syntax:
+ CircuitID SP CircStatus [SP Path] [SP "BUILD_FLAGS=" BuildFlags] [SP "PURPOSE=" Purpose] ...
+ */
+- (instancetype)initWithRaw:(NSString *)raw bytes:(const uint8_t *)bytes length:(size_t)length
+{
+    self = [super init];
+
+    if (self)
+    {
+        _raw = raw;
+
+        const uint8_t *p = bytes;
+        const uint8_t *end = bytes + length;
+        size_t tokenLength;
+
+        const uint8_t *circuitId = TORNextToken(&p, end, &tokenLength);
+        size_t circuitIdLength = tokenLength;
+
+        const uint8_t *token = TORNextToken(&p, end, &tokenLength);
+        NSString *status = TORStatusFromToken(token, tokenLength);
+
+        if (status && TORIsWord(circuitId, circuitIdLength))
+        {
+            _circuitId = TORStringFromBytes(circuitId, circuitIdLength);
+            _status = status;
+
+            token = TORNextToken(&p, end, &tokenLength);
+
+            if (token && *token == '$')
+            {
+                _nodes = TORNodesFromPath(token, tokenLength);
+
+                token = TORNextToken(&p, end, &tokenLength);
+            }
+        }
+
+        for (; token; token = TORNextToken(&p, end, &tokenLength))
+        {
+            const uint8_t *equals = memchr(token, '=', tokenLength);
+
+            if (!equals)
+            {
+                continue;
+            }
+
+            size_t keyLength = (size_t)(equals - token);
+            const uint8_t *value = equals + 1;
+            size_t valueLength = tokenLength - keyLength - 1;
+
+            if (valueLength < 1)
+            {
+                continue;
+            }
+
+#define TOR_KEY_IS(key) (keyLength == sizeof(key) - 1 && memcmp(token, key, keyLength) == 0)
+
+            if (TOR_KEY_IS("BUILD_FLAGS"))
+            {
+                _buildFlags = [TORStringFromBytes(value, valueLength) componentsSeparatedByString:@","];
+            }
+            else if (TOR_KEY_IS("PURPOSE"))
+            {
+                _purpose = TORStringFromBytes(value, valueLength);
+            }
+            else if (TOR_KEY_IS("HS_STATE"))
+            {
+                _hsState = TORStringFromBytes(value, valueLength);
+            }
+            else if (TOR_KEY_IS("REND_QUERY"))
+            {
+                _rendQuery = TORStringFromBytes(value, valueLength);
+            }
+            else if (TOR_KEY_IS("TIME_CREATED"))
+            {
+                _timeCreated = TORDateFromTimestamp(value, valueLength);
+            }
+            else if (TOR_KEY_IS("REASON"))
+            {
+                _reason = TORStringFromBytes(value, valueLength);
+            }
+            else if (TOR_KEY_IS("REMOTE_REASON"))
+            {
+                _remoteReason = TORStringFromBytes(value, valueLength);
+            }
+            else if (TOR_KEY_IS("SOCKS_USERNAME"))
+            {
+                _socksUsername = TORStringFromQuotedBytes(value, valueLength);
+            }
+            else if (TOR_KEY_IS("SOCKS_PASSWORD"))
+            {
+                _socksPassword = TORStringFromQuotedBytes(value, valueLength);
+            }
+
+#undef TOR_KEY_IS
+        }
+    }
+
+    return self;
+}
+
+- (instancetype)initWithRegexFromString:(NSString *)circuitString
 {
     self = [super init];
 
@@ -0,0 +1,78 @@
+//
+//  TORConfigurationDiff.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class TORConfiguration;
+
+/**
+ The options, which changed between two configurations, split into those a running Tor can take
+ with @c SETCONF and those, which need a restart.
+
+ Both configurations are compared by what they compile to, so typed properties, @c options and
+ @c arguments are all covered. Options, which are given more than once, like @c Bridge or @c SocksPort,
+ are compared as a list.
+
+ Apply with @c -[TORController applyConfigurationDiff:completion:].
+ */
+NS_SWIFT_NAME(TorConfigurationDiff)
+@interface TORConfigurationDiff : NSObject
+
+/**
+ Changed options, which can be applied to a running Tor, in the order of the new configuration.
+ Removed options come last.
+ */
+@property (nonatomic, readonly) NSArray<NSString *> *hotKeys;
+
+/**
+ Changed options and command line flags, which Tor only takes on start.
+ */
+@property (nonatomic, readonly) NSArray<NSString *> *restartKeys;
+
+/**
+ YES, if nothing changed.
+ */
+@property (nonatomic, readonly, getter=isEmpty) BOOL empty;
+
+/**
+ YES, if Tor needs to be restarted to apply all changes.
+ */
+@property (nonatomic, readonly) BOOL needsRestart;
+
+/**
+ The arguments to a single @c SETCONF, which applies all of @c hotKeys.
+
+ Values are quoted, where needed. Removed options are given without a value, which resets them to their default.
+ Hidden service options depend on each other, so if one of them changed, all of them are set again.
+ */
+@property (nonatomic, readonly) NSArray<NSString *> *setConfArguments;
+
+/**
+ Tor options, which can't be changed, while Tor is running.
+ */
+#if __has_feature(objc_class_property)
+@property (class, readonly) NSSet<NSString *> *restartOptions;
+#else
++ (NSSet<NSString *> *)restartOptions;
+#endif
+
+- (instancetype)init NS_UNAVAILABLE;
+
+- (instancetype)initFrom:(TORConfiguration *)from to:(TORConfiguration *)to NS_DESIGNATED_INITIALIZER;
+
++ (instancetype)diffFrom:(TORConfiguration *)from to:(TORConfiguration *)to;
+
+/**
+ @return The argument for @c SETCONF, with the value quoted, if needed. Just the key, if no value is given.
+ */
++ (NSString *)setConfArgumentForKey:(NSString *)key value:(nullable NSString *)value;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,300 @@
+//
+//  TORConfigurationDiff.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORConfigurationDiff.h"
+#import "TORConfiguration.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Options of a compiled configuration, grouped by key, in order of first appearance.
+ */
+@interface TORConfigurationOptions : NSObject
+
+// Lowercased keys.
+@property (nonatomic, readonly) NSMutableArray<NSString *> *keys;
+
+// Lowercased key to key as written.
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, NSString *> *names;
+
+// Lowercased key to all its values. Command line flags have an empty list.
+@property (nonatomic, readonly) NSMutableDictionary<NSString *, NSMutableArray<NSString *> *> *values;
+
+// All options in their original order as key and value, if any.
+@property (nonatomic, readonly) NSMutableArray<NSArray<NSString *> *> *options;
+
+- (instancetype)initWithArguments:(NSArray<NSString *> *)arguments;
+
+@end
+
+@implementation TORConfigurationOptions
+
+- (instancetype)initWithArguments:(NSArray<NSString *> *)arguments
+{
+    self = [super init];
+
+    if (self)
+    {
+        _keys = [NSMutableArray new];
+        _names = [NSMutableDictionary new];
+        _values = [NSMutableDictionary new];
+        _options = [NSMutableArray new];
+
+        for (NSUInteger i = 0; i < arguments.count; i++)
+        {
+            NSString *argument = arguments[i];
+
+            if (![argument hasPrefix:@"-"])
+            {
+                continue;
+            }
+
+            NSString *name = [argument stringByTrimmingCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@"-"]];
+            NSString *key = name.lowercaseString;
+
+            NSMutableArray<NSString *> *values = _values[key];
+
+            if (!values)
+            {
+                values = [NSMutableArray new];
+                _values[key] = values;
+                _names[key] = name;
+                [_keys addObject:key];
+            }
+
+            if (i + 1 < arguments.count && ![arguments[i + 1] hasPrefix:@"--"])
+            {
+                [values addObject:arguments[++i]];
+                [_options addObject:@[name, arguments[i]]];
+            }
+            else {
+                [_options addObject:@[name]];
+            }
+        }
+    }
+
+    return self;
+}
+
+@end
+
+
+@implementation TORConfigurationDiff
+{
+    TORConfigurationOptions *_to;
+}
+
++ (NSSet<NSString *> *)restartOptions
+{
+    static NSSet<NSString *> *options;
+    static dispatch_once_t onceToken;
+
+    // As refused by Tor's `options_transition_allowed()`.
+    dispatch_once(&onceToken, ^{
+        options = [NSSet setWithArray:@[
+            @"DataDirectory", @"DataDirectoryGroupReadable", @"KeyDirectory", @"KeyDirectoryGroupReadable",
+            @"CacheDirectory", @"CacheDirectoryGroupReadable", @"User", @"PidFile", @"RunAsDaemon",
+            @"Sandbox", @"HardwareAccel", @"AccelName", @"AccelDir", @"TestingTorNetwork",
+            @"DisableAllSwap", @"DisableDebuggerAttachment", @"NoExec", @"SyslogIdentityTag",
+            @"HiddenServiceSingleHopMode", @"HiddenServiceNonAnonymousMode", @"TokenBucketRefillInterval",
+        ]];
+    });
+
+    return options;
+}
+
+/**
+ Flags, which are only understood on the command line, not by @c SETCONF.
+ */
++ (NSSet<NSString *> *)commandLineFlags
+{
+    static NSSet<NSString *> *flags;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        flags = [NSSet setWithArray:@[
+            @"f", @"torrc-file", @"defaults-torrc", @"allow-missing-torrc", @"ignore-missing-torrc",
+            @"quiet", @"hush", @"nt-service",
+        ]];
+    });
+
+    return flags;
+}
+
++ (instancetype)diffFrom:(TORConfiguration *)from to:(TORConfiguration *)to
+{
+    return [[self alloc] initFrom:from to:to];
+}
+
+- (instancetype)initFrom:(TORConfiguration *)from to:(TORConfiguration *)to
+{
+    self = [super init];
+
+    if (self)
+    {
+        TORConfigurationOptions *old = [[TORConfigurationOptions alloc] initWithArguments:[from compile]];
+        _to = [[TORConfigurationOptions alloc] initWithArguments:[to compile]];
+
+        NSMutableSet<NSString *> *restartOptions = [NSMutableSet new];
+
+        for (NSString *option in self.class.restartOptions)
+        {
+            [restartOptions addObject:option.lowercaseString];
+        }
+
+        [restartOptions unionSet:self.class.commandLineFlags];
+
+        NSMutableArray<NSString *> *keys = [_to.keys mutableCopy];
+
+        for (NSString *key in old.keys)
+        {
+            if (!_to.values[key])
+            {
+                [keys addObject:key];
+            }
+        }
+
+        NSMutableArray<NSString *> *hotKeys = [NSMutableArray new];
+        NSMutableArray<NSString *> *restartKeys = [NSMutableArray new];
+
+        for (NSString *key in keys)
+        {
+            if ([old.values[key] isEqualToArray:(NSArray * _Nonnull)_to.values[key]])
+            {
+                continue;
+            }
+
+            NSString *name = _to.names[key] ?: old.names[key];
+
+            if ([restartOptions containsObject:key])
+            {
+                [restartKeys addObject:(NSString * _Nonnull)name];
+            }
+            else {
+                [hotKeys addObject:(NSString * _Nonnull)name];
+            }
+        }
+
+        _hotKeys = hotKeys;
+        _restartKeys = restartKeys;
+    }
+
+    return self;
+}
+
+
+// MARK: Public Properties
+
+- (BOOL)isEmpty
+{
+    return _hotKeys.count < 1 && _restartKeys.count < 1;
+}
+
+- (BOOL)needsRestart
+{
+    return _restartKeys.count > 0;
+}
+
+- (NSArray<NSString *> *)setConfArguments
+{
+    NSMutableArray<NSString *> *arguments = [NSMutableArray new];
+    BOOL hiddenServicesSet = NO;
+
+    for (NSString *name in _hotKeys)
+    {
+        NSString *key = name.lowercaseString;
+
+        // Hidden services are configured by the order of their options, so send all of them together.
+        if ([key hasPrefix:@"hiddenservice"])
+        {
+            if (!hiddenServicesSet)
+            {
+                [arguments addObjectsFromArray:[self hiddenServiceArguments]];
+                hiddenServicesSet = YES;
+            }
+
+            continue;
+        }
+
+        NSArray<NSString *> *values = _to.values[key];
+
+        if (values.count < 1)
+        {
+            [arguments addObject:[self.class setConfArgumentForKey:name value:nil]];
+
+            continue;
+        }
+
+        for (NSString *value in values)
+        {
+            [arguments addObject:[self.class setConfArgumentForKey:name value:value]];
+        }
+    }
+
+    return arguments;
+}
+
+
+// MARK: Public Methods
+
++ (NSString *)setConfArgumentForKey:(NSString *)key value:(nullable NSString *)value
+{
+    if (!value)
+    {
+        return key;
+    }
+
+    NSCharacterSet *special = [NSCharacterSet characterSetWithCharactersInString:@" \t\r\n\"\\"];
+
+    if (value.length > 0 && [value rangeOfCharacterFromSet:special].location == NSNotFound)
+    {
+        return [NSString stringWithFormat:@"%@=%@", key, value];
+    }
+
+    NSString *escaped = [[[[[value
+                             stringByReplacingOccurrencesOfString:@"\\" withString:@"\\\\"]
+                            stringByReplacingOccurrencesOfString:@"\"" withString:@"\\\""]
+                           stringByReplacingOccurrencesOfString:@"\r" withString:@"\\r"]
+                          stringByReplacingOccurrencesOfString:@"\n" withString:@"\\n"]
+                         stringByReplacingOccurrencesOfString:@"\t" withString:@"\\t"];
+
+    return [NSString stringWithFormat:@"%@=\"%@\"", key, escaped];
+}
+
+
+// MARK: Private Methods
+
+/**
+ All hidden service options of the new configuration in their original order, or a reset, if there are none.
+ */
+- (NSArray<NSString *> *)hiddenServiceArguments
+{
+    NSMutableArray<NSString *> *arguments = [NSMutableArray new];
+
+    for (NSArray<NSString *> *option in _to.options)
+    {
+        NSString *key = option.firstObject.lowercaseString;
+
+        // The global modes can't be changed without a restart and aren't part of any service.
+        if ([key hasPrefix:@"hiddenservice"] && ![key isEqualToString:@"hiddenservicesinglehopmode"]
+            && ![key isEqualToString:@"hiddenservicenonanonymousmode"])
+        {
+            [arguments addObject:[self.class setConfArgumentForKey:option.firstObject value:option.count > 1 ? option[1] : nil]];
+        }
+    }
+
+    if (arguments.count < 1)
+    {
+        [arguments addObject:@"HiddenServiceDir"];
+    }
+
+    return arguments;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,85 @@
+//
+//  TORControlReplyParser.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Called for every complete reply.
+
+ @param codes The status codes of all lines of the reply.
+ @param lines The content of all lines of the reply without status code, line type and CR-LF.
+    A data block is collapsed into the line which opened it, with its lines separated by CR-LF.
+ */
+typedef void (^TORControlReplyHandler)(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines);
+
+/**
+ Receives a data block in chunks, while it is read.
+
+ @param lines Complete lines of the data block, each terminated by CR-LF. A subrange of the data read, nothing is copied.
+ @return NO to drop the rest of the data block.
+ */
+typedef BOOL (^TORControlDataSink)(dispatch_data_t lines);
+
+/**
+ Called, when a data block starts.
+
+ @param codes The status codes of the reply so far, including the one of the line opening the data block.
+ @param line The content of the line opening the data block, e.g. "ns/all=".
+ @return A sink to stream the data block to, or nil to collect it as usual.
+ */
+typedef TORControlDataSink _Nullable (^TORControlDataSinkProvider)(NSArray<NSNumber *> *codes, NSData *line);
+
+/**
+ Incremental parser for replies from the Tor control port.
+
+ Works as a byte-level state machine over the chunks read from the socket: Every byte is
+ looked at exactly once, no matter how the stream is split into chunks. Unconsumed data is
+ kept as a chain of the original @c dispatch_data_t regions and a read cursor, so nothing is
+ ever compacted or copied. The line slices handed out are subranges of these regions.
+
+ See https://spec.torproject.org/control-spec/protocol-outline.html
+ */
+NS_SWIFT_NAME(TorControlReplyParser)
+@interface TORControlReplyParser : NSObject
+
+/**
+ The number of bytes currently retained, because they belong to a line or data block, which is not complete, yet.
+ */
+@property (nonatomic, readonly) size_t bufferedLength;
+
+/**
+ If set, asked for a sink for every data block.
+
+ A streamed data block is released as soon as it was handed to the sink, so it never needs to be
+ held in memory as a whole. In the reply, it is replaced by the content of its opening line.
+ */
+@property (nonatomic, copy, nullable) TORControlDataSinkProvider dataSinkProvider;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ @param handler Called synchronously from within @c parseData: for every complete reply.
+ */
+- (instancetype)initWithHandler:(TORControlReplyHandler)handler NS_DESIGNATED_INITIALIZER;
+
+/**
+ Feed the next chunk of the stream.
+
+ @param data The next chunk as read from the control socket.
+ */
+- (void)parseData:(dispatch_data_t)data;
+
+/**
+ Drop all buffered data and partial replies, e.g. after the connection was closed.
+ */
+- (void)reset;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,317 @@
+//
+//  TORControlReplyParser.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORControlReplyParser.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+static const uint8_t TORControlReplyMidLineSeparator = '-';
+static const uint8_t TORControlReplyDataLineSeparator = '+';
+static const uint8_t TORControlReplyEndLineSeparator = ' ';
+
+@implementation TORControlReplyParser {
+    TORControlReplyHandler _handler;
+
+    // All data not consumed, yet. Starts at absolute stream offset `_base`.
+    dispatch_data_t _buffer;
+    size_t _base;
+
+    // Absolute stream offset of the first byte of the next chunk.
+    size_t _end;
+
+    // Absolute stream offset of the current line.
+    size_t _lineStart;
+
+    // The first 4 bytes of the current line: The status code and the line type.
+    uint8_t _head[4];
+
+    // The byte before the one currently looked at. Needed to detect a CR-LF spanning two chunks.
+    uint8_t _previous;
+
+    BOOL _dataBlock;
+
+    // Absolute stream offset of the content of the current data block.
+    size_t _dataStart;
+
+    // The sink the current data block is streamed to, if any, and the absolute stream offset
+    // of the first line not handed to it, yet.
+    TORControlDataSink _sink;
+    size_t _sinkStart;
+
+    NSMutableArray<NSNumber *> *_codes;
+    NSMutableArray<NSData *> *_lines;
+}
+
+- (instancetype)initWithHandler:(TORControlReplyHandler)handler
+{
+    NSParameterAssert(handler);
+
+    self = [super init];
+
+    if (self)
+    {
+        _handler = [handler copy];
+
+        [self reset];
+    }
+
+    return self;
+}
+
+
+// MARK: Public Properties
+
+- (size_t)bufferedLength
+{
+    return _end - _base;
+}
+
+
+// MARK: Public Methods
+
+- (void)parseData:(dispatch_data_t)data
+{
+    if (dispatch_data_get_size(data) < 1)
+    {
+        return;
+    }
+
+    _buffer = dispatch_data_create_concat(_buffer, data);
+
+    dispatch_data_apply(data, ^bool(dispatch_data_t __unused region, size_t __unused offset, const void *buffer, size_t size) {
+        [self scan:buffer length:size];
+
+        return true;
+    });
+
+    // Hand all lines completed in this chunk to the sink in one go.
+    if (_sink && _lineStart > _sinkStart)
+    {
+        [self sinkUntil:_lineStart];
+    }
+
+    // Release all regions which were completely consumed. This doesn't copy anything,
+    // the remaining regions are just referenced by a new, shorter chain.
+    size_t keep = _dataBlock && !_sink ? MIN(_dataStart, _lineStart) : _lineStart;
+
+    if (keep > _base)
+    {
+        _buffer = dispatch_data_create_subrange(_buffer, keep - _base, _end - keep);
+        _base = keep;
+    }
+}
+
+- (void)reset
+{
+    _buffer = dispatch_data_empty;
+    _base = 0;
+    _end = 0;
+    _lineStart = 0;
+    _previous = 0;
+    _dataBlock = NO;
+    _dataStart = 0;
+    _sink = nil;
+    _sinkStart = 0;
+    _codes = [NSMutableArray new];
+    _lines = [NSMutableArray new];
+}
+
+
+// MARK: Private Methods
+
+- (void)scan:(const uint8_t *)bytes length:(size_t)length
+{
+    size_t i = 0;
+
+    while (i < length)
+    {
+        size_t index = _end + i - _lineStart;
+
+        // The head of a line needs a closer look, so go byte by byte.
+        if (index < sizeof(_head))
+        {
+            uint8_t c = bytes[i];
+
+            if (c == '\n' && _previous == '\r')
+            {
+                [self endLineAt:_end + i];
+            }
+            else {
+                _head[index] = c;
+            }
+
+            _previous = c;
+            i++;
+
+            continue;
+        }
+
+        // Everything else only needs to be searched for the line end.
+        const uint8_t *lf = memchr(bytes + i, '\n', length - i);
+
+        if (!lf)
+        {
+            _previous = bytes[length - 1];
+
+            break;
+        }
+
+        size_t j = (size_t)(lf - bytes);
+        uint8_t previous = j > i ? bytes[j - 1] : _previous;
+
+        if (previous == '\r')
+        {
+            [self endLineAt:_end + j];
+        }
+
+        _previous = '\n';
+        i = j + 1;
+    }
+
+    _end += length;
+}
+
+/**
+ @param lf The absolute stream offset of the LF of the CR-LF terminating the current line.
+ */
+- (void)endLineAt:(size_t)lf
+{
+    size_t start = _lineStart;
+    size_t length = lf - 1 - start;
+
+    _lineStart = lf + 1;
+
+    if (_dataBlock)
+    {
+        if (length == 1 && _head[0] == '.')
+        {
+            if (_sink)
+            {
+                // The last lines end right before the terminating dot.
+                [self sinkUntil:start];
+
+                _sink = nil;
+                _dataBlock = NO;
+
+                return;
+            }
+
+            // The data block is contiguous in the stream: Its lines already are separated
+            // by CR-LF, which is exactly what we hand out, so it can be sliced in one go.
+            size_t end = start - 2;
+
+            [_lines addObject:[self sliceFrom:_dataStart length:(end > _dataStart ? end - _dataStart : 0)]];
+
+            _dataBlock = NO;
+        }
+
+        return;
+    }
+
+    if (length < 4)
+    {
+        return;
+    }
+
+    NSInteger code = 0;
+
+    for (NSUInteger i = 0; i < 3; i++)
+    {
+        if (_head[i] < '0' || _head[i] > '9')
+        {
+            return;
+        }
+
+        code = code * 10 + (_head[i] - '0');
+    }
+
+    uint8_t type = _head[3];
+
+    if (type == TORControlReplyDataLineSeparator)
+    {
+        [_codes addObject:@(code)];
+
+        _dataBlock = YES;
+
+        if (_dataSinkProvider)
+        {
+            NSData *line = [self sliceFrom:start + 4 length:length - 4];
+
+            _sink = _dataSinkProvider([_codes copy], line);
+
+            if (_sink)
+            {
+                [_lines addObject:line];
+
+                _sinkStart = _lineStart;
+
+                return;
+            }
+        }
+
+        // If the opening line has no content of its own, the block starts with its first line.
+        _dataStart = length > 4 ? start + 4 : _lineStart;
+
+        return;
+    }
+
+    if (type != TORControlReplyMidLineSeparator && type != TORControlReplyEndLineSeparator)
+    {
+        return;
+    }
+
+    [_codes addObject:@(code)];
+    [_lines addObject:[self sliceFrom:start + 4 length:length - 4]];
+
+    if (type == TORControlReplyEndLineSeparator)
+    {
+        NSArray<NSNumber *> *codes = _codes;
+        NSArray<NSData *> *lines = _lines;
+
+        _codes = [NSMutableArray new];
+        _lines = [NSMutableArray new];
+
+        _handler(codes, lines);
+    }
+}
+
+/**
+ Hand all lines from `_sinkStart` up to the given absolute stream offset to the sink.
+ */
+- (void)sinkUntil:(size_t)end
+{
+    if (end <= _sinkStart)
+    {
+        return;
+    }
+
+    dispatch_data_t lines = dispatch_data_create_subrange(_buffer, _sinkStart - _base, end - _sinkStart);
+
+    _sinkStart = end;
+
+    if (!_sink(lines))
+    {
+        // The rest of the block still needs to be read, but goes nowhere.
+        _sink = ^BOOL(dispatch_data_t __unused lines) {
+            return YES;
+        };
+    }
+}
+
+- (NSData *)sliceFrom:(size_t)start length:(size_t)length
+{
+    if (length < 1)
+    {
+        return [NSData data];
+    }
+
+    return (NSData *)dispatch_data_create_subrange(_buffer, start - _base, length);
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
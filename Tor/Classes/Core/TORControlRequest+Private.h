@@ -0,0 +1,27 @@
+//
+//  TORControlRequest+Private.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORControlRequest.h"
+#import "TORController.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Only to be used on the queue it was created with, except for `-cancel`.
+
+ Internal to the framework: Requests are created and finished by @c TORController.
+ */
+@interface TORControlRequest ()
+
+- (instancetype)initWithCommand:(NSString *)command queue:(dispatch_queue_t)queue completion:(nullable TORRequestCompletion)completion;
+
+- (void)timeoutAfter:(NSTimeInterval)timeout;
+- (void)finishWithCodes:(NSArray<NSNumber *> *)codes lines:(NSArray<NSData *> *)lines error:(nullable NSError *)error;
+
+@end
+
+NS_ASSUME_NONNULL_END
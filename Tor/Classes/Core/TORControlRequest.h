@@ -0,0 +1,55 @@
+//
+//  TORControlRequest.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ A command sent to Tor, which is waiting for its reply.
+
+ The completion of a request is called exactly once: With Tor's reply, or with an error in the
+ @c TORControllerErrorDomain, when the request was cancelled, timed out or couldn't be sent.
+
+ Nothing ever waits for a reply: Cancelling or timing out just calls the completion early. As Tor
+ answers strictly in order, a late reply is still read from the connection, but then ignored.
+ */
+NS_SWIFT_NAME(TorControlRequest)
+@interface TORControlRequest : NSObject
+
+/**
+ The command keyword, e.g. @c GETINFO.
+ */
+@property (readonly) NSString *command;
+
+/**
+ YES, as soon as the completion was called.
+ */
+@property (readonly, getter=isFinished) BOOL finished;
+
+/**
+ YES, if the request was cancelled before it finished.
+ */
+@property (readonly, getter=isCancelled) BOOL cancelled;
+
+/**
+ The error the request finished with, if any.
+ */
+@property (readonly, nullable) NSError *error;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ Finish the request with a @c TORControllerErrorCancelled error, if it isn't finished, yet.
+
+ If the command wasn't written to the connection, yet, it won't be sent at all.
+ */
+- (void)cancel;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,87 @@
+//
+//  TORControlRequest.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORControlRequest+Private.h"
+#import "TORController+Private.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation TORControlRequest {
+    dispatch_queue_t _queue;
+    TORRequestCompletion _completion;
+}
+
+- (instancetype)initWithCommand:(NSString *)command queue:(dispatch_queue_t)queue completion:(nullable TORRequestCompletion)completion
+{
+    self = [super init];
+    if (self)
+    {
+        _command = [command copy];
+        _queue = queue;
+        _completion = [completion copy];
+    }
+
+    return self;
+}
+
+- (void)cancel
+{
+    dispatch_async(_queue, ^{
+        if (self->_finished)
+        {
+            return;
+        }
+
+        self->_cancelled = YES;
+
+        [self finishWithCodes:@[] lines:@[] error:[TORController errorWithCode:TORControllerErrorCancelled
+                                                                  description:@"Request cancelled."]];
+    });
+}
+
+/**
+ Finish with a @c TORControllerErrorTimedOut error after the given time, if not finished, yet.
+
+ @param timeout Seconds. 0 or less for no timeout.
+ */
+- (void)timeoutAfter:(NSTimeInterval)timeout
+{
+    if (timeout <= 0)
+    {
+        return;
+    }
+
+    __weak TORControlRequest *weakSelf = self;
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC)), _queue, ^{
+        [weakSelf finishWithCodes:@[] lines:@[] error:[TORController errorWithCode:TORControllerErrorTimedOut
+                                                                      description:@"Request timed out."]];
+    });
+}
+
+- (void)finishWithCodes:(NSArray<NSNumber *> *)codes lines:(NSArray<NSData *> *)lines error:(nullable NSError *)error
+{
+    if (_finished)
+    {
+        return;
+    }
+
+    _error = error;
+    _finished = YES;
+
+    TORRequestCompletion completion = _completion;
+    _completion = nil;
+
+    if (completion)
+    {
+        completion(codes, lines, error);
+    }
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
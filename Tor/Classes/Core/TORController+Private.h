@@ -0,0 +1,28 @@
+//
+//  TORController+Private.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORController.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Internal to the framework, e.g. for @c TORControlRequest.
+ */
+@interface TORController ()
+
++ (NSError *)errorWithCode:(TORControllerError)code description:(NSString *)description;
+
+/**
+ Load "GETINFO ns/all" into a new relay index on this connection, without keeping it.
+
+ @param completion Called on the control queue with the index, or nil on error.
+ */
+- (void)fetchRelayIndex:(void (^)(TORRelayIndex * _Nullable relayIndex))completion;
+
+@end
+
+NS_ASSUME_NONNULL_END
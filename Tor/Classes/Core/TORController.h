@@ -7,6 +7,12 @@
 
 #import <Foundation/Foundation.h>
 #import "TORCircuit.h"
+#import "TORRelayIndex.h"
+#import "TORGeoIPDatabase.h"
+#import "TORConfiguration.h"
+#import "TORConfigurationDiff.h"
+#import "TORControlRequest.h"
+#import "TORControlReplyParser.h"
 
 #ifdef __cplusplus
 #define TOR_EXTERN extern "C" __attribute__((visibility ("default")))
@@ -14,6 +20,10 @@
 #define TOR_EXTERN extern __attribute__((visibility ("default")))
 #endif
 
+#ifndef NS_SWIFT_ASYNC
+#define NS_SWIFT_ASYNC(COMPLETION_ARG_INDEX)
+#endif
+
 NS_ASSUME_NONNULL_BEGIN
 
 typedef BOOL (^TORObserverBlock)(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL *stop);
@@ -24,16 +34,117 @@ TOR_EXTERN NSErrorDomain const TORControllerErrorDomain;
 TOR_EXTERN NSString * const TORControllerErrorDomain;
 #endif
 
+/**
+ Error codes in the @c TORControllerErrorDomain, which don't come from Tor.
+
+ Errors Tor replied with carry Tor's reply code, which is always positive.
+ */
+typedef NS_ENUM(NSInteger, TORControllerError) {
+    TORControllerErrorCancelled = -1,
+    TORControllerErrorTimedOut = -2,
+    TORControllerErrorNotConnected = -3,
+    TORControllerErrorWriteFailed = -4,
+    TORControllerErrorDisconnected = -5,
+    TORControllerErrorEmptyReply = -6,
+} NS_SWIFT_NAME(TorControllerError);
+
+/**
+ @param codes The reply codes of each line of Tor's reply. Empty, if there's an error.
+ @param lines The lines of Tor's reply. Empty, if there's an error.
+ @param error Set, if the request was cancelled, timed out or couldn't be sent.
+ */
+typedef void (^TORRequestCompletion)(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, NSError * _Nullable error);
+
 NS_SWIFT_NAME(TorController)
 @interface TORController : NSObject
 
 @property (nonatomic, readonly, copy) NSOrderedSet<NSString *> *events;
 @property (nonatomic, readonly, getter=isConnected) BOOL connected;
 
+/**
+ Index of all relays in the current consensus. Only loaded with @c -loadRelayIndex: and replaced
+ with every new consensus afterwards.
+
+ Without it, circuit nodes are looked up one by one with "GETINFO ns/id/<fingerprint>".
+ */
+@property (nullable) TORRelayIndex *relayIndex;
+
+/**
+ Loads the relay index somewhere else instead of on this connection, e.g. on a bulk connection
+ of a @c TORControllerPool.
+
+ If set, @c -loadRelayIndex: and every new consensus go through it, and tracking circuits asks it
+ for an index, if none is loaded, yet. The completion may be called on any queue.
+ */
+@property (nullable, copy) void (^relayIndexProvider)(void (^completion)(TORRelayIndex * __nullable relayIndex));
+
+/**
+ The serial queue all replies of this controller are handled on, and all completions, observers and event blocks are called on.
+
+ Every controller has its own, so controllers don't hold up each other.
+ */
+@property (nonatomic, readonly) dispatch_queue_t controlQueue;
+
+/**
+ If set, countries of nodes are looked up in this database instead of asking Tor.
+
+ See @c TORGeoIPDatabase.bundledDatabase.
+ */
+@property (nullable) TORGeoIPDatabase *geoIpDatabase;
+
 - (instancetype)init NS_UNAVAILABLE;
-- (instancetype)initWithSocketURL:(NSURL *)url NS_DESIGNATED_INITIALIZER;
-- (instancetype)initWithSocketHost:(NSString *)host port:(in_port_t)port NS_DESIGNATED_INITIALIZER;
+- (instancetype)initWithSocketURL:(NSURL *)url;
+- (instancetype)initWithSocketHost:(NSString *)host port:(in_port_t)port;
+
+/**
+ @param qos The quality of service of the @c controlQueue.
+ */
+- (instancetype)initWithSocketURL:(NSURL *)url qualityOfService:(NSQualityOfService)qos NS_DESIGNATED_INITIALIZER;
+
+/**
+ @param qos The quality of service of the @c controlQueue.
+ */
+- (instancetype)initWithSocketHost:(NSString *)host port:(in_port_t)port qualityOfService:(NSQualityOfService)qos NS_DESIGNATED_INITIALIZER;
 - (instancetype)initWithControlPortFile:(NSURL *)file;
+- (instancetype)initWithControlSocket:(int)socket;
+
+/**
+ Attach to a connected control socket, e.g. @c TORThread.controlSocket.
+
+ The controller takes ownership of the socket and closes it, when it's disconnected or deallocated.
+ The connection can't be restored, when it's lost.
+
+ A control socket created by @c TORThread is already authenticated and usable before Tor finished
+ starting. Use @c -[TORThread stop] to make Tor exit.
+
+ @param qos The quality of service of the @c controlQueue.
+ */
+- (instancetype)initWithControlSocket:(int)socket qualityOfService:(NSQualityOfService)qos NS_DESIGNATED_INITIALIZER;
+
+/**
+ Restore the connection, when it's lost, e.g. because Tor restarted. Defaults to NO.
+
+ Commands waiting for a reply, when the connection is lost, fail with @c TORControllerErrorDisconnected.
+ They are not sent again, as Tor might have executed them already.
+
+ After reconnecting, the controller authenticates with the cookie of @c configuration, subscribes to
+ all observed events again and reloads the circuit table, if it's tracked.
+
+ Reconnection isn't attempted after @c -disconnect.
+ */
+@property (atomic) BOOL automaticallyReconnects;
+
+/**
+ Attempts to reconnect start after half a second and back off exponentially up to this delay. Defaults to 30 seconds.
+ */
+@property (atomic) NSTimeInterval maximumReconnectDelay;
+
+/**
+ The configuration Tor was started with. Its cookie is read anew for every reconnect, as Tor writes a new one on start.
+
+ If not set, the controller doesn't authenticate after reconnecting.
+ */
+@property (atomic, nullable) TORConfiguration *configuration;
 
 - (BOOL)connect:(out NSError **)error;
 - (void)disconnect;
@@ -43,19 +154,178 @@ NS_SWIFT_NAME(TorController)
 - (void)resetConfForKey:(NSString *)key completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion;
 - (void)setConfForKey:(NSString *)key withValue:(NSString *)value completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion;
 - (void)setConfs:(NSArray<NSDictionary *> *)configs completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion;
+
+/**
+ Apply all changes of a configuration diff, which a running Tor can take, with one @c SETCONF.
+
+ Changes in @c diff.restartKeys are left out. Check @c diff.needsRestart and restart Tor for those,
+ e.g. with @c -[TORThread restartWithConfiguration:timeout:].
+
+ Tor applies all or none of the options in one @c SETCONF, so on failure, nothing changed.
+ */
+- (void)applyConfigurationDiff:(TORConfigurationDiff *)diff completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion NS_SWIFT_ASYNC(2);
+
+/**
+ Explicitly subscribe to a list of events, additionally to the ones observers are registered for.
+
+ The controller sends @c SETEVENTS itself with the union of these and all events any observer
+ registered with @c -addObserverForEvents:block: is interested in.
+
+ @param events Event keywords, e.g. @c CIRC. Replaces a list given earlier.
+ @param completion Completion callback.
+ */
 - (void)listenForEvents:(NSArray<NSString *> *)events completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion;
-- (void)getInfoForKeys:(NSArray<NSString *> *)keys completion:(void (^)(NSArray<NSString *> *values))completion; // TODO: Provide errors
-- (void)getSessionConfiguration:(void (^)(NSURLSessionConfiguration * __nullable configuration))completion;
+
+- (void)getInfoForKeys:(NSArray<NSString *> *)keys completion:(void (^)(NSArray<NSString *> *values))completion NS_SWIFT_ASYNC(2);
+
+/**
+ Get info from Tor, with a deadline and a way to cancel.
+
+ Always sent immediately: Not merged with other calls and not answered from the info cache.
+
+ @param keys The info keys to get.
+ @param timeout Seconds until the request fails with @c TORControllerErrorTimedOut. 0 for no timeout.
+ @param completion Called on the control queue with the values in the order of the keys, or with an error.
+    Errors Tor replied with carry Tor's reply code.
+ @return A handle to cancel the request.
+ */
+- (TORControlRequest *)getInfoForKeys:(NSArray<NSString *> *)keys
+                              timeout:(NSTimeInterval)timeout
+                           completion:(void (^)(NSArray<NSString *> * __nullable values, NSError * __nullable error))completion;
+
+/**
+ Get a large info value like "ns/all" or "md/all" as a stream.
+
+ The lines of the value are handed to the sink in chunks, while they are read, and are released
+ afterwards. So the value never needs to be held in memory as a whole.
+
+ The sink is called on the control queue and nothing more is read from the connection, until it
+ returns. A slow sink therefore slows down Tor, instead of data piling up in memory.
+
+ Always sent immediately: Not merged with other calls and not answered from the info cache.
+
+ @param key The info key to get. A value Tor sends on one line is handed to the sink in one go.
+ @param sink Receives complete lines, each terminated by CR-LF, but not dot-unescaped. Return NO to drop the rest.
+ @param completion Called on the control queue after the last chunk, with an error, if Tor replied with one.
+ @return A handle to cancel the request. Once cancelled, the sink isn't called anymore.
+ */
+- (TORControlRequest *)getInfoForKey:(NSString *)key
+                         streamingTo:(TORControlDataSink)sink
+                          completion:(void (^__nullable)(NSError * __nullable error))completion;
+
+/**
+ Answer @c -getInfoForKeys:completion: from memory, where possible. Defaults to NO.
+
+ Only keys with a lifetime are cached, see @c -setInfoCacheLifetime:forKey:. By default, these are
+ @c version, @c net/listeners/*, @c ip-to-country/*, @c status/circuit-established and @c ns/id/*.
+
+ Cached values are dropped before their lifetime ends, when Tor sends an event indicating a change:
+ @c CONF_CHANGED (and configuration changes sent by this controller), @c NEWCONSENSUS,
+ @c NETWORK_LIVENESS and @c STATUS_CLIENT. Tor is subscribed to these, while caching is enabled.
+ @c NEWCONSENSUS carries the whole consensus, so it's only subscribed to, while an @c ns/* key is cached,
+ and its data is dropped unread, unless another observer needs it.
+ */
+@property (nonatomic) BOOL cachesInfo;
+
+/**
+ Number of keys answered from the cache.
+ */
+@property (readonly) NSUInteger infoCacheHits;
+
+/**
+ Number of keys, which needed to be asked for, while caching was enabled.
+ */
+@property (readonly) NSUInteger infoCacheMisses;
+
+/**
+ Set how long the value of an info key is cached.
+
+ @param lifetime Lifetime in seconds. 0 to not cache the key at all.
+ @param key An info key, e.g. @c net/listeners/socks, or a key prefix ending in "/", e.g. @c ns/id/.
+    The most specific one applies.
+ */
+- (void)setInfoCacheLifetime:(NSTimeInterval)lifetime forKey:(NSString *)key;
+
+/**
+ Drop all cached info values.
+ */
+- (void)clearInfoCache;
+- (void)getSessionConfiguration:(void (^)(NSURLSessionConfiguration * __nullable configuration))completion NS_SWIFT_ASYNC(1);
+
+/**
+ Send a raw command to Tor.
+
+ Commands are pipelined: Any number of them can be in flight on the connection at the same time.
+ Tor answers them strictly in the order they were sent, so replies are matched to their commands
+ first-in-first-out. Asynchronous events are never handed to a command's observer.
+
+ @param command The command keyword, e.g. @c GETINFO.
+ @param arguments Arguments of the command. Will be joined by space.
+ @param data Optional data, which is sent as a data block after the command line.
+ @param observer Called on the control queue with the reply to exactly this command. Empty arrays, if the command couldn't be written.
+    The return value and @c stop are ignored, the observer is always removed after the reply.
+ */
 - (void)sendCommand:(NSString *)command arguments:(nullable NSArray<NSString *> *)arguments data:(nullable NSData *)data observer:(TORObserverBlock)observer;
 
+/**
+ Send a raw command to Tor, with a deadline and a way to cancel.
+
+ Nothing blocks while waiting: A cancelled or timed-out request just finishes early with an error.
+ If it was already written, Tor's late reply is still read, so the following replies stay matched, but it is dropped.
+
+ From Swift, wrap it in @c withTaskCancellationHandler to tie it to task cancellation.
+
+ @param command The command keyword, e.g. @c GETINFO.
+ @param arguments Arguments of the command. Will be joined by space.
+ @param data Optional data, which is sent as a data block after the command line.
+ @param timeout Seconds until the request fails with @c TORControllerErrorTimedOut. 0 for no timeout.
+ @param completion Called exactly once on the control queue, with the reply to exactly this command or with an error.
+ @return A handle to cancel the request.
+ */
+- (TORControlRequest *)sendCommand:(NSString *)command
+                         arguments:(nullable NSArray<NSString *> *)arguments
+                              data:(nullable NSData *)data
+                           timeout:(NSTimeInterval)timeout
+                        completion:(nullable TORRequestCompletion)completion;
+
+/**
+ Coalesce @c GETINFO and @c SETCONF calls made during one turn of the control queue.
+
+ If set, calls to @c -getInfoForKeys:completion:, @c -setConfForKey:withValue:completion: and
+ @c -setConfs:completion: are collected until the control queue gets to them and are then sent
+ like in @c -performBatch:. Defaults to NO.
+ */
+@property (atomic) BOOL coalescesCommands;
+
+/**
+ Collect all @c GETINFO and @c SETCONF calls made in the block and send them as the fewest possible commands, once it returns.
+
+ Consecutive @c GETINFO calls are merged into one command. Consecutive @c SETCONF calls are merged, too, unless
+ they set a key, which is already set in the merged command. Any other command flushes what's collected so far,
+ so the order on the wire stays the order of the calls.
+
+ Every call still gets its own completion with its own values. If a merged command fails, its calls are
+ retried individually, so one unrecognized key or invalid value doesn't fail the others. Commands called after
+ a merged @c SETCONF are held back, until its reply is in, so its retries still go out before them. Retries of
+ a merged @c GETINFO, which has no side effects, may go out after later commands.
+
+ Batches can be nested. Commands are sent, when the outermost batch ends.
+
+ @param block Block, in which commands are sent. Called synchronously.
+ */
+- (void)performBatch:(void (NS_NOESCAPE ^)(void))block;
+
 /**
  Get a list of all currently available circuits with detailed information about their nodes.
 
+ The circuits are read from a table, which is seeded with the first call and then kept up to date
+ from @c CIRC and @c CIRC_MINOR events, so subsequent calls cause no traffic on the control port.
+
  @note There's no clear way to determine, which circuit actually was used by a specific request.
 
  @param completion The callback upon completion of the task. Will return A list of `TORCircuit`s . Empty if no circuit could be found.
  */
-- (void)getCircuits:(void (^)(NSArray<TORCircuit *> * _Nonnull circuits))completion;
+- (void)getCircuits:(void (^)(NSArray<TORCircuit *> * _Nonnull circuits))completion NS_SWIFT_ASYNC(1);
 
 /**
  Resets the Tor connection: Sends "SIGNAL RELOAD" and "SIGNAL NEWNYM" to the Tor thread.
@@ -64,7 +334,7 @@ NS_SWIFT_NAME(TorController)
 
  @param completion Completion callback. Will return true, if signal calls where successful, false if not.
  */
-- (void)resetConnection:(void (^__nullable)(BOOL success))completion;
+- (void)resetConnection:(void (^__nullable)(BOOL success))completion NS_SWIFT_ASYNC(1);
 
 /**
  Try to close a list of circuits identified by their IDs.
@@ -75,7 +345,7 @@ NS_SWIFT_NAME(TorController)
  @param circuitIds List of circuit IDs.
  @param completion Completion callback. Will return true, if *all* closings were successful, false, if *at least one* closing failed.
  */
-- (void)closeCircuitsByIds:(NSArray<NSString *> *)circuitIds completion:(void (^__nullable)(BOOL success))completion;
+- (void)closeCircuitsByIds:(NSArray<NSString *> *)circuitIds completion:(void (^__nullable)(BOOL success))completion NS_SWIFT_ASYNC(2);
 
 /**
  Try to close a list of given circuits.
@@ -85,24 +355,61 @@ NS_SWIFT_NAME(TorController)
 @param circuits List of circuits to close.
 @param completion  Completion callback. Will return true, if *all* closings were successful, false, if *at least one* closing failed.
 */
-- (void)closeCircuits:(NSArray<TORCircuit *> *)circuits completion:(void (^__nullable)(BOOL success))completion;
+- (void)closeCircuits:(NSArray<TORCircuit *> *)circuits completion:(void (^__nullable)(BOOL success))completion NS_SWIFT_ASYNC(2);
+
+/**
+ Load the complete network status with "GETINFO ns/all" into a new @c relayIndex, or through the
+ @c relayIndexProvider, if set. The index is kept up to date with every new consensus afterwards.
+
+ Circuit nodes found in the index are enriched from memory instead of with a "GETINFO ns/id/<fingerprint>" call per node.
+
+ @param completion Completion callback. Will return the new index, or nil on error.
+ */
+- (void)loadRelayIndex:(void (^__nullable)(TORRelayIndex * __nullable relayIndex))completion NS_SWIFT_ASYNC(1);
 
 /**
  Resolve countries of given `TORNode`s and updates their `countryCode` property on success.
 
  Nodes which already contain a `countryCode` will be ignored.
+ If a @c geoIpDatabase is set, it is used instead of Tor.
  IPv4 addresses will be preferred, if Tor is able to resolve IPv4 addresses (if it has loaded the IPv4 geoip database),
  and if the node has a `ipv4Address` property of non-zero length.
 
  @param nodes List of `TORNode`s to resolve countries for.
  @param testCapabilities Ask Tor first, if it is actually able to resolve. (If GeoDB databases are loaded.) Pass NO, if you're sure that Tor is able to to save on queries.
- @param completion Completion callback.
+ @param completion Completion callback. Called on the control queue.
  */
 - (void)resolveCountriesOfNodes:(NSArray<TORNode *> * _Nullable)nodes testCapabilities:(BOOL)testCapabilities completion:(void (^__nullable)(void))completion;
 
 // Observers
 - (id)addObserverForCircuitEstablished:(void (^)(BOOL established))block;
 - (id)addObserverForStatusEvents:(BOOL (^)(NSString *type, NSString *severity, NSString *action, NSDictionary<NSString *, NSString *> * __nullable arguments))block;
+
+/**
+ Register an observer for asynchronous events.
+
+ Events are routed by their keyword, which is read only once per event, so the cost of an event
+ doesn't depend on the number of observers registered for other events. Tor is subscribed to the
+ events automatically and unsubscribed again, when their last observer is removed.
+
+ @param events Event keywords, e.g. @c CIRC, @c STREAM, @c BW or @c STATUS_CLIENT.
+ @param block Called on the control queue for every event with one of the given keywords.
+    The return value is ignored, all observers of an event are called. Set @c stop to remove the observer.
+ @return An opaque observer object to use with @c -removeObserver:.
+ */
+- (id)addObserverForEvents:(NSArray<NSString *> *)events block:(TORObserverBlock)block;
+
+/**
+ Register an observer for changes of the circuit table.
+
+ The observer is called once the nodes of the changed circuits are enriched with their IP addresses and countries.
+
+ @param block Called on the control queue with the circuits which changed, including closed and failed ones,
+    and a snapshot of all current circuits.
+ @return An opaque observer object to use with @c -removeObserver:.
+ */
+- (id)addObserverForCircuitChanges:(void (^)(NSArray<TORCircuit *> *changed, NSArray<TORCircuit *> *circuits))block;
+
 - (void)removeObserver:(nullable id)observer;
 
 @end
@@ -5,7 +5,8 @@
 //  Created by Conrad Kramer on 5/10/14.
 //
 
-#import "TORController.h"
+#import "TORController+Private.h"
+#import "TORControlRequest+Private.h"
 
 #import <sys/socket.h>
 #import <sys/un.h>
@@ -14,6 +15,9 @@
 
 #import "TORControlReplyCode.h"
 #import "TORControlCommand.h"
+#import "TORControlReplyParser.h"
+#import "TORRelayIndex.h"
+#import "TORGeoIPDatabase.h"
 #import "NSCharacterSet+PredefinedSets.h"
 
 NS_ASSUME_NONNULL_BEGIN
@@ -24,43 +28,139 @@ NSErrorDomain const TORControllerErrorDomain = @"TORControllerErrorDomain";
 NSString * const TORControllerErrorDomain = @"TORControllerErrorDomain";
 #endif
 
-static NSString * const TORControllerMidReplyLineSeparator = @"-";
-static NSString * const TORControllerDataReplyLineSeparator = @"+";
-static NSString * const TORControllerEndReplyLineSeparator = @" ";
+// Upper bound of bytes read from the control connection, before they are handled.
+static const size_t TORControlReadLength = 64 * 1024;
+
+// First delay before reconnecting. Doubles with every failed attempt.
+static const NSTimeInterval TORControlReconnectDelay = 0.5;
+
+/**
+ A @c GETINFO or @c SETCONF call, waiting to be merged with others.
+ */
+@interface TORBatchedCommand : NSObject
+
+@property (nonatomic, readonly) NSString *command;
+@property (nonatomic, readonly) NSArray<NSString *> *arguments;
+@property (nonatomic, readonly) NSArray<NSString *> *keys;
+@property (nonatomic, readonly) TORObserverBlock observer;
+
+@end
+
+@implementation TORBatchedCommand
+
+- (instancetype)initWithCommand:(NSString *)command arguments:(NSArray<NSString *> *)arguments
+                           keys:(NSArray<NSString *> *)keys observer:(TORObserverBlock)observer
+{
+    self = [super init];
+    if (self)
+    {
+        _command = command;
+        _arguments = arguments;
+        _keys = keys;
+        _observer = observer;
+    }
+
+    return self;
+}
+
+@end
+
+
+@interface TORController ()
+
+@property NSUInteger infoCacheHits;
+@property NSUInteger infoCacheMisses;
+
+@end
+
 
 @implementation TORController {
     NSURL *_url;
     NSString *_host;
     in_port_t _port;
+    int _controlSocket;
     dispatch_io_t _channel;
-    NSMutableArray<TORObserverBlock> *_blocks;
+    NSMutableDictionary<NSString *, NSMutableArray<TORObserverBlock> *> *_eventObservers;
+    NSOrderedSet<NSString *> *_listenedEvents;
+    NSOrderedSet<NSString *> *_requestedEvents;
+    NSMutableArray<TORObserverBlock> *_pending;
     int sock;
+
+    // Set by `-disconnect`, so the connection isn't restored. Reconnection backoff.
+    BOOL _disconnected;
+    NSTimeInterval _reconnectDelay;
+
+    // Pending commands, which stream their data blocks. Only accessed on the control queue.
+    NSMapTable<TORObserverBlock, TORControlDataSink (^)(NSData *line)> *_dataSinks;
+
+    // GETINFO and SETCONF calls waiting to be merged. Only accessed on the control queue.
+    NSMutableArray<TORBatchedCommand *> *_batch;
+    NSUInteger _batchDepth;
+    BOOL _batchFlushScheduled;
+
+    // Writes held back, while a merged SETCONF is in flight, so its retries can still go out first.
+    BOOL _holdingWrites;
+    NSMutableArray<dispatch_block_t> *_heldWrites;
+
+    // GETINFO cache. Only accessed on the control queue, except for `_cachesInfo`.
+    BOOL _cachesInfo;
+    id _infoCacheObserver;
+    id _infoCacheConsensusObserver; // Only registered, while an "ns/" key is cached.
+    NSMutableDictionary<NSString *, NSString *> *_infoCache;
+    NSMutableDictionary<NSString *, NSNumber *> *_infoCacheExpiries;
+    NSMutableDictionary<NSString *, NSNumber *> *_infoCacheLifetimes;
+
+    // Relay index updates. Only accessed on the control queue.
+    id _relayIndexObserver; // Only registered, once a relay index was loaded.
+    TORRelayIndex *_nextRelayIndex; // Filled, while the data block of a NEWCONSENSUS event is read.
+
+    // Live circuit table. All of these are only accessed on the control queue.
+    // `_circuits` is nil, as long as nobody asked for circuits.
+    NSMutableDictionary<NSString *, TORCircuit *> *_circuits;
+    BOOL _circuitsSeeded;
+    BOOL _circuitsSeeding;
+    NSMutableDictionary<NSString *, TORNode *> *_circuitNodes;
+    NSMutableArray<TORCircuit *> *_circuitChanges;
+    NSUInteger _circuitEnrichments;
+    NSMutableArray<void (^)(NSArray<TORCircuit *> *circuits)> *_circuitWaiters;
+    NSMutableArray<void (^)(NSArray<TORCircuit *> *changed, NSArray<TORCircuit *> *circuits)> *_circuitObservers;
+    BOOL _ipv4Available;
+    BOOL _ipv6Available;
 }
 
-+ (dispatch_queue_t)controlQueue {
-    static dispatch_queue_t controlQueue = NULL;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        controlQueue = dispatch_queue_create("org.torproject.ios.control", DISPATCH_QUEUE_SERIAL);
-    });
-    return controlQueue;
++ (dispatch_queue_t)controlQueueWithQualityOfService:(NSQualityOfService)qos {
+    dispatch_queue_attr_t attributes = DISPATCH_QUEUE_SERIAL;
+
+    // NSQualityOfService uses the same values as qos_class_t.
+    if (qos != NSQualityOfServiceDefault)
+    {
+        attributes = dispatch_queue_attr_make_with_qos_class(attributes, (dispatch_qos_class_t)qos, 0);
+    }
+
+    return dispatch_queue_create("org.torproject.ios.control", attributes);
 }
 
 - (instancetype)initWithSocketURL:(NSURL *)url {
+    return [self initWithSocketURL:url qualityOfService:NSQualityOfServiceDefault];
+}
+
+- (instancetype)initWithSocketURL:(NSURL *)url qualityOfService:(NSQualityOfService)qos {
     NSParameterAssert(url.fileURL);
     self = [super init];
     if (!self)
         return nil;
     
     _url = [url copy];
-    _blocks = [NSMutableArray new];
-
-    [self connect:nil];
+    [self setUpWithQualityOfService:qos];
     
     return self;
 }
 
 - (instancetype)initWithSocketHost:(NSString *)host port:(in_port_t)port {
+    return [self initWithSocketHost:host port:port qualityOfService:NSQualityOfServiceDefault];
+}
+
+- (instancetype)initWithSocketHost:(NSString *)host port:(in_port_t)port qualityOfService:(NSQualityOfService)qos {
     NSParameterAssert(host && port);
     self = [super init];
     if (!self)
@@ -68,13 +168,46 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
     
     _host = [host copy];
     _port = port;
-    _blocks = [NSMutableArray new];
-
-    [self connect:nil];
+    [self setUpWithQualityOfService:qos];
     
     return self;
 }
 
+- (instancetype)initWithControlSocket:(int)socket {
+    return [self initWithControlSocket:socket qualityOfService:NSQualityOfServiceDefault];
+}
+
+- (instancetype)initWithControlSocket:(int)socket qualityOfService:(NSQualityOfService)qos {
+    NSParameterAssert(socket >= 0);
+    self = [super init];
+    if (!self)
+        return nil;
+
+    _controlSocket = socket;
+
+    [self setUpWithQualityOfService:qos];
+
+    return self;
+}
+
+- (void)setUpWithQualityOfService:(NSQualityOfService)qos {
+    _controlQueue = [self.class controlQueueWithQualityOfService:qos];
+    _maximumReconnectDelay = 30;
+    _eventObservers = [NSMutableDictionary new];
+    _listenedEvents = [NSOrderedSet new];
+    _pending = [NSMutableArray new];
+    _dataSinks = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality | NSPointerFunctionsStrongMemory
+                                       valueOptions:NSPointerFunctionsStrongMemory];
+    _batch = [NSMutableArray new];
+    _heldWrites = [NSMutableArray new];
+    _infoCache = [NSMutableDictionary new];
+    _infoCacheExpiries = [NSMutableDictionary new];
+    _infoCacheLifetimes = [self.class defaultInfoCacheLifetimes];
+    _circuitObservers = [NSMutableArray new];
+
+    [self connect:nil];
+}
+
 - (instancetype)initWithControlPortFile:(NSURL *)file {
     NSParameterAssert(file.fileURL);
 
@@ -120,8 +253,20 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
     }
     
     self->sock = -1;
+    _disconnected = NO;
     
     _events = [NSOrderedSet new];
+    _requestedEvents = [NSOrderedSet new];
+
+    // A new connection means, the circuit table needs to be seeded again.
+    dispatch_async(self.controlQueue, ^{
+        self->_circuitsSeeded = NO;
+        self->_circuitsSeeding = NO;
+
+        // ...and that cached info might be from another Tor.
+        [self->_infoCache removeAllObjects];
+        [self->_infoCacheExpiries removeAllObjects];
+    });
     
     if (_url)
     {
@@ -139,6 +284,8 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
                 *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
             }
 
+            close(self->sock);
+
             return NO;
         }
     }
@@ -170,23 +317,26 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
                 *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
             }
 
+            close(self->sock);
+
             return NO;
         }
     }
+    else if (_controlSocket >= 0)
+    {
+        // Can only be used once: It's closed with the connection.
+        self->sock = _controlSocket;
+        _controlSocket = -1;
+    }
     else {
         return NO;
     }
     
     __weak TORController *weakSelf = self;
+    int fd = self->sock;
 
-    _channel = dispatch_io_create(DISPATCH_IO_STREAM, self->sock, [self.class controlQueue], ^(int __unused error) {
-        close(self->sock);
-        
-        TORController *strongSelf = weakSelf;
-        if (strongSelf)
-        {
-            strongSelf->_channel = nil;
-        }
+    _channel = dispatch_io_create(DISPATCH_IO_STREAM, fd, self.controlQueue, ^(int __unused error) {
+        close(fd);
     });
 
     if (!_channel)
@@ -194,135 +344,210 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
         return NO;
     }
     
-    NSData *separator = [NSData dataWithBytes:"\x0d\x0a" length:2]; // also known as CR-LF or "\r\n"
-    NSData *period = [NSData dataWithBytes:"." length:1];
-
-    NSSet<NSString *> *lineSeparators = [NSSet setWithObjects:TORControllerMidReplyLineSeparator,
-                                         TORControllerDataReplyLineSeparator,
-                                         TORControllerEndReplyLineSeparator, nil];
-    
-    __block NSMutableData *buffer = [NSMutableData new];
-    __block NSMutableArray<NSNumber *> *codes = [NSMutableArray new];
-    __block NSMutableArray<NSData *> *lines = [NSMutableArray new];
-    __block BOOL dataBlock = NO;
-    
-    dispatch_io_set_low_water(_channel, 1);
-    dispatch_io_read(_channel, 0, SIZE_MAX, [self.class controlQueue], ^(bool __unused done, dispatch_data_t data, int __unused error) {
-        [buffer appendData:(NSData *)data];
-        
-        NSRange separatorRange;
-        NSRange remainingRange = NSMakeRange(0, buffer.length);
-
-        while ((separatorRange = [buffer rangeOfData:separator options:0 range:remainingRange]).location != NSNotFound)
+    TORControlReplyParser *parser = [[TORControlReplyParser alloc] initWithHandler:^(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines) {
+        TORController *strongSelf = weakSelf;
+        if (!strongSelf)
         {
-            NSUInteger lineLength = separatorRange.location - remainingRange.location;
-            NSRange lineRange = NSMakeRange(remainingRange.location, lineLength);
-            remainingRange = NSMakeRange(remainingRange.location + lineLength + separator.length,
-                                         remainingRange.length - lineLength - separator.length);
-            
-            if (dataBlock)
-            {
-                NSData *lineData = [buffer subdataWithRange:lineRange];
+            return;
+        }
 
-                if ([lineData isEqualToData:period])
-                {
-                    dataBlock = NO;
-                }
-                else {
-                    if (lines.count > 0)
-                    {
-                        if (lines.lastObject.length > 0)
-                        {
-                            NSMutableData *lastData = lines.lastObject.mutableCopy;
-
-                            // BUGFIX: Add in separator again. It is needed to pick apart multi-line results later!
-                            [lastData appendData:separator];
-                            [lastData appendData:lineData];
-
-                            [lines replaceObjectAtIndex:(lines.count - 1) withObject:lastData];
-                        }
-                        else {
-                            [lines replaceObjectAtIndex:(lines.count - 1) withObject:lineData];
-                        }
-                    }
-                    else {
-                        [lines addObject:lineData];
-                    }
-                }
+        // Tor answers commands strictly in the order they were sent.
+        // Only asynchronous events come in between.
+        if (codes.firstObject.integerValue != TORControlReplyCodeAsynchronousEventNotification)
+        {
+            TORObserverBlock observer = strongSelf->_pending.firstObject;
 
-                continue;
-            }
-            
-            if (lineRange.length < 4)
+            if (observer)
             {
-                continue;
+                [strongSelf->_pending removeObjectAtIndex:0];
+                [strongSelf->_dataSinks removeObjectForKey:observer];
+
+                BOOL stop = YES;
+                observer(codes, lines, &stop);
             }
 
-            NSString *statusCodeString = [[NSString alloc] initWithData:[buffer subdataWithRange:NSMakeRange(lineRange.location, 3)]
-                                                               encoding:NSUTF8StringEncoding];
+            return;
+        }
 
-            if ([statusCodeString rangeOfCharacterFromSet:NSCharacterSet.decimalDigitCharacterSet.invertedSet].location != NSNotFound)
-            {
-                continue;
-            }
-            
-            NSString *lineTypeString = [[NSString alloc] initWithData:[buffer subdataWithRange:NSMakeRange(lineRange.location + 3, 1)]
-                                                             encoding:NSUTF8StringEncoding];
+        [strongSelf dispatchEventWithCodes:codes lines:lines];
+    }];
 
-            if (![lineSeparators containsObject:lineTypeString])
-            {
-                continue;
-            }
+    parser.dataSinkProvider = ^TORControlDataSink _Nullable(NSArray<NSNumber *> *codes, NSData *line) {
+        TORController *strongSelf = weakSelf;
 
-            [codes addObject:@(statusCodeString.integerValue)];
-            [lines addObject:[buffer subdataWithRange:NSMakeRange(lineRange.location + 4, lineRange.length - 4)]];
-            
-            [buffer replaceBytesInRange:NSMakeRange(0, remainingRange.location) withBytes:NULL length:0];
-            remainingRange.location = 0;
+        if (!strongSelf)
+        {
+            return nil;
+        }
+
+        if (codes.firstObject.integerValue == TORControlReplyCodeAsynchronousEventNotification)
+        {
+            NSString *event = [TORController keywordOfEvent:line];
 
-            if ([lineTypeString isEqualToString:TORControllerDataReplyLineSeparator])
+            // Nobody looks at the data, so drop it right away, instead of collecting a whole consensus.
+            if (event && ![strongSelf needsDataOfEvent:(NSString * _Nonnull)event])
             {
-                dataBlock = YES;
-            }
-            
-            if ([lineTypeString isEqualToString:TORControllerEndReplyLineSeparator])
-            {
-                NSArray<NSNumber *> *commandCodes = codes;
-                NSArray<NSData *> *commandLines = lines;
-                codes = [NSMutableArray new];
-                lines = [NSMutableArray new];
-                
-                TORController *strongSelf = weakSelf;
-                if (!strongSelf)
+                // Except for the relay index, which is parsed while the consensus is read,
+                // unless it is loaded elsewhere.
+                if (strongSelf->_relayIndexObserver && !strongSelf.relayIndexProvider
+                    && [event isEqualToString:@"NEWCONSENSUS"])
                 {
-                    continue;
-                }
-                
-                for (TORObserverBlock observer in [strongSelf->_blocks copy]) {
-                    BOOL stop = NO;
-                    BOOL handled = observer(commandCodes, commandLines, &stop);
-
-                    if (stop)
-                    {
-                        [strongSelf->_blocks removeObject:observer];
-                    }
+                    TORRelayIndex *relayIndex = [TORRelayIndex new];
+                    strongSelf->_nextRelayIndex = relayIndex;
 
-                    if (handled)
-                    {
-                        break;
-                    }
+                    return [TORController sinkForRelayIndex:relayIndex];
                 }
+
+                return ^BOOL(dispatch_data_t __unused lines) {
+                    return NO;
+                };
             }
+
+            return nil;
         }
-    });
+
+        TORObserverBlock observer = strongSelf->_pending.firstObject;
+        TORControlDataSink (^sinkForLine)(NSData *line) = observer ? [strongSelf->_dataSinks objectForKey:observer] : nil;
+
+        return sinkForLine ? sinkForLine(line) : nil;
+    };
+
+    dispatch_io_set_low_water(_channel, 1);
+
+    [self readFromChannel:_channel withParser:parser];
     
     return YES;
 }
 
+/**
+ Reads at most `TORControlReadLength` bytes at a time and only starts the next read, when all of them were handled.
+
+ So a slow consumer of a streamed reply slows down reading from the socket, instead of data piling up in memory,
+ and Tor stops sending, when the socket buffer is full.
+ */
+- (void)readFromChannel:(dispatch_io_t)channel withParser:(TORControlReplyParser *)parser
+{
+    __weak TORController *weakSelf = self;
+    __block size_t received = 0;
+
+    dispatch_io_read(channel, 0, TORControlReadLength, self.controlQueue, ^(bool done, dispatch_data_t _Nullable data, int error) {
+        if (data)
+        {
+            received += dispatch_data_get_size(data);
+
+            [parser parseData:data];
+        }
+
+        if (!done)
+        {
+            return;
+        }
+
+        TORController *strongSelf = weakSelf;
+
+        // Less than asked for means, the connection was closed.
+        if (error || received < TORControlReadLength)
+        {
+            [strongSelf connectionLost:channel];
+        }
+        else if (strongSelf && strongSelf->_channel == channel)
+        {
+            [strongSelf readFromChannel:channel withParser:parser];
+        }
+    });
+}
+
+/**
+ Fails everything in flight and reconnects, if asked to.
+
+ Commands aren't replayed on a new connection, as Tor might have executed them already.
+
+ Needs to be called on the control queue.
+ */
+- (void)connectionLost:(dispatch_io_t)channel
+{
+    if (_channel != channel)
+    {
+        return;
+    }
+
+    _channel = nil;
+    dispatch_io_close(channel, DISPATCH_IO_STOP);
+
+    NSArray<TORObserverBlock> *pending = _pending;
+    _pending = [NSMutableArray new];
+    [_dataSinks removeAllObjects];
+
+    for (TORObserverBlock observer in pending)
+    {
+        BOOL stop = YES;
+        observer(@[], @[], &stop);
+    }
+
+    // A control socket handed over by Tor is gone for good.
+    if (self.automaticallyReconnects && !_disconnected && (_url || _host))
+    {
+        [self reconnect];
+    }
+}
+
+/**
+ Tries to connect again after a delay, which doubles with every attempt, and authenticates then.
+
+ Needs to be called on the control queue.
+ */
+- (void)reconnect
+{
+    NSTimeInterval delay = _reconnectDelay > 0 ? _reconnectDelay : TORControlReconnectDelay;
+    _reconnectDelay = MIN(delay * 2, MAX(self.maximumReconnectDelay, TORControlReconnectDelay));
+
+    __weak TORController *weakSelf = self;
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), self.controlQueue, ^{
+        TORController *strongSelf = weakSelf;
+
+        if (!strongSelf || strongSelf->_channel || strongSelf->_disconnected || !strongSelf.automaticallyReconnects)
+        {
+            return;
+        }
+
+        if (![strongSelf connect:nil])
+        {
+            [strongSelf reconnect];
+
+            return;
+        }
+
+        strongSelf->_reconnectDelay = 0;
+
+        // Tor writes a new cookie, when it restarts, so it needs to be read again.
+        TORConfiguration *configuration = strongSelf.configuration;
+
+        if (configuration)
+        {
+            // Subscribes to all events again, once authenticated.
+            [strongSelf authenticateWithData:configuration.cookie ?: [NSData data] completion:nil];
+        }
+        else {
+            [strongSelf updateEvents:nil];
+        }
+    });
+}
+
 - (void)disconnect {
+    dispatch_async(self.controlQueue, ^{
+        self->_disconnected = YES;
+    });
+
     [self sendCommand:TORCommandSignalShutdown arguments:nil data:nil observer:^BOOL(NSArray<NSNumber *> * __unused codes, NSArray<NSData *> * __unused lines, BOOL * __unused stop) {
-        shutdown(self->sock, SHUT_RDWR);
-        self->_channel = nil;
+        dispatch_io_t channel = self->_channel;
+
+        if (channel)
+        {
+            shutdown(self->sock, SHUT_RDWR);
+
+            [self connectionLost:channel];
+        }
      
         return YES;
      }];
@@ -333,56 +558,85 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
 - (id)addObserverForCircuitEstablished:(void (^)(BOOL established))block {
     NSParameterAssert(block);
     
-    NSString *event = @"STATUS_CLIENT";
-    id observer = [self addObserverForStatusEvents:^(NSString *type, NSString * __unused severity, NSString *action, NSDictionary<NSString *, NSString *> * __unused arguments) {
-        if ([type isEqualToString:event]) {
-            if ([action isEqualToString:@"CIRCUIT_ESTABLISHED"]) {
-                block(YES);
-                return YES;
-            } else if ([action isEqualToString:@"CIRCUIT_NOT_ESTABLISHED"]) {
-                block(NO);
-                return YES;
-            }
+    TORObserverBlock observer = [self observerForStatusEvents:^(NSString * __unused type, NSString * __unused severity, NSString *action, NSDictionary<NSString *, NSString *> * __unused arguments) {
+        if ([action isEqualToString:@"CIRCUIT_ESTABLISHED"]) {
+            block(YES);
+            return YES;
+        } else if ([action isEqualToString:@"CIRCUIT_NOT_ESTABLISHED"]) {
+            block(NO);
+            return YES;
         }
         
         return NO;
     }];
     
-    void (^completion)(BOOL, NSError *) = ^(BOOL success, NSError * __unused error) {
-        if (!success)
-            [self removeObserver:observer];
-        
-        [self getInfoForKeys:@[@"status/circuit-established"] completion:^(NSArray<NSString *> *values) {
-            if (values.count != 1)
-                return [self removeObserver:observer];
-            
-            if (block)
-                block([values[0] boolValue]);
-        }];
-    };
+    [self addObserverForEvents:@[@"STATUS_CLIENT"] block:observer];
     
-    dispatch_async([self.class controlQueue], ^{
-        if ([self->_events containsObject:event]) {
-            completion(YES, nil);
-        } else {
-            NSMutableOrderedSet *events = [self->_events mutableCopy];
-            [events addObject:event];
-            [self listenForEvents:events.array completion:completion];
-        }
-    });
+    // Commands are answered in order, so this is answered after the event subscription.
+    [self getInfoForKeys:@[@"status/circuit-established"] completion:^(NSArray<NSString *> *values) {
+        if (values.count == 1)
+            block([values[0] boolValue]);
+    }];
     
     return observer;
 }
 
 - (id)addObserverForStatusEvents:(BOOL (^)(NSString *type, NSString *severity, NSString *action, NSDictionary<NSString *, NSString *> *arguments))block {
     NSParameterAssert(block);
-    return [self addObserver:^(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL * __unused stop) {
-        if (codes.firstObject.integerValue != 650)
-            return NO;
+    
+    return [self addObserverForEvents:@[@"STATUS_GENERAL", @"STATUS_CLIENT", @"STATUS_SERVER"]
+                                block:[self observerForStatusEvents:block]];
+}
+
+- (id)addObserverForEvents:(NSArray<NSString *> *)events block:(TORObserverBlock)block {
+    NSParameterAssert(events.count && block);
+    
+    dispatch_async(self.controlQueue, ^{
+        for (NSString *event in events) {
+            NSMutableArray<TORObserverBlock> *observers = self->_eventObservers[event];
+            
+            if (!observers) {
+                observers = [NSMutableArray new];
+                self->_eventObservers[event] = observers;
+            }
+            
+            [observers addObject:block];
+        }
+        
+        [self updateEvents:nil];
+    });
+    
+    return block;
+}
+
+- (id)addObserverForCircuitChanges:(void (^)(NSArray<TORCircuit *> *changed, NSArray<TORCircuit *> *circuits))block {
+    NSParameterAssert(block);
+    
+    id observer = [block copy];
+    
+    dispatch_async(self.controlQueue, ^{
+        [self->_circuitObservers addObject:observer];
         
+        [self trackCircuits];
+    });
+    
+    return observer;
+}
+
+- (void)removeObserver:(nullable id)observer {
+    if (!observer)
+        return;
+    
+    dispatch_async(self.controlQueue, ^{
+        [self->_circuitObservers removeObject:(id _Nonnull)observer];
+        [self removeEventObserver:(id _Nonnull)observer];
+        [self updateEvents:nil];
+    });
+}
+
+- (TORObserverBlock)observerForStatusEvents:(BOOL (^)(NSString *type, NSString *severity, NSString *action, NSDictionary<NSString *, NSString *> *arguments))block {
+    return ^BOOL(NSArray<NSNumber *> * __unused codes, NSArray<NSData *> *lines, BOOL * __unused stop) {
         NSString *replyString = lines.firstObject ? [[NSString alloc] initWithData:(NSData * _Nonnull)lines.firstObject encoding:NSUTF8StringEncoding] : @"";
-        if (![replyString hasPrefix:@"STATUS_"])
-            return NO;
         
         NSArray<NSString *> *components = [replyString componentsSeparatedByString:@" "];
         if (components.count < 3)
@@ -401,154 +655,382 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
 
         NSString *type = (NSString * _Nonnull)components.firstObject;
         return block(type, components[1], components[2], arguments);
-    }];
+    };
 }
 
-- (id)addObserver:(TORObserverBlock)observer {
-    NSParameterAssert(observer);
-    dispatch_async([self.class controlQueue], ^{
-        [self->_blocks addObject:observer];
-    });
-    return observer;
-}
+/**
+ Reads the event keyword once and hands the event to the observers registered for exactly that keyword.
 
-- (void)removeObserver:(nullable id)observer {
-    if (!observer)
+ Needs to be called on the control queue.
+ */
+- (void)dispatchEventWithCodes:(NSArray<NSNumber *> *)codes lines:(NSArray<NSData *> *)lines {
+    NSString *event = [self.class keywordOfEvent:lines.firstObject];
+    if (!event)
         return;
     
-    dispatch_async([self.class controlQueue], ^{
-        [self->_blocks removeObject:(id _Nonnull)observer];
-    });
+    NSArray<TORObserverBlock> *observers = [_eventObservers[event] copy];
+    BOOL removed = NO;
+    
+    for (TORObserverBlock observer in observers) {
+        BOOL stop = NO;
+        observer(codes, lines, &stop);
+        
+        if (stop) {
+            [self removeEventObserver:observer];
+            removed = YES;
+        }
+    }
+    
+    if (removed)
+        [self updateEvents:nil];
 }
 
-#pragma mark - Sending Commands
+/**
+ @param line The first line of an event.
+ @return The keyword of the event, which is terminated by a space, or by the CR-LF in front of a data block.
+ */
++ (nullable NSString *)keywordOfEvent:(nullable NSData *)line {
+    if (!line)
+        return nil;
+    
+    const char *bytes = line.bytes;
+    NSUInteger length = 0;
+    while (length < line.length && bytes[length] != ' ' && bytes[length] != '\r')
+        length++;
+    
+    // Keywords are short enough to become tagged pointer strings, so this doesn't allocate.
+    return [[NSString alloc] initWithBytes:bytes length:length encoding:NSASCIIStringEncoding];
+}
 
-- (void)authenticateWithData:(NSData *)data completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion {
-    NSMutableString *hexString = [NSMutableString new];
-    for (NSUInteger idx = 0; idx < data.length; idx++)
-        [hexString appendFormat:@"%02x", ((const unsigned char *)data.bytes)[idx]];
+/**
+ The info cache only needs to know, that an event happened. The relay index reads the data block through its own sink.
+ The data block only needs to be collected for others.
+ 
+ Needs to be called on the control queue.
+ */
+- (BOOL)needsDataOfEvent:(NSString *)event {
+    for (TORObserverBlock observer in _eventObservers[event]) {
+        if (observer != _infoCacheObserver && observer != _infoCacheConsensusObserver && observer != _relayIndexObserver)
+            return YES;
+    }
     
-    [self sendCommand:TORCommandAuthenticate arguments:(hexString.length ? @[hexString] : nil) data:nil observer:^BOOL(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL *stop) {
-        NSUInteger code = codes.firstObject.unsignedIntegerValue;
-        if (code != TORControlReplyCodeOK && code != TORControlReplyCodeBadAuthentication)
-            return NO;
+    return NO;
+}
+
+/**
+ Needs to be called on the control queue.
+ */
+- (void)removeEventObserver:(TORObserverBlock)observer {
+    for (NSString *event in _eventObservers.allKeys) {
+        NSMutableArray<TORObserverBlock> *observers = _eventObservers[event];
         
-        NSString *message = lines.firstObject ? [[NSString alloc] initWithData:(NSData * _Nonnull)lines.firstObject encoding:NSUTF8StringEncoding] : @"";
-        NSDictionary<NSString *, NSString *> *userInfo = [NSDictionary dictionaryWithObjectsAndKeys:message, NSLocalizedDescriptionKey, nil];
-        BOOL success = (code == TORControlReplyCodeOK && [message isEqualToString:@"OK"]);
+        [observers removeObject:observer];
+        
+        if (observers.count < 1)
+            [_eventObservers removeObjectForKey:event];
+    }
+}
+
+/**
+ Subscribes to the union of the events explicitly listened to and all events any observer is registered for.
+
+ Needs to be called on the control queue.
+ */
+- (void)updateEvents:(void (^__nullable)(BOOL success, NSError * __nullable error))completion {
+    NSMutableOrderedSet<NSString *> *events = [_listenedEvents mutableCopy];
+    [events addObjectsFromArray:_eventObservers.allKeys];
+    
+    if ([events isEqualToOrderedSet:_requestedEvents]) {
         if (completion)
-            completion(success, success ? nil : [NSError errorWithDomain:TORControllerErrorDomain code:code userInfo:userInfo]);
+            completion(YES, nil);
         
-        *stop = YES;
-        return YES;
-    }];
+        return;
+    }
+    
+    _requestedEvents = [events copy];
+    
+    [self sendCommand:TORCommandSetEvents arguments:events.array data:nil observer:[self observerWithCompletion:^(BOOL success, NSError *error) {
+        if (success)
+            self->_events = [events copy];
+        else if ([self->_requestedEvents isEqualToOrderedSet:events])
+            self->_requestedEvents = self->_events; // Allow a retry, e.g. after authentication.
+        
+        if (completion)
+            completion(success, error);
+    }]];
 }
 
-- (void)resetConfForKey:(NSString *)key completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion {
-	[self sendCommand:TORCommandResetConf arguments:@[key] data:nil observer:^BOOL(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL *stop) {
-		NSUInteger code = codes.firstObject.unsignedIntegerValue;
-		if (code != TORControlReplyCodeOK && code != TORControlReplyCodeBadAuthentication)
-			return NO;
+#pragma mark - Sending Commands
 
-		NSString *message = lines.firstObject ? [[NSString alloc] initWithData:(NSData * _Nonnull)lines.firstObject encoding:NSUTF8StringEncoding] : @"";
-		NSDictionary<NSString *, NSString *> *userInfo = [NSDictionary dictionaryWithObjectsAndKeys:message, NSLocalizedDescriptionKey, nil];
-		BOOL success = (code == TORControlReplyCodeOK && [message isEqualToString:@"OK"]);
-		if (completion)
-			completion(success, success ? nil : [NSError errorWithDomain:TORControllerErrorDomain code:code userInfo:userInfo]);
+- (void)authenticateWithData:(NSData *)data completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion {
+    NSMutableString *hexString = [NSMutableString new];
+    for (NSUInteger idx = 0; idx < data.length; idx++)
+        [hexString appendFormat:@"%02x", ((const unsigned char *)data.bytes)[idx]];
+    
+    [self sendCommand:TORCommandAuthenticate arguments:(hexString.length ? @[hexString] : nil) data:nil
+             observer:[self observerWithCompletion:^(BOOL success, NSError *error) {
+        // Event subscriptions fail before authentication, so send them (again) now.
+        if (success) {
+            [self updateEvents:nil];
+            
+            if (self->_circuits && !self->_circuitsSeeded)
+                [self seedCircuits];
+        }
+        
+        if (completion)
+            completion(success, error);
+    }]];
+}
 
-		*stop = YES;
-		return YES;
-	}];
+- (void)resetConfForKey:(NSString *)key completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion {
+    [self sendCommand:TORCommandResetConf arguments:@[key] data:nil observer:[self observerWithCompletion:completion]];
 }
 
 - (void)setConfForKey:(NSString *)key withValue:(NSString *)value completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion {
-	NSString *arg = [NSString stringWithFormat:@"%@=%@", key, value];
+    NSString *arg = [NSString stringWithFormat:@"%@=%@", key, value];
 
-	[self sendCommand:TORCommandSetConf arguments:@[arg] data:nil observer:^BOOL(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL *stop) {
-		NSUInteger code = codes.firstObject.unsignedIntegerValue;
-		if (code != TORControlReplyCodeOK && code != TORControlReplyCodeBadAuthentication)
-			return NO;
-
-		NSString *message = lines.firstObject ? [[NSString alloc] initWithData:(NSData * _Nonnull)lines.firstObject encoding:NSUTF8StringEncoding] : @"";
-		NSDictionary<NSString *, NSString *> *userInfo = [NSDictionary dictionaryWithObjectsAndKeys:message, NSLocalizedDescriptionKey, nil];
-		BOOL success = (code == TORControlReplyCodeOK && [message isEqualToString:@"OK"]);
-		if (completion)
-			completion(success, success ? nil : [NSError errorWithDomain:TORControllerErrorDomain code:code userInfo:userInfo]);
-
-		*stop = YES;
-		return YES;
-	}];
+    [self sendBatchableCommand:TORCommandSetConf arguments:@[arg] keys:@[key] observer:[self observerWithCompletion:completion]];
 }
+
 - (void)setConfs:(NSArray<NSDictionary *> *)configs completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion {
     NSMutableArray *conf_arg = [[NSMutableArray alloc] init];
+    NSMutableArray *keys = [[NSMutableArray alloc] init];
     for (NSDictionary *config in configs) {
         NSString *key = [config objectForKey:@"key"];
         NSString *value = [config objectForKey:@"value"];
         NSString *arg = [NSString stringWithFormat:@"%@=%@", key, value];
         [conf_arg addObject:arg];
+        [keys addObject:[key description]];
     }
 
-    [self sendCommand:TORCommandSetConf arguments:conf_arg data:nil observer:^BOOL(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL *stop) {
-        NSUInteger code = codes.firstObject.unsignedIntegerValue;
-        if (code != TORControlReplyCodeOK && code != TORControlReplyCodeBadAuthentication)
-            return NO;
-        
-        NSString *message = lines.firstObject ? [[NSString alloc] initWithData:(NSData * _Nonnull)lines.firstObject encoding:NSUTF8StringEncoding] : @"";
-        NSDictionary<NSString *, NSString *> *userInfo = [NSDictionary dictionaryWithObjectsAndKeys:message, NSLocalizedDescriptionKey, nil];
-        BOOL success = (code == TORControlReplyCodeOK && [message isEqualToString:@"OK"]);
-        if (completion)
-            completion(success, success ? nil : [NSError errorWithDomain:TORControllerErrorDomain code:code userInfo:userInfo]);
-        
-        *stop = YES;
-        return YES;
-    }];
+    [self sendBatchableCommand:TORCommandSetConf arguments:conf_arg keys:keys observer:[self observerWithCompletion:completion]];
+}
+
+- (void)applyConfigurationDiff:(TORConfigurationDiff *)diff completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion {
+    NSArray<NSString *> *arguments = diff.setConfArguments;
+
+    if (arguments.count < 1) {
+        if (completion) {
+            dispatch_async(self.controlQueue, ^{
+                completion(YES, nil);
+            });
+        }
+
+        return;
+    }
+
+    // Not just the changed keys: A change to one onion service re-sends the options of all of them.
+    NSMutableArray<NSString *> *keys = [NSMutableArray new];
+
+    for (NSString *argument in arguments) {
+        NSRange range = [argument rangeOfString:@"="];
 
+        [keys addObject:range.location == NSNotFound ? argument : [argument substringToIndex:range.location]];
+    }
+
+    [self sendBatchableCommand:TORCommandSetConf arguments:arguments keys:keys observer:[self observerWithCompletion:completion]];
 }
 
 - (void)listenForEvents:(NSArray<NSString *> *)events completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion {
-    [self sendCommand:TORCommandSetEvents arguments:events data:nil observer:^BOOL(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL *stop) {
-        NSUInteger code = codes.firstObject.unsignedIntegerValue;
-        if (code != TORControlReplyCodeOK && code != TORControlReplyCodeUnrecognizedEntity)
-            return NO;
-
-        NSString *message = lines.firstObject ? [[NSString alloc] initWithData:(NSData * _Nonnull)lines.firstObject encoding:NSUTF8StringEncoding] : @"";
-        NSDictionary<NSString *, NSString *> *userInfo = [NSDictionary dictionaryWithObjectsAndKeys:message, NSLocalizedDescriptionKey, nil];
-        BOOL success = (code == TORControlReplyCodeOK && [message isEqualToString:@"OK"]);
-        if (success)
-            self->_events = [NSOrderedSet orderedSetWithArray:events];
-        if (completion)
-            completion(success, success ? nil : [NSError errorWithDomain:TORControllerErrorDomain code:code userInfo:userInfo]);
+    dispatch_async(self.controlQueue, ^{
+        self->_listenedEvents = [NSOrderedSet orderedSetWithArray:events];
         
-        *stop = YES;
-        return YES;
-    }];
+        [self updateEvents:completion];
+    });
 }
 
 - (void)getInfoForKeys:(NSArray<NSString *> *)keys completion:(void (^)(NSArray<NSString *> *values))completion
 {
-    NSData *ok = [NSData dataWithBytes:"OK" length:2];
+    if (!self.cachesInfo)
+    {
+        [self sendBatchableCommand:TORCommandGetInfo arguments:keys keys:keys
+                          observer:[self observerForInfoKeys:keys completion:completion]];
 
-    [self sendCommand:TORCommandGetInfo arguments:keys data:nil observer:^BOOL(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL *stop) {
-        *stop = YES;
+        return;
+    }
 
-        if (lines.count - 1 != keys.count || codes.count != lines.count)
+    dispatch_async(self.controlQueue, ^{
+        NSTimeInterval now = NSProcessInfo.processInfo.systemUptime;
+        NSMutableDictionary<NSString *, id> *info = [NSMutableDictionary new];
+        NSMutableArray<NSString *> *missing = [NSMutableArray new];
+
+        for (NSString *key in keys)
+        {
+            NSString *value = self->_infoCache[key];
+
+            if (value && self->_infoCacheExpiries[key].doubleValue > now)
+            {
+                info[key] = value;
+            }
+            else if (![missing containsObject:key])
+            {
+                [missing addObject:key];
+            }
+        }
+
+        self.infoCacheHits += keys.count - missing.count;
+        self.infoCacheMisses += missing.count;
+
+        if (missing.count < 1)
         {
             if (completion)
             {
-                completion(@[]);
+                completion([info objectsForKeys:keys notFoundMarker:NSNull.null]);
             }
 
-            return NO;
+            return;
         }
 
-        if (codes.lastObject.integerValue != TORControlReplyCodeOK || ![lines.lastObject isEqual:ok])
-        {
+        TORObserverBlock observer = [self observerForInfoKeys:missing completion:^(NSArray<NSString *> *values) {
+            if (values.count != missing.count)
+            {
+                if (completion)
+                {
+                    completion(@[]);
+                }
+
+                return;
+            }
+
+            NSTimeInterval now = NSProcessInfo.processInfo.systemUptime;
+
+            for (NSUInteger i = 0; i < missing.count; i++)
+            {
+                NSString *key = missing[i];
+                id value = values[i];
+
+                info[key] = value;
+
+                NSTimeInterval lifetime = [self infoCacheLifetimeForKey:key];
+
+                if (lifetime > 0 && [value isKindOfClass:NSString.class])
+                {
+                    self->_infoCache[key] = value;
+                    self->_infoCacheExpiries[key] = @(now + lifetime);
+                }
+            }
+
+            [self updateInfoCacheConsensusObserver];
+
             if (completion)
             {
-                completion(@[]);
+                completion([info objectsForKeys:keys notFoundMarker:NSNull.null]);
             }
+        }];
 
-            return NO;
+        [self enqueueBatchedCommand:[[TORBatchedCommand alloc] initWithCommand:TORCommandGetInfo arguments:missing
+                                                                          keys:missing observer:observer]];
+    });
+}
+
+- (TORControlRequest *)getInfoForKeys:(NSArray<NSString *> *)keys
+                              timeout:(NSTimeInterval)timeout
+                           completion:(void (^)(NSArray<NSString *> * __nullable values, NSError * __nullable error))completion
+{
+    return [self sendCommand:TORCommandGetInfo arguments:keys data:nil timeout:timeout
+                  completion:^(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, NSError *error)
+    {
+        if (error)
+        {
+            completion(nil, error);
+
+            return;
+        }
+
+        __block NSArray<NSString *> *values = @[];
+        BOOL stop = YES;
+
+        [self observerForInfoKeys:keys completion:^(NSArray<NSString *> *v) {
+            values = v;
+        }](codes, lines, &stop);
+
+        if (values.count != keys.count)
+        {
+            completion(nil, [self.class errorWithCodes:codes lines:lines]);
+
+            return;
+        }
+
+        completion(values, nil);
+    }];
+}
+
+- (BOOL)cachesInfo
+{
+    return _cachesInfo;
+}
+
+- (void)setCachesInfo:(BOOL)cachesInfo
+{
+    _cachesInfo = cachesInfo;
+
+    dispatch_async(self.controlQueue, ^{
+        if (cachesInfo && !self->_infoCacheObserver)
+        {
+            // NEWCONSENSUS comes every hour with a big data block. Only subscribed to, when needed.
+            NSMutableArray<NSString *> *events = [self.class.infoCacheInvalidations.allKeys mutableCopy];
+            [events removeObject:@"NEWCONSENSUS"];
+
+            self->_infoCacheObserver = [self addObserverForEvents:events block:[self infoCacheInvalidationObserver]];
+        }
+        else if (!cachesInfo && self->_infoCacheObserver)
+        {
+            [self removeObserver:self->_infoCacheObserver];
+            self->_infoCacheObserver = nil;
+
+            [self->_infoCache removeAllObjects];
+            [self->_infoCacheExpiries removeAllObjects];
+
+            [self updateInfoCacheConsensusObserver];
+        }
+    });
+}
+
+- (void)setInfoCacheLifetime:(NSTimeInterval)lifetime forKey:(NSString *)key
+{
+    dispatch_async(self.controlQueue, ^{
+        if (lifetime > 0)
+        {
+            self->_infoCacheLifetimes[key] = @(lifetime);
+        }
+        else {
+            [self->_infoCacheLifetimes removeObjectForKey:key];
+        }
+    });
+}
+
+- (void)clearInfoCache
+{
+    dispatch_async(self.controlQueue, ^{
+        [self->_infoCache removeAllObjects];
+        [self->_infoCacheExpiries removeAllObjects];
+    });
+}
+
+- (TORObserverBlock)observerForInfoKeys:(NSArray<NSString *> *)keys completion:(void (^)(NSArray<NSString *> *values))completion
+{
+    NSData *ok = [NSData dataWithBytes:"OK" length:2];
+
+    return ^BOOL(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL *stop) {
+        *stop = YES;
+
+        if (!completion)
+        {
+            return YES;
+        }
+
+        if (lines.count - 1 != keys.count || codes.count != lines.count)
+        {
+            completion(@[]);
+
+            return YES;
+        }
+
+        if (codes.lastObject.integerValue != TORControlReplyCodeOK || ![lines.lastObject isEqual:ok])
+        {
+            completion(@[]);
+
+            return YES;
         }
 
         NSMutableDictionary<NSString *, NSString *> *info = [NSMutableDictionary new];
@@ -563,7 +1045,7 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
                 {
                     completion(@[]);
 
-                    return NO;
+                    return YES;
                 }
 
                 NSRange pos = [string rangeOfString:@"="];
@@ -579,12 +1061,9 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
                                      stringByTrimmingCharactersInSet:NSCharacterSet.doubleQuote];
                     }
                     else {
-                        if (completion)
-                        {
-                            completion(@[]);
+                        completion(@[]);
 
-                            return NO;
-                        }
+                        return YES;
                     }
                 }
             }
@@ -597,13 +1076,10 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
             [values addObject:(info[key] ?: [NSNull null])];
         }
 
-        if (completion)
-        {
-            completion(values);
-        }
+        completion(values);
 
         return YES;
-    }];
+    };
 }
 
 - (void)getSessionConfiguration:(void (^)(NSURLSessionConfiguration * __nullable configuration))completion
@@ -646,103 +1122,132 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
                data:(nullable NSData *)data observer:(TORObserverBlock)observer
 {
     NSParameterAssert(command.length);
-    if (!_channel)
-    {
-        return;
-    }
-
-    if (arguments == nil)
-    {
-        arguments = @[];
-    }
 
-    NSString *argumentsString = [[@[command] arrayByAddingObjectsFromArray:(NSArray * _Nonnull)arguments]
-                                 componentsJoinedByString:@" "];
-    
-    NSMutableData *commandData = [NSMutableData new];
-    if (data.length)
-    {
-        [commandData appendBytes:"+" length:1];
-    }
-    [commandData appendData:(NSData * _Nonnull)[argumentsString dataUsingEncoding:NSUTF8StringEncoding]];
-    [commandData appendBytes:"\r\n" length:2];
+    dispatch_data_t dispatchData = [self.class dataForCommand:command arguments:arguments data:data];
 
-    if (data.length)
-    {
-        [commandData appendData:(NSData * _Nonnull)data];
-        [commandData appendBytes:"\r\n.\r\n" length:5];
-    }
-    
-    dispatch_data_t dispatchData = dispatch_data_create(commandData.bytes,
-                                                        commandData.length,
-                                                        [self.class controlQueue],
-                                                        DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+    // Enqueueing the observer and writing the command need to happen in one go on the
+    // control queue, so the queue order is guaranteed to be the order on the wire.
+    dispatch_async(self.controlQueue, ^{
+        // Anything collected for merging was called earlier, so it needs to go out first.
+        [self flushBatch];
 
-    dispatch_io_write(_channel, 0, dispatchData, [self.class controlQueue], ^(bool done, dispatch_data_t __unused data, int error) {
-        if (done && !error && observer) {
-            [self->_blocks insertObject:observer atIndex:0];
+        if (self->_cachesInfo && [command isEqualToString:TORCommandResetConf])
+        {
+            [self invalidateInfoCacheWithPrefixes:(NSArray * _Nonnull)self.class.infoCacheInvalidations[@"CONF_CHANGED"]];
         }
+
+        [self writeCommandData:dispatchData observer:observer];
     });
 }
 
-
-- (void)getCircuits:(void (^)(NSArray<TORCircuit *> * _Nonnull circuits))completion
+- (TORControlRequest *)sendCommand:(NSString *)command
+                         arguments:(nullable NSArray<NSString *> *)arguments
+                              data:(nullable NSData *)data
+                           timeout:(NSTimeInterval)timeout
+                        completion:(nullable TORRequestCompletion)completion
 {
-    [self getInfoForKeys:@[@"circuit-status"] completion:^(NSArray<NSString *> * _Nonnull values) {
-        if (values.count < 1)
-        {
-            if (completion)
-            {
-                completion(@[]);
-            }
+    NSParameterAssert(command.length);
 
-            return;
-        }
+    TORControlRequest *request = [[TORControlRequest alloc] initWithCommand:command queue:self.controlQueue completion:completion];
 
-        NSArray<TORCircuit *> *circuits = [TORCircuit circuitsFromString:(NSString * _Nonnull)values.firstObject];
+    [self sendRequest:request data:[self.class dataForCommand:command arguments:arguments data:data] timeout:timeout sink:nil];
 
-        NSMutableArray<NSString *> *ipResolveCalls = [NSMutableArray new];
-        NSMutableArray<TORNode *> *map = [NSMutableArray new];
+    return request;
+}
 
-        for (TORCircuit *circuit in circuits)
+- (TORControlRequest *)getInfoForKey:(NSString *)key
+                         streamingTo:(TORControlDataSink)sink
+                          completion:(void (^__nullable)(NSError * __nullable error))completion
+{
+    NSParameterAssert(key.length && sink);
+
+    NSData *opening = [[key stringByAppendingString:@"="] dataUsingEncoding:NSUTF8StringEncoding];
+
+    TORControlRequest *request = [[TORControlRequest alloc] initWithCommand:TORCommandGetInfo queue:self.controlQueue
+                                                                 completion:^(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, NSError *error)
+    {
+        if (!error && codes.lastObject.integerValue != TORControlReplyCodeOK)
         {
-            for (TORNode *node in circuit.nodes)
-            {
-                [ipResolveCalls addObject:[NSString stringWithFormat:@"ns/id/%@", node.fingerprint]];
-                [map addObject:node];
-            }
+            error = [self.class errorWithCodes:codes lines:lines];
         }
 
-        [self getInfoForKeys:ipResolveCalls completion:^(NSArray<NSString *> * _Nonnull values) {
-            for (NSUInteger i = 0; i < values.count; i++) {
-                [map[i] acquireIpAddressesFromNsResponse:values[i]];
-            }
+        // A short value comes on the line of the key, not in a data block. Hand it over as one line.
+        NSData *line = lines.firstObject;
 
-            NSMutableArray<TORNode *> *nodes = [NSMutableArray new];
+        if (!error && line.length > opening.length && ![line isEqual:opening])
+        {
+            NSMutableData *value = [[line subdataWithRange:NSMakeRange(opening.length, line.length - opening.length)] mutableCopy];
+            [value appendBytes:"\r\n" length:2];
 
-            for (TORCircuit *circuit in circuits)
-            {
-                [nodes addObjectsFromArray:circuit.nodes];
-            }
+            sink(dispatch_data_create(value.bytes, value.length, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT));
+        }
 
-            [self resolveCountriesOfNodes:nodes testCapabilities:YES completion:^{
-                if (completion)
-                {
-                    completion(circuits);
-                }
-            }];
-        }];
+        if (completion)
+        {
+            completion(error);
+        }
+    }];
+
+    [self sendRequest:request data:[self.class dataForCommand:TORCommandGetInfo arguments:@[key] data:nil] timeout:0
+                 sink:^TORControlDataSink _Nullable(NSData *line) {
+        if (![line isEqual:opening])
+        {
+            return nil;
+        }
+
+        return ^BOOL(dispatch_data_t lines) {
+            // Cancelled: Drop the rest.
+            return !request.finished && sink(lines);
+        };
     }];
+
+    return request;
 }
 
-- (void)resetConnection:(void (^__nullable)(BOOL success))completion
+- (void)performBatch:(void (NS_NOESCAPE ^)(void))block
 {
-    [self sendCommand:TORCommandSignalReload arguments:nil data:nil observer:
-     ^BOOL(NSArray<NSNumber *> * _Nonnull codes, NSArray<NSData *> * _Nonnull __unused lines, BOOL * _Nonnull stop) {
+    dispatch_async(self.controlQueue, ^{
+        self->_batchDepth++;
+    });
 
-        if (codes.firstObject.integerValue == TORControlReplyCodeOK)
+    block();
+
+    dispatch_async(self.controlQueue, ^{
+        if (--self->_batchDepth == 0)
         {
-            [self sendCommand:TORCommandSignalNewnym arguments:nil data:nil observer:
+            [self flushBatch];
+        }
+    });
+}
+
+- (void)getCircuits:(void (^)(NSArray<TORCircuit *> * _Nonnull circuits))completion
+{
+    dispatch_async(self.controlQueue, ^{
+        [self trackCircuits];
+
+        if (self->_circuitsSeeded && self->_circuitEnrichments == 0)
+        {
+            if (completion)
+            {
+                completion([self circuitsSnapshot]);
+            }
+
+            return;
+        }
+
+        // Answered, as soon as the table is seeded and all nodes are enriched.
+        [self->_circuitWaiters addObject:completion ?: ^(NSArray<TORCircuit *> * __unused circuits) {}];
+    });
+}
+
+- (void)resetConnection:(void (^__nullable)(BOOL success))completion
+{
+    [self sendCommand:TORCommandSignalReload arguments:nil data:nil observer:
+     ^BOOL(NSArray<NSNumber *> * _Nonnull codes, NSArray<NSData *> * _Nonnull __unused lines, BOOL * _Nonnull stop) {
+
+        if (codes.firstObject.integerValue == TORControlReplyCodeOK)
+        {
+            [self sendCommand:TORCommandSignalNewnym arguments:nil data:nil observer:
              ^BOOL(NSArray<NSNumber *> * _Nonnull codes, NSArray<NSData *> * _Nonnull __unused lines, BOOL * _Nonnull stop) {
 
                 if (completion)
@@ -768,46 +1273,44 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
 
 - (void)closeCircuitsByIds:(NSArray<NSString *> *)circuitIds completion:(void (^__nullable)(BOOL success))completion
 {
-    long queueId;
+    if (circuitIds.count < 1)
+    {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion)
+            {
+                completion(YES);
+            }
+        });
 
-    if (@available(macOS 10.10, *)) {
-        queueId = QOS_CLASS_USER_INITIATED;
-    }
-    else {
-        queueId = DISPATCH_QUEUE_PRIORITY_HIGH;
+        return;
     }
 
-    dispatch_async(dispatch_get_global_queue(queueId, 0), ^{
-        __block BOOL success = YES;
-
-        dispatch_group_t group = dispatch_group_create();
-
-        for (NSString *circuitId in circuitIds)
-        {
-            dispatch_group_enter(group);
-
-            [self sendCommand:TORCommandCloseCircuit arguments:@[circuitId] data:nil observer:
-             ^BOOL(NSArray<NSNumber *> * _Nonnull codes, NSArray<NSData *> * _Nonnull __unused lines, BOOL * _Nonnull stop) {
-
-                success = success && codes.firstObject.integerValue == TORControlReplyCodeOK;
-
-                // Need to deparallelize to not mix up responses.
-                dispatch_group_leave(group);
+    // All commands are pipelined. Replies arrive in order on the control queue,
+    // so these don't need any synchronization.
+    __block BOOL success = YES;
+    __block NSUInteger remaining = circuitIds.count;
 
-                *stop = YES;
-                return YES;
-            }];
-        }
+    for (NSString *circuitId in circuitIds)
+    {
+        [self sendCommand:TORCommandCloseCircuit arguments:@[circuitId] data:nil observer:
+         ^BOOL(NSArray<NSNumber *> * _Nonnull codes, NSArray<NSData *> * _Nonnull __unused lines, BOOL * _Nonnull stop) {
 
-        dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 10000000000)); // Wait 10 seconds.
+            success = success && codes.firstObject.integerValue == TORControlReplyCodeOK;
 
-        dispatch_async(dispatch_get_main_queue(), ^{
-            if (completion)
+            if (--remaining == 0)
             {
-                completion(success);
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    if (completion)
+                    {
+                        completion(success);
+                    }
+                });
             }
-        });
-    });
+
+            *stop = YES;
+            return YES;
+        }];
+    }
 }
 
 - (void)closeCircuits:(NSArray<TORCircuit *> *)circuits completion:(void (^__nullable)(BOOL success))completion
@@ -827,37 +1330,68 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
 
 - (void)resolveCountriesOfNodes:(NSArray<TORNode *> * _Nullable)nodes testCapabilities:(BOOL)testCapabilities completion:(void (^__nullable)(void))completion
 {
-    BOOL __block ipv4Available = YES;
-    BOOL __block ipv6Available = YES;
+    TORGeoIPDatabase *database = self.geoIpDatabase;
 
-    if (testCapabilities)
+    if (database)
     {
-        dispatch_group_t group = dispatch_group_create();
-        dispatch_group_enter(group);
+        // Called on the control queue, like when Tor is asked.
+        dispatch_async(self.controlQueue, ^{
+            [database resolveCountriesOfNodes:nodes ?: @[]];
 
-        [self getInfoForKeys:@[@"ip-to-country/ipv4-available", @"ip-to-country/ipv6-available"] completion:^(NSArray<NSString *> * _Nonnull values) {
+            if (completion)
+            {
+                completion();
+            }
+        });
 
-            ipv4Available = [values.firstObject isEqualToString:@"1"];
-            ipv6Available = [values.lastObject isEqualToString:@"1"];
+        return;
+    }
 
-            dispatch_group_leave(group);
-        }];
+    if (!testCapabilities)
+    {
+        [self resolveCountriesOfNodes:nodes ipv4Available:YES ipv6Available:YES completion:completion];
 
-        dispatch_group_wait(group, dispatch_time(DISPATCH_TIME_NOW, 1000000000)); // Wait 1 second.
+        return;
     }
 
-    if (!ipv4Available && !ipv6Available)
-    {
+    __block BOOL ipv4Available = NO;
+    __block BOOL ipv6Available = NO;
+
+    [self getInfoForKeys:@[@"ip-to-country/ipv4-available", @"ip-to-country/ipv6-available"] completion:^(NSArray<NSString *> * _Nonnull values) {
+        ipv4Available = [values.firstObject isEqual:@"1"];
+        ipv6Available = [values.lastObject isEqual:@"1"];
+    }];
+
+    // The lookups are sent right behind the check, so it doesn't cost an extra round trip.
+    // Lookups of an address family Tor has no GeoIP data for fail on their own and are dropped.
+    [self resolveCountriesOfNodes:nodes ipv4Available:YES ipv6Available:YES completion:^{
+        // Nodes are looked up by their IPv4 address first. Only without IPv4 GeoIP data,
+        // their IPv6 address needs another try.
+        if (!ipv4Available && ipv6Available)
+        {
+            [self resolveCountriesOfNodes:nodes ipv4Available:NO ipv6Available:YES completion:completion];
+
+            return;
+        }
+
         if (completion)
         {
             completion();
         }
+    }];
+}
 
-        return;
-    }
+/**
+ Sends one @c GETINFO per address family, as Tor fails the whole command, if it has no GeoIP data for one of them.
 
-    NSMutableArray<NSString *> *geoipResolveCalls = [NSMutableArray new];
-    NSMutableArray<TORNode *> *map = [NSMutableArray new];
+ @param completion Called on the control queue, when all lookups are done.
+ */
+- (void)resolveCountriesOfNodes:(NSArray<TORNode *> * _Nullable)nodes ipv4Available:(BOOL)ipv4Available ipv6Available:(BOOL)ipv6Available completion:(void (^__nullable)(void))completion
+{
+    NSMutableArray<NSString *> *ipv4Calls = [NSMutableArray new];
+    NSMutableArray<TORNode *> *ipv4Map = [NSMutableArray new];
+    NSMutableArray<NSString *> *ipv6Calls = [NSMutableArray new];
+    NSMutableArray<TORNode *> *ipv6Map = [NSMutableArray new];
 
     for (TORNode *node in nodes)
     {
@@ -868,37 +1402,1138 @@ static NSString * const TORControllerEndReplyLineSeparator = @" ";
 
         if (ipv4Available && node.ipv4Address.length)
         {
-            [geoipResolveCalls addObject:[NSString stringWithFormat:@"ip-to-country/%@", node.ipv4Address]];
-            [map addObject:node];
+            [ipv4Calls addObject:[NSString stringWithFormat:@"ip-to-country/%@", node.ipv4Address]];
+            [ipv4Map addObject:node];
         }
         else if (ipv6Available && node.ipv6Address.length)
         {
-            [geoipResolveCalls addObject:[NSString stringWithFormat:@"ip-to-country/%@", node.ipv6Address]];
-            [map addObject:node];
+            [ipv6Calls addObject:[NSString stringWithFormat:@"ip-to-country/%@", node.ipv6Address]];
+            [ipv6Map addObject:node];
         }
     }
 
-    if (geoipResolveCalls.count < 1)
+    __block NSUInteger remaining = (ipv4Calls.count > 0) + (ipv6Calls.count > 0);
+
+    if (remaining < 1)
     {
         if (completion)
         {
-            completion();
+            dispatch_async(self.controlQueue, completion);
         }
 
         return;
     }
 
-    [self getInfoForKeys:geoipResolveCalls completion:^(NSArray<NSString *> * _Nonnull values) {
-        for (NSUInteger i = 0; i < values.count; i++)
+    void (^lookup)(NSArray<NSString *> *, NSArray<TORNode *> *) = ^(NSArray<NSString *> *calls, NSArray<TORNode *> *map) {
+        if (calls.count < 1)
+        {
+            return;
+        }
+
+        [self getInfoForKeys:calls completion:^(NSArray<NSString *> * _Nonnull values) {
+            for (NSUInteger i = 0; i < values.count; i++)
+            {
+                if ([values[i] isKindOfClass:NSString.class])
+                {
+                    map[i].countryCode = values[i];
+                }
+            }
+
+            if (--remaining == 0 && completion)
+            {
+                completion();
+            }
+        }];
+    };
+
+    lookup(ipv4Calls, ipv4Map);
+    lookup(ipv6Calls, ipv6Map);
+}
+
+#pragma mark - Info Cache
+
+/**
+ Keys and key prefixes (ending in "/") cached by default and for how long. Events invalidate them earlier.
+ */
++ (NSMutableDictionary<NSString *, NSNumber *> *)defaultInfoCacheLifetimes
+{
+    return [@{
+        @"version": @(24 * 60 * 60),
+        @"net/listeners/": @(10 * 60),
+        @"ip-to-country/": @(60 * 60),
+        @"status/circuit-established": @(60),
+        @"ns/id/": @(60 * 60),
+    } mutableCopy];
+}
+
+/**
+ Which events invalidate which key prefixes.
+ */
++ (NSDictionary<NSString *, NSArray<NSString *> *> *)infoCacheInvalidations
+{
+    static NSDictionary<NSString *, NSArray<NSString *> *> *invalidations;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        invalidations = @{
+            @"CONF_CHANGED": @[@"net/listeners/", @"ip-to-country/", @"config"],
+            @"NEWCONSENSUS": @[@"ns/"],
+            @"NETWORK_LIVENESS": @[@"status/", @"network-liveness"],
+            @"STATUS_CLIENT": @[@"status/"],
+        };
+    });
+
+    return invalidations;
+}
+
+- (NSTimeInterval)infoCacheLifetimeForKey:(NSString *)key
+{
+    NSNumber *lifetime = _infoCacheLifetimes[key];
+
+    if (lifetime)
+    {
+        return lifetime.doubleValue;
+    }
+
+    NSString *longest;
+
+    for (NSString *prefix in _infoCacheLifetimes)
+    {
+        if ([prefix hasSuffix:@"/"] && [key hasPrefix:prefix] && prefix.length > longest.length)
+        {
+            longest = prefix;
+        }
+    }
+
+    return longest ? _infoCacheLifetimes[longest].doubleValue : 0;
+}
+
+- (void)invalidateInfoCacheForEvent:(nullable NSData *)line
+{
+    if (!line.length)
+    {
+        return;
+    }
+
+    NSString *event = [self.class keywordOfEvent:line];
+
+    NSArray<NSString *> *prefixes = event ? self.class.infoCacheInvalidations[(NSString * _Nonnull)event] : nil;
+
+    if (prefixes)
+    {
+        [self invalidateInfoCacheWithPrefixes:(NSArray * _Nonnull)prefixes];
+    }
+}
+
+- (void)invalidateInfoCacheWithPrefixes:(NSArray<NSString *> *)prefixes
+{
+    for (NSString *key in _infoCache.allKeys)
+    {
+        for (NSString *prefix in prefixes)
+        {
+            if ([key hasPrefix:prefix])
+            {
+                [_infoCache removeObjectForKey:key];
+                [_infoCacheExpiries removeObjectForKey:key];
+
+                break;
+            }
+        }
+    }
+
+    [self updateInfoCacheConsensusObserver];
+}
+
+- (TORObserverBlock)infoCacheInvalidationObserver
+{
+    __weak TORController *weakSelf = self;
+
+    return ^BOOL(NSArray<NSNumber *> * __unused codes, NSArray<NSData *> *lines, BOOL * __unused stop) {
+        [weakSelf invalidateInfoCacheForEvent:lines.firstObject];
+
+        return YES;
+    };
+}
+
+/**
+ Subscribe to NEWCONSENSUS, while an "ns/" key is cached, and unsubscribe, when none is left.
+
+ Needs to be called on the control queue.
+ */
+- (void)updateInfoCacheConsensusObserver
+{
+    BOOL needed = NO;
+
+    for (NSString *key in _infoCache)
+    {
+        if ([key hasPrefix:@"ns/"])
+        {
+            needed = YES;
+            break;
+        }
+    }
+
+    if (needed && !_infoCacheConsensusObserver)
+    {
+        _infoCacheConsensusObserver = [self addObserverForEvents:@[@"NEWCONSENSUS"] block:[self infoCacheInvalidationObserver]];
+    }
+    else if (!needed && _infoCacheConsensusObserver)
+    {
+        [self removeObserver:_infoCacheConsensusObserver];
+        _infoCacheConsensusObserver = nil;
+    }
+}
+
+
+#pragma mark - Relay Index
+
+- (void)loadRelayIndex:(void (^__nullable)(TORRelayIndex * __nullable relayIndex))completion
+{
+    void (^loaded)(TORRelayIndex * _Nullable relayIndex) = ^(TORRelayIndex * _Nullable relayIndex) {
+        if (relayIndex)
         {
-            map[i].countryCode = values[i];
+            self.relayIndex = relayIndex;
+
+            [self keepRelayIndexUpdated];
         }
 
         if (completion)
         {
-            completion();
+            completion(relayIndex);
+        }
+    };
+
+    void (^provider)(void (^completion)(TORRelayIndex * _Nullable relayIndex)) = self.relayIndexProvider;
+
+    if (!provider)
+    {
+        [self fetchRelayIndex:loaded];
+
+        return;
+    }
+
+    provider(^(TORRelayIndex * _Nullable relayIndex) {
+        dispatch_async(self.controlQueue, ^{
+            loaded(relayIndex);
+        });
+    });
+}
+
+- (void)fetchRelayIndex:(void (^)(TORRelayIndex * _Nullable relayIndex))completion
+{
+    // Parsed while it is read, so the consensus is never held in memory as a whole.
+    TORRelayIndex *relayIndex = [TORRelayIndex new];
+
+    [self getInfoForKey:@"ns/all" streamingTo:[TORController sinkForRelayIndex:relayIndex] completion:^(NSError * _Nullable error) {
+        if (!error)
+        {
+            [relayIndex finish];
         }
+
+        completion(error ? nil : relayIndex);
+    }];
+}
+
+/**
+ Needs to be called on the control queue.
+ */
+- (void)keepRelayIndexUpdated
+{
+    if (_relayIndexObserver)
+    {
+        return;
+    }
+
+    __weak TORController *weakSelf = self;
+
+    // Tor hands out the complete new network status with this event, so the relay index
+    // can be replaced without another round trip.
+    _relayIndexObserver = [self addObserverForEvents:@[@"NEWCONSENSUS"] block:
+                           ^BOOL(NSArray<NSNumber *> * __unused codes, NSArray<NSData *> *lines, BOOL * __unused stop) {
+        [weakSelf updateRelayIndexFromEvent:(NSData * _Nonnull)lines.firstObject];
+
+        return YES;
+    }];
+}
+
+/**
+ Needs to be called on the control queue.
+ */
+- (void)updateRelayIndexFromEvent:(NSData *)line
+{
+    TORRelayIndex *relayIndex = _nextRelayIndex;
+    _nextRelayIndex = nil;
+
+    if (relayIndex)
+    {
+        [relayIndex finish];
+    }
+    else if (self.relayIndexProvider)
+    {
+        [self loadRelayIndex:nil];
+
+        return;
+    }
+    else {
+        // Another observer needed the data block, so it was collected instead.
+        relayIndex = [TORController relayIndexFromData:line];
+    }
+
+    self.relayIndex = relayIndex;
+}
+
+/**
+ A data sink, which feeds everything read straight into the given relay index.
+ */
++ (TORControlDataSink)sinkForRelayIndex:(TORRelayIndex *)relayIndex
+{
+    return ^BOOL(dispatch_data_t lines) {
+        dispatch_data_apply(lines, ^bool(dispatch_data_t __unused region, size_t __unused offset, const void *bytes, size_t size) {
+            [relayIndex parseBytes:bytes length:size];
+
+            return true;
+        });
+
+        return YES;
+    };
+}
+
+/**
+ Builds a relay index directly from the regions of a data block, without creating a string first.
+ Leading lines like "ns/all=" or "NEWCONSENSUS" are ignored by the index.
+ */
++ (TORRelayIndex *)relayIndexFromData:(NSData *)data
+{
+    TORRelayIndex *relayIndex = [TORRelayIndex new];
+
+    [data enumerateByteRangesUsingBlock:^(const void * _Nonnull bytes, NSRange byteRange, BOOL * _Nonnull __unused stop) {
+        [relayIndex parseBytes:bytes length:byteRange.length];
     }];
+
+    [relayIndex finish];
+
+    return relayIndex;
+}
+
+#pragma mark - Circuit Table
+
+/**
+ Start maintaining the live circuit table, if not done, yet.
+
+ The table is seeded once with "GETINFO circuit-status" and then kept up to date from
+ CIRC and CIRC_MINOR events. Only nodes which weren't seen before cost a round trip to
+ look up their addresses and countries.
+
+ Needs to be called on the control queue.
+ */
+- (void)trackCircuits
+{
+    if (!_circuits)
+    {
+        _circuits = [NSMutableDictionary new];
+        _circuitNodes = [NSMutableDictionary new];
+        _circuitChanges = [NSMutableArray new];
+        _circuitWaiters = [NSMutableArray new];
+
+        __weak TORController *weakSelf = self;
+
+        // The subscription is sent before the seed request, so no change can get lost in between.
+        [self addObserverForEvents:@[@"CIRC", @"CIRC_MINOR"] block:
+         ^BOOL(NSArray<NSNumber *> * __unused codes, NSArray<NSData *> *lines, BOOL * __unused stop) {
+            [weakSelf updateCircuitFromEvent:(NSData * _Nonnull)lines.firstObject];
+
+            return YES;
+        }];
+    }
+
+    if (!_circuitsSeeded)
+    {
+        [self seedCircuits];
+    }
+}
+
+/**
+ Needs to be called on the control queue.
+ */
+- (void)seedCircuits
+{
+    if (_circuitsSeeding)
+    {
+        return;
+    }
+
+    _circuitsSeeding = YES;
+
+    // The whole consensus is never loaded here: Nodes are filled from the relay index, if one
+    // was loaded with -loadRelayIndex: or by the relayIndexProvider, and looked up one by one otherwise.
+    // The GeoIP capabilities come with the same reply, so countries can be resolved right away.
+    [self getInfoForKeys:@[@"circuit-status", @"ip-to-country/ipv4-available", @"ip-to-country/ipv6-available"]
+              completion:^(NSArray<NSString *> * _Nonnull values) {
+        self->_circuitsSeeding = NO;
+
+        if (values.count < 1 || ![values.firstObject isKindOfClass:NSString.class])
+        {
+            // Probably not authenticated, yet. Seeding is retried after authentication
+            // or with the next request.
+            NSArray<void (^)(NSArray<TORCircuit *> *circuits)> *waiters = self->_circuitWaiters;
+            self->_circuitWaiters = [NSMutableArray new];
+
+            for (void (^waiter)(NSArray<TORCircuit *> *circuits) in waiters)
+            {
+                waiter(@[]);
+            }
+
+            return;
+        }
+
+        if (values.count > 2)
+        {
+            self->_ipv4Available = [values[1] isEqual:@"1"];
+            self->_ipv6Available = [values[2] isEqual:@"1"];
+        }
+
+        // The seed is newer than any event received so far, so it replaces the table.
+        [self->_circuits removeAllObjects];
+        [self->_circuitChanges removeAllObjects];
+        self->_circuitsSeeded = YES;
+
+        NSArray<TORCircuit *> *circuits = [TORCircuit circuitsFromString:values.firstObject];
+
+        for (TORCircuit *circuit in circuits)
+        {
+            if (circuit.circuitId)
+            {
+                self->_circuits[(NSString * _Nonnull)circuit.circuitId] = circuit;
+            }
+        }
+
+        [self recordCircuitChanges:circuits];
+    }];
+
+    // Costs this connection nothing, as it is loaded elsewhere. Nodes already in the table
+    // keep what they got from "ns/id/".
+    if (!self.relayIndex && self.relayIndexProvider)
+    {
+        [self loadRelayIndex:nil];
+    }
+}
+
+/**
+ Needs to be called on the control queue.
+ */
+- (void)updateCircuitFromEvent:(NSData *)line
+{
+    NSString *event = [[NSString alloc] initWithData:line encoding:NSUTF8StringEncoding];
+
+    TORCircuit *circuit;
+
+    if ([event hasPrefix:@"CIRC_MINOR "])
+    {
+        // "CIRC_MINOR <id> <PURPOSE_CHANGED|CANNIBALIZED> ..." doesn't change the status,
+        // so parse it with the status we already know.
+        NSArray<NSString *> *components = [[event substringFromIndex:11] componentsSeparatedByString:@" "];
+
+        TORCircuit *known = components.count > 1 ? _circuits[components[0]] : nil;
+
+        if (!known.status)
+        {
+            return;
+        }
+
+        NSMutableArray<NSString *> *fixed = [components mutableCopy];
+        fixed[1] = (NSString * _Nonnull)known.status;
+
+        circuit = [[TORCircuit alloc] initFromString:[fixed componentsJoinedByString:@" "]];
+    }
+    else if ([event hasPrefix:@"CIRC "])
+    {
+        circuit = [[TORCircuit alloc] initFromString:[event substringFromIndex:5]];
+    }
+
+    if (!circuit.circuitId)
+    {
+        return;
+    }
+
+    if ([circuit.status isEqualToString:TORCircuit.statusClosed]
+        || [circuit.status isEqualToString:TORCircuit.statusFailed])
+    {
+        [_circuits removeObjectForKey:(NSString * _Nonnull)circuit.circuitId];
+    }
+    else {
+        _circuits[(NSString * _Nonnull)circuit.circuitId] = circuit;
+    }
+
+    [self recordCircuitChanges:@[circuit]];
+}
+
+/**
+ Queue changed circuits for notification and look up nodes, which weren't seen before.
+
+ Needs to be called on the control queue.
+ */
+- (void)recordCircuitChanges:(NSArray<TORCircuit *> *)circuits
+{
+    NSMutableArray<TORNode *> *newNodes = [NSMutableArray new];
+    NSMutableArray<TORNode *> *unknownNodes = [NSMutableArray new];
+    TORRelayIndex *relayIndex = self.relayIndex;
+
+    for (TORCircuit *circuit in circuits)
+    {
+        for (TORNode *node in circuit.nodes)
+        {
+            if (node.fingerprint && !_circuitNodes[(NSString * _Nonnull)node.fingerprint])
+            {
+                _circuitNodes[(NSString * _Nonnull)node.fingerprint] = node;
+                [newNodes addObject:node];
+
+                // Only nodes missing in the relay index need a round trip.
+                if (![relayIndex fillNode:node])
+                {
+                    [unknownNodes addObject:node];
+                }
+            }
+        }
+    }
+
+    [_circuitChanges addObjectsFromArray:circuits];
+
+    if (newNodes.count < 1)
+    {
+        [self flushCircuitChanges];
+
+        return;
+    }
+
+    // Changes are only announced after enrichment, so they stay in order.
+    _circuitEnrichments++;
+
+    void (^resolveCountries)(void) = ^{
+        void (^done)(void) = ^{
+            self->_circuitEnrichments--;
+
+            [self flushCircuitChanges];
+        };
+
+        if (!self.geoIpDatabase && !self->_ipv4Available && !self->_ipv6Available)
+        {
+            done();
+
+            return;
+        }
+
+        [self resolveCountriesOfNodes:newNodes testCapabilities:NO completion:done];
+    };
+
+    if (unknownNodes.count < 1)
+    {
+        resolveCountries();
+
+        return;
+    }
+
+    NSMutableArray<NSString *> *keys = [NSMutableArray new];
+
+    for (TORNode *node in unknownNodes)
+    {
+        [keys addObject:[NSString stringWithFormat:@"ns/id/%@", node.fingerprint]];
+    }
+
+    [self getInfoForKeys:keys completion:^(NSArray<NSString *> * _Nonnull values) {
+        for (NSUInteger i = 0; i < values.count; i++)
+        {
+            if ([values[i] isKindOfClass:NSString.class])
+            {
+                [unknownNodes[i] acquireIpAddressesFromNsResponse:values[i]];
+            }
+        }
+
+        resolveCountries();
+    }];
+}
+
+/**
+ Notify observers and waiters, unless there are enrichments in flight.
+
+ Needs to be called on the control queue.
+ */
+- (void)flushCircuitChanges
+{
+    if (_circuitEnrichments > 0 || !_circuitsSeeded)
+    {
+        return;
+    }
+
+    NSArray<TORCircuit *> *changes = _circuitChanges;
+    _circuitChanges = [NSMutableArray new];
+
+    // Circuits re-using a node get fresh node objects with every event.
+    // Fill in what we learned about them before.
+    for (TORCircuit *circuit in changes)
+    {
+        for (TORNode *node in circuit.nodes)
+        {
+            TORNode *known = node.fingerprint ? _circuitNodes[(NSString * _Nonnull)node.fingerprint] : nil;
+
+            if (!known || known == node)
+            {
+                continue;
+            }
+
+            node.ipv4Address = node.ipv4Address ?: known.ipv4Address;
+            node.ipv6Address = node.ipv6Address ?: known.ipv6Address;
+            node.countryCode = node.countryCode ?: known.countryCode;
+        }
+    }
+
+    NSArray<TORCircuit *> *circuits = [self circuitsSnapshot];
+
+    // Forget about nodes, which aren't used anymore, once in a while.
+    if (_circuitNodes.count > 128 + 4 * circuits.count)
+    {
+        NSMutableDictionary<NSString *, TORNode *> *nodes = [NSMutableDictionary new];
+
+        for (TORCircuit *circuit in circuits)
+        {
+            for (TORNode *node in circuit.nodes)
+            {
+                if (node.fingerprint)
+                {
+                    nodes[(NSString * _Nonnull)node.fingerprint] = _circuitNodes[(NSString * _Nonnull)node.fingerprint] ?: node;
+                }
+            }
+        }
+
+        _circuitNodes = nodes;
+    }
+
+    if (changes.count > 0)
+    {
+        for (void (^observer)(NSArray<TORCircuit *> *, NSArray<TORCircuit *> *) in [_circuitObservers copy])
+        {
+            observer(changes, circuits);
+        }
+    }
+
+    NSArray<void (^)(NSArray<TORCircuit *> *circuits)> *waiters = _circuitWaiters;
+    _circuitWaiters = [NSMutableArray new];
+
+    for (void (^waiter)(NSArray<TORCircuit *> *circuits) in waiters)
+    {
+        waiter(circuits);
+    }
+}
+
+/**
+ Needs to be called on the control queue.
+ */
+- (NSArray<TORCircuit *> *)circuitsSnapshot
+{
+    return [_circuits.allValues sortedArrayUsingComparator:^NSComparisonResult(TORCircuit *c1, TORCircuit *c2) {
+        return [(NSString * _Nonnull)c1.circuitId compare:(NSString * _Nonnull)c2.circuitId options:NSNumericSearch];
+    }];
+}
+
+#pragma mark - Private Methods
+
++ (dispatch_data_t)dataForCommand:(NSString *)command
+                        arguments:(nullable NSArray<NSString *> *)arguments
+                             data:(nullable NSData *)data
+{
+    if (arguments == nil)
+    {
+        arguments = @[];
+    }
+
+    NSString *argumentsString = [[@[command] arrayByAddingObjectsFromArray:(NSArray * _Nonnull)arguments]
+                                 componentsJoinedByString:@" "];
+
+    NSMutableData *commandData = [NSMutableData new];
+    if (data.length)
+    {
+        [commandData appendBytes:"+" length:1];
+    }
+    [commandData appendData:(NSData * _Nonnull)[argumentsString dataUsingEncoding:NSUTF8StringEncoding]];
+    [commandData appendBytes:"\r\n" length:2];
+
+    if (data.length)
+    {
+        [commandData appendData:(NSData * _Nonnull)data];
+        [commandData appendBytes:"\r\n.\r\n" length:5];
+    }
+
+    // The default destructor copies the bytes right away, so no queue is needed.
+    return dispatch_data_create(commandData.bytes, commandData.length, NULL, DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+}
+
+/**
+ Writes the command of a request on the control queue and finishes the request with the reply.
+
+ @param sinkForLine Asked for a sink, when a data block starts in the reply.
+ */
+- (void)sendRequest:(TORControlRequest *)request
+               data:(dispatch_data_t)dispatchData
+            timeout:(NSTimeInterval)timeout
+               sink:(nullable TORControlDataSink _Nullable (^)(NSData *line))sinkForLine
+{
+    dispatch_async(self.controlQueue, ^{
+        [self flushBatch];
+
+        // Cancelled before it got here: Don't send it at all.
+        if (request.finished)
+        {
+            return;
+        }
+
+        if (!self->_channel)
+        {
+            [request finishWithCodes:@[] lines:@[] error:[self.class errorWithCode:TORControllerErrorNotConnected
+                                                                      description:@"Not connected to Tor."]];
+
+            return;
+        }
+
+        if (self->_cachesInfo && [request.command isEqualToString:TORCommandResetConf])
+        {
+            [self invalidateInfoCacheWithPrefixes:(NSArray * _Nonnull)self.class.infoCacheInvalidations[@"CONF_CHANGED"]];
+        }
+
+        // The observer stays in line, even if the request finishes early, so later replies still match.
+        TORObserverBlock observer = ^BOOL(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL *stop) {
+            *stop = YES;
+
+            if (codes.count < 1 && !self->_channel)
+            {
+                [request finishWithCodes:@[] lines:@[] error:[self.class errorWithCode:TORControllerErrorDisconnected
+                                                                          description:@"Connection to Tor lost."]];
+            }
+            else if (codes.count < 1)
+            {
+                [request finishWithCodes:@[] lines:@[] error:[self.class errorWithCode:TORControllerErrorWriteFailed
+                                                                          description:@"Command couldn't be sent."]];
+            }
+            else {
+                [request finishWithCodes:codes lines:lines error:nil];
+            }
+
+            return YES;
+        };
+
+        if (sinkForLine)
+        {
+            [self->_dataSinks setObject:sinkForLine forKey:observer];
+        }
+
+        [self writeCommandData:dispatchData observer:observer];
+
+        [request timeoutAfter:timeout];
+    });
+}
+
+/**
+ Needs to be called on the control queue.
+ */
+- (void)writeCommandData:(dispatch_data_t)dispatchData observer:(nullable TORObserverBlock)observer
+{
+    [self writeCommandData:dispatchData observer:observer holdsWrites:NO];
+}
+
+/**
+ Needs to be called on the control queue.
+
+ @param holds Hold back all later writes, until @c -releaseHeldWrites is called, e.g. from the observer.
+ */
+- (void)writeCommandData:(dispatch_data_t)dispatchData observer:(nullable TORObserverBlock)observer holdsWrites:(BOOL)holds
+{
+    if (_holdingWrites)
+    {
+        [_heldWrites addObject:^{
+            [self writeCommandData:dispatchData observer:observer holdsWrites:holds];
+        }];
+
+        return;
+    }
+
+    if (!observer)
+    {
+        observer = ^BOOL(NSArray<NSNumber *> * __unused codes, NSArray<NSData *> * __unused lines, BOOL * __unused stop) {
+            return YES;
+        };
+    }
+
+    dispatch_io_t channel = _channel;
+    if (!channel)
+    {
+        // Not connected: Fail right away, so every completion is called.
+        BOOL stop = YES;
+        observer(@[], @[], &stop);
+
+        return;
+    }
+
+    [_pending addObject:observer];
+
+    _holdingWrites = holds;
+
+    dispatch_io_write(channel, 0, dispatchData, self.controlQueue, ^(bool done, dispatch_data_t __unused data, int error) {
+        if (done && error && [self->_pending containsObject:observer])
+        {
+            // This will never be answered. Report an empty reply, so the observer can fail.
+            [self->_pending removeObject:observer];
+            [self->_dataSinks removeObjectForKey:observer];
+
+            BOOL stop = YES;
+            observer(@[], @[], &stop);
+        }
+    });
+}
+
+/**
+ Writes everything held back, in order, until one of the writes holds again.
+
+ Needs to be called on the control queue.
+ */
+- (void)releaseHeldWrites
+{
+    _holdingWrites = NO;
+
+    while (_heldWrites.count > 0 && !_holdingWrites)
+    {
+        dispatch_block_t write = _heldWrites.firstObject;
+        [_heldWrites removeObjectAtIndex:0];
+
+        write();
+    }
+}
+
+/**
+ Sends a @c GETINFO or @c SETCONF command, or collects it for merging, while a batch is open or commands are coalesced.
+
+ @param keys The configuration or info keys the command touches.
+ */
+- (void)sendBatchableCommand:(NSString *)command
+                   arguments:(NSArray<NSString *> *)arguments
+                        keys:(NSArray<NSString *> *)keys
+                    observer:(TORObserverBlock)observer
+{
+    TORBatchedCommand *batched = [[TORBatchedCommand alloc] initWithCommand:command arguments:arguments keys:keys observer:observer];
+
+    dispatch_async(self.controlQueue, ^{
+        [self enqueueBatchedCommand:batched];
+    });
+}
+
+/**
+ Needs to be called on the control queue.
+ */
+- (void)enqueueBatchedCommand:(TORBatchedCommand *)batched
+{
+    // Changed configuration might change cached info. CONF_CHANGED might arrive too late for
+    // a GETINFO sent right after this.
+    if (_cachesInfo && [batched.command isEqualToString:TORCommandSetConf])
+    {
+        [self invalidateInfoCacheWithPrefixes:(NSArray * _Nonnull)self.class.infoCacheInvalidations[@"CONF_CHANGED"]];
+    }
+
+    if (_batchDepth == 0 && !self.coalescesCommands)
+    {
+        [self flushBatch];
+
+        [self writeCommandData:[self.class dataForCommand:batched.command arguments:batched.arguments data:nil]
+                      observer:batched.observer];
+
+        return;
+    }
+
+    [_batch addObject:batched];
+
+    // Everything enqueued on the control queue until then gets merged.
+    if (_batchDepth == 0 && !_batchFlushScheduled)
+    {
+        _batchFlushScheduled = YES;
+
+        dispatch_async(self.controlQueue, ^{
+            [self flushBatch];
+        });
+    }
+}
+
+/**
+ Sends all collected commands as the fewest possible commands, keeping their order.
+
+ Needs to be called on the control queue.
+ */
+- (void)flushBatch
+{
+    _batchFlushScheduled = NO;
+
+    if (_batch.count < 1)
+    {
+        return;
+    }
+
+    NSArray<TORBatchedCommand *> *batch = _batch;
+    _batch = [NSMutableArray new];
+
+    NSMutableArray<TORBatchedCommand *> *group = [NSMutableArray new];
+    NSMutableSet<NSString *> *groupKeys = [NSMutableSet new];
+
+    for (TORBatchedCommand *batched in batch)
+    {
+        BOOL split = group.count > 0 && ![group.firstObject.command isEqualToString:batched.command];
+
+        // Setting a key twice in one SETCONF would append instead of replace, so never merge that.
+        if (!split && [batched.command isEqualToString:TORCommandSetConf])
+        {
+            for (NSString *key in batched.keys)
+            {
+                if ([groupKeys containsObject:key.lowercaseString])
+                {
+                    split = YES;
+                    break;
+                }
+            }
+        }
+
+        if (split)
+        {
+            [self writeBatchGroup:group];
+
+            group = [NSMutableArray new];
+            [groupKeys removeAllObjects];
+        }
+
+        [group addObject:batched];
+
+        for (NSString *key in batched.keys)
+        {
+            [groupKeys addObject:key.lowercaseString];
+        }
+    }
+
+    [self writeBatchGroup:group];
+}
+
+/**
+ Sends a group of @c GETINFO or @c SETCONF calls as one command and splits the reply back to the calls.
+
+ Needs to be called on the control queue.
+ */
+- (void)writeBatchGroup:(NSArray<TORBatchedCommand *> *)group
+{
+    if (group.count < 1)
+    {
+        return;
+    }
+
+    if (group.count == 1)
+    {
+        TORBatchedCommand *batched = group.firstObject;
+
+        [self writeCommandData:[self.class dataForCommand:batched.command arguments:batched.arguments data:nil] observer:batched.observer];
+
+        return;
+    }
+
+    NSString *command = group.firstObject.command;
+    BOOL isGetInfo = [command isEqualToString:TORCommandGetInfo];
+
+    NSMutableArray<NSString *> *arguments = [NSMutableArray new];
+
+    for (TORBatchedCommand *batched in group)
+    {
+        for (NSString *argument in batched.arguments)
+        {
+            // The same info doesn't need to be asked for twice.
+            if (!isGetInfo || ![arguments containsObject:argument])
+            {
+                [arguments addObject:argument];
+            }
+        }
+    }
+
+    TORObserverBlock observer = ^BOOL(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL *stop) {
+        *stop = YES;
+
+        // Couldn't be written: Nothing to retry.
+        if (codes.count < 1)
+        {
+            for (TORBatchedCommand *batched in group)
+            {
+                BOOL s = YES;
+                batched.observer(codes, lines, &s);
+            }
+
+            [self releaseHeldWrites];
+
+            return YES;
+        }
+
+        NSArray<NSArray *> *replies = isGetInfo
+            ? [self.class splitGetInfoReplyWithCodes:codes lines:lines forGroup:group]
+            : [self.class splitSetConfReplyWithCodes:codes lines:lines forGroup:group];
+
+        if (!replies)
+        {
+            // Tor applies a SETCONF either completely or not at all and GETINFO has no
+            // side effects, so retrying individually is safe. Later writes were held back
+            // behind a SETCONF, so its retries still go out in the order of the calls.
+            self->_holdingWrites = NO;
+
+            for (TORBatchedCommand *batched in group)
+            {
+                [self writeCommandData:[self.class dataForCommand:batched.command arguments:batched.arguments data:nil]
+                              observer:batched.observer];
+            }
+
+            [self releaseHeldWrites];
+
+            return YES;
+        }
+
+        for (NSUInteger i = 0; i < group.count; i++)
+        {
+            BOOL s = YES;
+            group[i].observer(replies[i][0], replies[i][1], &s);
+        }
+
+        [self releaseHeldWrites];
+
+        return YES;
+    };
+
+    // A retried SETCONF must not overtake anything called after it, e.g. a later SETCONF of the same key.
+    [self writeCommandData:[self.class dataForCommand:command arguments:arguments data:nil] observer:observer
+               holdsWrites:!isGetInfo];
+}
+
+/**
+ @return One (codes, lines) reply per call, or nil, if the merged command failed.
+ */
++ (nullable NSArray<NSArray *> *)splitGetInfoReplyWithCodes:(NSArray<NSNumber *> *)codes
+                                                      lines:(NSArray<NSData *> *)lines
+                                                   forGroup:(NSArray<TORBatchedCommand *> *)group
+{
+    if (codes.count != lines.count || codes.lastObject.integerValue != TORControlReplyCodeOK)
+    {
+        return nil;
+    }
+
+    NSMutableDictionary<NSString *, NSNumber *> *keyCodes = [NSMutableDictionary new];
+    NSMutableDictionary<NSString *, NSData *> *keyLines = [NSMutableDictionary new];
+
+    for (NSUInteger i = 0; i < lines.count - 1; i++)
+    {
+        const char *bytes = lines[i].bytes;
+        const char *equals = memchr(bytes, '=', lines[i].length);
+
+        if (!equals)
+        {
+            return nil;
+        }
+
+        NSString *key = [[NSString alloc] initWithBytes:bytes length:(NSUInteger)(equals - bytes) encoding:NSUTF8StringEncoding];
+
+        if (!key)
+        {
+            return nil;
+        }
+
+        keyCodes[key] = codes[i];
+        keyLines[key] = lines[i];
+    }
+
+    NSMutableArray<NSArray *> *replies = [NSMutableArray new];
+
+    for (TORBatchedCommand *batched in group)
+    {
+        NSMutableArray<NSNumber *> *c = [NSMutableArray new];
+        NSMutableArray<NSData *> *l = [NSMutableArray new];
+
+        for (NSString *key in batched.keys)
+        {
+            if (!keyCodes[key])
+            {
+                return nil;
+            }
+
+            [c addObject:(NSNumber * _Nonnull)keyCodes[key]];
+            [l addObject:(NSData * _Nonnull)keyLines[key]];
+        }
+
+        [c addObject:(NSNumber * _Nonnull)codes.lastObject];
+        [l addObject:(NSData * _Nonnull)lines.lastObject];
+
+        [replies addObject:@[c, l]];
+    }
+
+    return replies;
+}
+
+/**
+ @return The same reply for every call, or nil, if the merged command failed.
+ */
++ (nullable NSArray<NSArray *> *)splitSetConfReplyWithCodes:(NSArray<NSNumber *> *)codes
+                                                      lines:(NSArray<NSData *> *)lines
+                                                   forGroup:(NSArray<TORBatchedCommand *> *)group
+{
+    if (codes.firstObject.integerValue != TORControlReplyCodeOK)
+    {
+        return nil;
+    }
+
+    NSMutableArray<NSArray *> *replies = [NSMutableArray new];
+
+    for (NSUInteger i = 0; i < group.count; i++)
+    {
+        [replies addObject:@[codes, lines]];
+    }
+
+    return replies;
+}
+
++ (NSError *)errorWithCode:(TORControllerError)code description:(NSString *)description
+{
+    return [NSError errorWithDomain:TORControllerErrorDomain code:code
+                           userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+/**
+ An error from the first failing line of a reply, with Tor's reply code.
+ */
++ (NSError *)errorWithCodes:(NSArray<NSNumber *> *)codes lines:(NSArray<NSData *> *)lines
+{
+    if (codes.count < 1)
+    {
+        return [self errorWithCode:TORControllerErrorEmptyReply description:@"Empty reply from Tor."];
+    }
+
+    NSUInteger i = 0;
+
+    while (i < codes.count - 1 && codes[i].integerValue == TORControlReplyCodeOK)
+    {
+        i++;
+    }
+
+    NSString *message = i < lines.count ? [[NSString alloc] initWithData:lines[i] encoding:NSUTF8StringEncoding] : nil;
+
+    return [NSError errorWithDomain:TORControllerErrorDomain code:codes[i].integerValue
+                           userInfo:@{NSLocalizedDescriptionKey: message ?: @""}];
+}
+
+- (TORObserverBlock)observerWithCompletion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion
+{
+    return ^BOOL(NSArray<NSNumber *> *codes, NSArray<NSData *> *lines, BOOL *stop) {
+        NSUInteger code = codes.firstObject.unsignedIntegerValue;
+        NSString *message = lines.firstObject ? [[NSString alloc] initWithData:(NSData * _Nonnull)lines.firstObject encoding:NSUTF8StringEncoding] : @"";
+        NSDictionary<NSString *, NSString *> *userInfo = [NSDictionary dictionaryWithObjectsAndKeys:message, NSLocalizedDescriptionKey, nil];
+        BOOL success = (code == TORControlReplyCodeOK && [message isEqualToString:@"OK"]);
+        if (completion)
+            completion(success, success ? nil : [NSError errorWithDomain:TORControllerErrorDomain code:code userInfo:userInfo]);
+
+        *stop = YES;
+        return YES;
+    };
 }
 
 @end
@@ -0,0 +1,92 @@
+//
+//  TORControllerPool.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+#import "TORController.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Multiple control connections to the same Tor.
+
+ Tor answers the commands on one connection strictly in order, so a multi-megabyte reply to
+ "GETINFO ns/all" holds up a "SIGNAL NEWNYM" sent right after it. A pool keeps heavy read-only
+ queries on separate bulk connections, while the primary connection stays free for
+ latency-sensitive commands and events.
+
+ Every connection has its own queue: The primary one runs with user-initiated quality of service,
+ the bulk ones with utility quality of service.
+ */
+NS_SWIFT_NAME(TorControllerPool)
+@interface TORControllerPool : NSObject
+
+/**
+ The connection for commands, configuration, events and circuits.
+
+ It never loads the relay index itself: Its @c relayIndexProvider loads it on a bulk connection.
+ */
+@property (readonly) TORController *primary;
+
+/**
+ The connections for heavy read-only queries, used round-robin.
+ */
+@property (readonly) NSArray<TORController *> *bulk;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ Uses one bulk connection.
+ */
+- (instancetype)initWithSocketURL:(NSURL *)url;
+
+/**
+ Uses one bulk connection.
+ */
+- (instancetype)initWithSocketHost:(NSString *)host port:(in_port_t)port;
+
+- (instancetype)initWithSocketURL:(NSURL *)url bulkConnections:(NSUInteger)count NS_DESIGNATED_INITIALIZER;
+
+- (instancetype)initWithSocketHost:(NSString *)host port:(in_port_t)port bulkConnections:(NSUInteger)count NS_DESIGNATED_INITIALIZER;
+
+/**
+ Authenticate all connections.
+
+ @param completion Called once all are done. @c success is only YES, if all succeeded. @c error is the first error.
+ */
+- (void)authenticateWithData:(NSData *)data completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion;
+
+- (void)disconnect;
+
+/**
+ The next bulk connection in turn.
+ */
+- (TORController *)nextBulkController;
+
+/**
+ Get info on a bulk connection, if any of the keys is heavy, on the primary connection otherwise.
+
+ See @c +isBulkInfoKey: .
+ */
+- (void)getInfoForKeys:(NSArray<NSString *> *)keys completion:(void (^)(NSArray<NSString *> *values))completion NS_SWIFT_ASYNC(2);
+
+/**
+ Load the relay index on a bulk connection and hand it to the primary connection, so circuits
+ can be enriched without loading it there.
+
+ The primary connection also does this by itself, when it tracks circuits, and with every new consensus
+ after a relay index was loaded.
+ */
+- (void)loadRelayIndex:(void (^__nullable)(TORRelayIndex * __nullable relayIndex))completion NS_SWIFT_ASYNC(1);
+
+/**
+ @return YES, if the reply to this @c GETINFO key can be large, e.g. "ns/all" or "md/all".
+ */
++ (BOOL)isBulkInfoKey:(NSString *)key;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,196 @@
+//
+//  TORControllerPool.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORControllerPool.h"
+#import "TORController+Private.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation TORControllerPool {
+    NSUInteger _next;
+}
+
+- (instancetype)initWithSocketURL:(NSURL *)url
+{
+    return [self initWithSocketURL:url bulkConnections:1];
+}
+
+- (instancetype)initWithSocketHost:(NSString *)host port:(in_port_t)port
+{
+    return [self initWithSocketHost:host port:port bulkConnections:1];
+}
+
+- (instancetype)initWithSocketURL:(NSURL *)url bulkConnections:(NSUInteger)count
+{
+    NSParameterAssert(count > 0);
+
+    self = [super init];
+
+    if (self)
+    {
+        _primary = [[TORController alloc] initWithSocketURL:url qualityOfService:NSQualityOfServiceUserInitiated];
+
+        NSMutableArray<TORController *> *bulk = [NSMutableArray new];
+
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            [bulk addObject:[[TORController alloc] initWithSocketURL:url qualityOfService:NSQualityOfServiceUtility]];
+        }
+
+        _bulk = bulk;
+
+        [self provideRelayIndex];
+    }
+
+    return self;
+}
+
+- (instancetype)initWithSocketHost:(NSString *)host port:(in_port_t)port bulkConnections:(NSUInteger)count
+{
+    NSParameterAssert(count > 0);
+
+    self = [super init];
+
+    if (self)
+    {
+        _primary = [[TORController alloc] initWithSocketHost:host port:port qualityOfService:NSQualityOfServiceUserInitiated];
+
+        NSMutableArray<TORController *> *bulk = [NSMutableArray new];
+
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            [bulk addObject:[[TORController alloc] initWithSocketHost:host port:port qualityOfService:NSQualityOfServiceUtility]];
+        }
+
+        _bulk = bulk;
+
+        [self provideRelayIndex];
+    }
+
+    return self;
+}
+
+
+// MARK: Public Methods
+
+- (void)authenticateWithData:(NSData *)data completion:(void (^__nullable)(BOOL success, NSError * __nullable error))completion
+{
+    NSArray<TORController *> *controllers = [@[_primary] arrayByAddingObjectsFromArray:_bulk];
+
+    // Completions come in on the queues of the different controllers.
+    dispatch_queue_t queue = dispatch_queue_create("org.torproject.Tor.pool", DISPATCH_QUEUE_SERIAL);
+    __block NSUInteger remaining = controllers.count;
+    __block NSError *firstError;
+    __block BOOL allSucceeded = YES;
+
+    for (TORController *controller in controllers)
+    {
+        [controller authenticateWithData:data completion:^(BOOL success, NSError * _Nullable error) {
+            dispatch_async(queue, ^{
+                allSucceeded = allSucceeded && success;
+
+                if (!firstError)
+                {
+                    firstError = error;
+                }
+
+                if (--remaining == 0 && completion)
+                {
+                    completion(allSucceeded, firstError);
+                }
+            });
+        }];
+    }
+}
+
+- (void)disconnect
+{
+    [_primary disconnect];
+
+    for (TORController *controller in _bulk)
+    {
+        [controller disconnect];
+    }
+}
+
+- (TORController *)nextBulkController
+{
+    @synchronized (self) {
+        return _bulk[_next++ % _bulk.count];
+    }
+}
+
+- (void)getInfoForKeys:(NSArray<NSString *> *)keys completion:(void (^)(NSArray<NSString *> *values))completion
+{
+    for (NSString *key in keys)
+    {
+        if ([self.class isBulkInfoKey:key])
+        {
+            [self.nextBulkController getInfoForKeys:keys completion:completion];
+
+            return;
+        }
+    }
+
+    [_primary getInfoForKeys:keys completion:completion];
+}
+
+- (void)loadRelayIndex:(void (^__nullable)(TORRelayIndex * __nullable relayIndex))completion
+{
+    // Goes through the relay index provider to a bulk connection.
+    [_primary loadRelayIndex:completion];
+}
+
++ (BOOL)isBulkInfoKey:(NSString *)key
+{
+    static NSArray<NSString *> *prefixes;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        prefixes = @[@"ns/all", @"ns/purpose/", @"md/all", @"desc/all-recent", @"dir/",
+                     @"extra-info/digest/", @"config-text", @"config/names", @"config/defaults",
+                     @"info/names"];
+    });
+
+    for (NSString *prefix in prefixes)
+    {
+        if ([key hasPrefix:prefix])
+        {
+            return YES;
+        }
+    }
+
+    return NO;
+}
+
+
+// MARK: Private Methods
+
+/**
+ Whenever the primary connection needs a relay index, it is loaded on a bulk connection instead.
+ */
+- (void)provideRelayIndex
+{
+    __weak TORControllerPool *weakSelf = self;
+
+    _primary.relayIndexProvider = ^(void (^completion)(TORRelayIndex * _Nullable relayIndex)) {
+        TORControllerPool *strongSelf = weakSelf;
+
+        if (!strongSelf)
+        {
+            completion(nil);
+
+            return;
+        }
+
+        [strongSelf.nextBulkController fetchRelayIndex:completion];
+    };
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,73 @@
+//
+//  TORGeoIPDatabase.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+#import "TORNode.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Country lookups for IP addresses without asking Tor.
+
+ Reads Tor's @c geoip and @c geoip6 files once into compact, sorted range tables and
+ answers lookups with a binary search over them. Works independently of the control
+ port, so it can also be used while Tor is still bootstrapping or not running at all.
+
+ Instances are immutable and can be used from any thread.
+ */
+NS_SWIFT_NAME(TorGeoIpDatabase)
+@interface TORGeoIPDatabase : NSObject
+
+/**
+ A database loaded from the files of the @c GeoIP subspec. Nil, if they aren't bundled.
+
+ Loaded on first access, which takes a moment. Consider accessing this on a background thread first.
+ */
+@property (class, readonly, nullable) TORGeoIPDatabase *bundledDatabase;
+
+/**
+ The number of IPv4 address ranges loaded.
+ */
+@property (readonly) NSUInteger ipv4RangeCount;
+
+/**
+ The number of IPv6 address ranges loaded.
+ */
+@property (readonly) NSUInteger ipv6RangeCount;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ @param geoipFile A @c geoip file as distributed with Tor, containing IPv4 ranges.
+ @param geoip6File A @c geoip6 file as distributed with Tor, containing IPv6 ranges.
+ @return nil, if neither of the files could be read.
+ */
+- (nullable instancetype)initWithGeoipFile:(nullable NSURL *)geoipFile geoip6File:(nullable NSURL *)geoip6File NS_DESIGNATED_INITIALIZER;
+
+/**
+ @param address An IPv4 or IPv6 address.
+ @return The lower case country code of the address, like Tor's "GETINFO ip-to-country" returns it, or nil, if unknown.
+ */
+- (nullable NSString *)countryCodeForAddress:(NSString *)address;
+
+/**
+ @param addresses A list of IPv4 and/or IPv6 addresses.
+ @return The country codes of all given addresses, which are known.
+ */
+- (NSDictionary<NSString *, NSString *> *)countryCodesForAddresses:(NSArray<NSString *> *)addresses;
+
+/**
+ Sets the @c countryCode property of all given nodes, which don't have one, yet.
+ The IPv4 address is preferred, if available.
+
+ @param nodes List of `TORNode`s to resolve countries for.
+ */
+- (void)resolveCountriesOfNodes:(NSArray<TORNode *> *)nodes;
+
+@end
+
+NS_ASSUME_NONNULL_END
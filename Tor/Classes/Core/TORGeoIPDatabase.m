@@ -0,0 +1,482 @@
+//
+//  TORGeoIPDatabase.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORGeoIPDatabase.h"
+#import "NSBundle+GeoIP.h"
+
+#import <arpa/inet.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+typedef struct {
+    uint32_t low;
+    uint32_t high;
+    char country[2];
+} TORGeoIPRange4;
+
+typedef struct {
+    uint64_t lowHigh, lowLow;
+    uint64_t highHigh, highLow;
+    char country[2];
+} TORGeoIPRange6;
+
+
+// MARK: Helpers
+
+static int TORCompareRange4(const void *a, const void *b)
+{
+    uint32_t x = ((const TORGeoIPRange4 *)a)->low, y = ((const TORGeoIPRange4 *)b)->low;
+
+    return x < y ? -1 : x > y;
+}
+
+static int TORCompareIpv6(uint64_t aHigh, uint64_t aLow, uint64_t bHigh, uint64_t bLow)
+{
+    if (aHigh != bHigh)
+    {
+        return aHigh < bHigh ? -1 : 1;
+    }
+
+    return aLow < bLow ? -1 : aLow > bLow;
+}
+
+static int TORCompareRange6(const void *a, const void *b)
+{
+    const TORGeoIPRange6 *x = a, *y = b;
+
+    return TORCompareIpv6(x->lowHigh, x->lowLow, y->lowHigh, y->lowLow);
+}
+
+static void TORSplitIpv6(const struct in6_addr *address, uint64_t *high, uint64_t *low)
+{
+    *high = 0;
+    *low = 0;
+
+    for (int i = 0; i < 8; i++)
+    {
+        *high = *high << 8 | address->s6_addr[i];
+        *low = *low << 8 | address->s6_addr[i + 8];
+    }
+}
+
+/**
+ Calls the block for every non-comment line of a file, split at the commas into exactly 3 fields.
+ */
+static void TOREnumerateGeoIPLines(NSData *data, void (^block)(const char *fields[3], const size_t lengths[3]))
+{
+    const char *p = data.bytes;
+    const char *end = p + data.length;
+
+    while (p < end)
+    {
+        const char *lf = memchr(p, '\n', (size_t)(end - p)) ?: end;
+
+        if (*p != '#')
+        {
+            const char *fields[3];
+            size_t lengths[3];
+            const char *field = p;
+            int count = 0;
+
+            while (count < 3)
+            {
+                const char *comma = memchr(field, ',', (size_t)(lf - field));
+                const char *fieldEnd = comma && count < 2 ? comma : lf;
+
+                fields[count] = field;
+                lengths[count] = (size_t)(fieldEnd - field);
+                count++;
+
+                if (fieldEnd == lf)
+                {
+                    break;
+                }
+
+                field = fieldEnd + 1;
+            }
+
+            if (count == 3)
+            {
+                // Remove a trailing CR.
+                if (lengths[2] > 0 && fields[2][lengths[2] - 1] == '\r')
+                {
+                    lengths[2]--;
+                }
+
+                block(fields, lengths);
+            }
+        }
+
+        p = lf + 1;
+    }
+}
+
+static BOOL TORParseUInt32(const char *p, size_t length, uint32_t *value)
+{
+    uint64_t v = 0;
+
+    if (length < 1 || length > 10)
+    {
+        return NO;
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (p[i] < '0' || p[i] > '9')
+        {
+            return NO;
+        }
+
+        v = v * 10 + (uint64_t)(p[i] - '0');
+    }
+
+    if (v > UINT32_MAX)
+    {
+        return NO;
+    }
+
+    *value = (uint32_t)v;
+
+    return YES;
+}
+
+static BOOL TORParseIpv6(const char *p, size_t length, uint64_t *high, uint64_t *low)
+{
+    char buffer[INET6_ADDRSTRLEN];
+    struct in6_addr address;
+
+    if (length >= sizeof(buffer))
+    {
+        return NO;
+    }
+
+    memcpy(buffer, p, length);
+    buffer[length] = '\0';
+
+    if (inet_pton(AF_INET6, buffer, &address) != 1)
+    {
+        return NO;
+    }
+
+    TORSplitIpv6(&address, high, low);
+
+    return YES;
+}
+
+static void TORCopyCountry(char country[2], const char *p, size_t length)
+{
+    country[0] = length > 0 ? (char)tolower(p[0]) : '?';
+    country[1] = length > 1 ? (char)tolower(p[1]) : '?';
+}
+
+
+@implementation TORGeoIPDatabase {
+    TORGeoIPRange4 *_ranges4;
+    size_t _count4;
+
+    TORGeoIPRange6 *_ranges6;
+    size_t _count6;
+}
+
++ (nullable TORGeoIPDatabase *)bundledDatabase
+{
+    static TORGeoIPDatabase *database;
+    static dispatch_once_t onceToken;
+
+    dispatch_once(&onceToken, ^{
+        NSBundle *bundle = NSBundle.geoIpBundle;
+
+        if (bundle)
+        {
+            database = [[TORGeoIPDatabase alloc] initWithGeoipFile:bundle.geoipFile geoip6File:bundle.geoip6File];
+        }
+    });
+
+    return database;
+}
+
+- (nullable instancetype)initWithGeoipFile:(nullable NSURL *)geoipFile geoip6File:(nullable NSURL *)geoip6File
+{
+    self = [super init];
+
+    if (self)
+    {
+        // The files are only read once while building the tables, so just map them.
+        NSData *data4 = geoipFile ? [NSData dataWithContentsOfURL:(NSURL * _Nonnull)geoipFile options:NSDataReadingMappedIfSafe error:nil] : nil;
+        NSData *data6 = geoip6File ? [NSData dataWithContentsOfURL:(NSURL * _Nonnull)geoip6File options:NSDataReadingMappedIfSafe error:nil] : nil;
+
+        if (!data4 && !data6)
+        {
+            return nil;
+        }
+
+        if (data4)
+        {
+            [self loadIpv4:(NSData * _Nonnull)data4];
+        }
+
+        if (data6)
+        {
+            [self loadIpv6:(NSData * _Nonnull)data6];
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_ranges4);
+    free(_ranges6);
+}
+
+
+// MARK: Public Properties
+
+- (NSUInteger)ipv4RangeCount
+{
+    return _count4;
+}
+
+- (NSUInteger)ipv6RangeCount
+{
+    return _count6;
+}
+
+
+// MARK: Public Methods
+
+- (nullable NSString *)countryCodeForAddress:(NSString *)address
+{
+    const char *string = address.UTF8String;
+
+    if (!string)
+    {
+        return nil;
+    }
+
+    const char *country = NULL;
+
+    if (strchr(string, ':'))
+    {
+        struct in6_addr addr;
+
+        if (inet_pton(AF_INET6, string, &addr) == 1)
+        {
+            uint64_t high, low;
+            TORSplitIpv6(&addr, &high, &low);
+
+            country = [self countryForIpv6High:high low:low];
+        }
+    }
+    else {
+        struct in_addr addr;
+
+        if (inet_pton(AF_INET, string, &addr) == 1)
+        {
+            country = [self countryForIpv4:ntohl(addr.s_addr)];
+        }
+    }
+
+    // Two ASCII characters fit into a tagged pointer string, so this doesn't allocate.
+    return country ? [[NSString alloc] initWithBytes:country length:2 encoding:NSASCIIStringEncoding] : nil;
+}
+
+- (NSDictionary<NSString *, NSString *> *)countryCodesForAddresses:(NSArray<NSString *> *)addresses
+{
+    NSMutableDictionary<NSString *, NSString *> *countryCodes = [NSMutableDictionary new];
+
+    for (NSString *address in addresses)
+    {
+        if (countryCodes[address])
+        {
+            continue;
+        }
+
+        NSString *countryCode = [self countryCodeForAddress:address];
+
+        if (countryCode)
+        {
+            countryCodes[address] = countryCode;
+        }
+    }
+
+    return countryCodes;
+}
+
+- (void)resolveCountriesOfNodes:(NSArray<TORNode *> *)nodes
+{
+    for (TORNode *node in nodes)
+    {
+        if (node.countryCode.length)
+        {
+            continue;
+        }
+
+        NSString *countryCode;
+
+        if (node.ipv4Address.length)
+        {
+            countryCode = [self countryCodeForAddress:(NSString * _Nonnull)node.ipv4Address];
+        }
+
+        if (!countryCode && node.ipv6Address.length)
+        {
+            countryCode = [self countryCodeForAddress:(NSString * _Nonnull)node.ipv6Address];
+        }
+
+        if (countryCode)
+        {
+            node.countryCode = countryCode;
+        }
+    }
+}
+
+
+// MARK: Private Methods
+
+/**
+ Format: INTIPLOW,INTIPHIGH,CC
+ */
+- (void)loadIpv4:(NSData *)data
+{
+    __block size_t capacity = 0;
+    __block BOOL sorted = YES;
+
+    TOREnumerateGeoIPLines(data, ^(const char *fields[3], const size_t lengths[3]) {
+        TORGeoIPRange4 range;
+
+        if (!TORParseUInt32(fields[0], lengths[0], &range.low)
+            || !TORParseUInt32(fields[1], lengths[1], &range.high)
+            || range.high < range.low)
+        {
+            return;
+        }
+
+        TORCopyCountry(range.country, fields[2], lengths[2]);
+
+        if (self->_count4 == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 65536;
+            self->_ranges4 = reallocf(self->_ranges4, capacity * sizeof(TORGeoIPRange4));
+
+            NSAssert(self->_ranges4, @"Out of memory.");
+        }
+
+        if (self->_count4 > 0 && self->_ranges4[self->_count4 - 1].low > range.low)
+        {
+            sorted = NO;
+        }
+
+        self->_ranges4[self->_count4++] = range;
+    });
+
+    // Tor's files are sorted, but don't rely on that.
+    if (!sorted)
+    {
+        qsort(_ranges4, _count4, sizeof(TORGeoIPRange4), TORCompareRange4);
+    }
+}
+
+/**
+ Format: IPV6LOW,IPV6HIGH,CC
+ */
+- (void)loadIpv6:(NSData *)data
+{
+    __block size_t capacity = 0;
+    __block BOOL sorted = YES;
+
+    TOREnumerateGeoIPLines(data, ^(const char *fields[3], const size_t lengths[3]) {
+        TORGeoIPRange6 range;
+
+        if (!TORParseIpv6(fields[0], lengths[0], &range.lowHigh, &range.lowLow)
+            || !TORParseIpv6(fields[1], lengths[1], &range.highHigh, &range.highLow)
+            || TORCompareIpv6(range.highHigh, range.highLow, range.lowHigh, range.lowLow) < 0)
+        {
+            return;
+        }
+
+        TORCopyCountry(range.country, fields[2], lengths[2]);
+
+        if (self->_count6 == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 16384;
+            self->_ranges6 = reallocf(self->_ranges6, capacity * sizeof(TORGeoIPRange6));
+
+            NSAssert(self->_ranges6, @"Out of memory.");
+        }
+
+        if (self->_count6 > 0 && TORCompareRange6(&self->_ranges6[self->_count6 - 1], &range) > 0)
+        {
+            sorted = NO;
+        }
+
+        self->_ranges6[self->_count6++] = range;
+    });
+
+    if (!sorted)
+    {
+        qsort(_ranges6, _count6, sizeof(TORGeoIPRange6), TORCompareRange6);
+    }
+}
+
+/**
+ Binary search for the last range starting at or before the address.
+ */
+- (nullable const char *)countryForIpv4:(uint32_t)address
+{
+    size_t low = 0, high = _count4;
+
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+
+        if (_ranges4[mid].low <= address)
+        {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    if (low == 0 || _ranges4[low - 1].high < address)
+    {
+        return NULL;
+    }
+
+    return _ranges4[low - 1].country;
+}
+
+- (nullable const char *)countryForIpv6High:(uint64_t)addressHigh low:(uint64_t)addressLow
+{
+    size_t low = 0, high = _count6;
+
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+
+        if (TORCompareIpv6(_ranges6[mid].lowHigh, _ranges6[mid].lowLow, addressHigh, addressLow) <= 0)
+        {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    if (low == 0 || TORCompareIpv6(_ranges6[low - 1].highHigh, _ranges6[low - 1].highLow, addressHigh, addressLow) < 0)
+    {
+        return NULL;
+    }
+
+    return _ranges6[low - 1].country;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,99 @@
+//
+//  TORLogFileWriter.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Appends log lines to a file without blocking the logging thread.
+
+ Lines are collected in memory and written in batches through a file descriptor, which
+ stays open, on a private background queue. ANSI color escape sequences are removed while
+ copying. When the file grows beyond @c maxFileSize, it is rotated to @c <name>.1,
+ @c <name>.2 etc., keeping at most @c maxFiles old files.
+
+ All methods can be called from any thread.
+ */
+NS_SWIFT_NAME(TorLogFileWriter)
+@interface TORLogFileWriter : NSObject
+
+/**
+ The file, which is written to.
+ */
+@property (readonly) NSURL *url;
+
+/**
+ Size in bytes, after which the file is rotated. 0 disables rotation.
+ */
+@property (readonly) unsigned long long maxFileSize;
+
+/**
+ Number of rotated files to keep.
+ */
+@property (readonly) NSUInteger maxFiles;
+
+/**
+ Interval after the first buffered line, after which the buffer is written at the latest. Defaults to 0.5 seconds.
+ */
+@property (atomic) NSTimeInterval flushInterval;
+
+/**
+ Number of buffered bytes, which cause an immediate write. Defaults to 64 KiB.
+ */
+@property (atomic) NSUInteger flushThreshold;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ Creates a writer, which never rotates.
+
+ @param url The file to append to. Will be created, if it doesn't exist.
+ */
+- (instancetype)initWithURL:(NSURL *)url;
+
+/**
+ @param url The file to append to. Will be created, if it doesn't exist.
+ @param maxFileSize Size in bytes, after which the file is rotated. 0 disables rotation.
+ @param maxFiles Number of rotated files to keep.
+ */
+- (instancetype)initWithURL:(NSURL *)url maxFileSize:(unsigned long long)maxFileSize maxFiles:(NSUInteger)maxFiles NS_DESIGNATED_INITIALIZER;
+
+/**
+ Buffers a C string. A newline is appended, if missing.
+
+ @param message A NUL-terminated, UTF-8 encoded string.
+ */
+- (void)writeCString:(const char *)message NS_SWIFT_NAME(write(cString:));
+
+/**
+ Buffers a line. A newline is appended, if missing.
+ */
+- (void)writeLine:(NSString *)line NS_SWIFT_NAME(write(line:));
+
+/**
+ Writes all buffered lines and returns, when they reached the file.
+ */
+- (void)flush;
+
+/**
+ Writes all buffered lines and closes the file. Later writes are ignored.
+ */
+- (void)close;
+
+/**
+ Removes ANSI color escape sequences (`ESC [ <digits and semicolons> m`) in place.
+
+ @param bytes The buffer to modify.
+ @param length The length of the buffer.
+ @return The new length of the buffer.
+ */
++ (size_t)stripAnsiEscapes:(char *)bytes length:(size_t)length;
+
+@end
+
+NS_ASSUME_NONNULL_END
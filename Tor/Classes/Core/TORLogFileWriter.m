@@ -0,0 +1,308 @@
+//
+//  TORLogFileWriter.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORLogFileWriter.h"
+
+#import <os/lock.h>
+#import <sys/stat.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@implementation TORLogFileWriter {
+    dispatch_queue_t _queue;
+
+    // Guarded by _lock.
+    os_unfair_lock _lock;
+    NSMutableData *_buffer;
+    NSMutableData *_spare;
+    BOOL _flushScheduled;
+    BOOL _closed;
+
+    // Only accessed on _queue.
+    int _fd;
+    unsigned long long _fileSize;
+}
+
+- (instancetype)initWithURL:(NSURL *)url
+{
+    return [self initWithURL:url maxFileSize:0 maxFiles:0];
+}
+
+- (instancetype)initWithURL:(NSURL *)url maxFileSize:(unsigned long long)maxFileSize maxFiles:(NSUInteger)maxFiles
+{
+    self = [super init];
+
+    if (self)
+    {
+        _url = url;
+        _maxFileSize = maxFileSize;
+        _maxFiles = maxFiles;
+        _flushInterval = 0.5;
+        _flushThreshold = 64 * 1024;
+
+        _queue = dispatch_queue_create("org.torproject.Tor.logfile", DISPATCH_QUEUE_SERIAL);
+        _lock = OS_UNFAIR_LOCK_INIT;
+        _buffer = [NSMutableData new];
+        _fd = -1;
+
+        dispatch_async(_queue, ^{
+            [self open];
+        });
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    // Blocks on the queue retain us, so nothing can be pending anymore, here.
+    if (_buffer.length > 0)
+    {
+        [self writeData:_buffer];
+    }
+
+    if (_fd >= 0)
+    {
+        close(_fd);
+    }
+}
+
+
+// MARK: Public Methods
+
+- (void)writeCString:(const char *)message
+{
+    [self appendBytes:message length:strlen(message)];
+}
+
+- (void)writeLine:(NSString *)line
+{
+    const char *message = line.UTF8String;
+
+    if (message)
+    {
+        [self appendBytes:message length:strlen(message)];
+    }
+}
+
+- (void)flush
+{
+    dispatch_sync(_queue, ^{
+        [self flushBuffer];
+    });
+}
+
+- (void)close
+{
+    os_unfair_lock_lock(&_lock);
+    _closed = YES;
+    os_unfair_lock_unlock(&_lock);
+
+    dispatch_sync(_queue, ^{
+        [self flushBuffer];
+
+        if (self->_fd >= 0)
+        {
+            close(self->_fd);
+            self->_fd = -1;
+        }
+    });
+}
+
++ (size_t)stripAnsiEscapes:(char *)bytes length:(size_t)length
+{
+    size_t w = 0, r = 0;
+
+    while (r < length)
+    {
+        if (bytes[r] == '\x1b' && r + 1 < length && bytes[r + 1] == '[')
+        {
+            size_t end = r + 2;
+
+            while (end < length && ((bytes[end] >= '0' && bytes[end] <= '9') || bytes[end] == ';'))
+            {
+                end++;
+            }
+
+            if (end < length && bytes[end] == 'm')
+            {
+                r = end + 1;
+
+                continue;
+            }
+        }
+
+        bytes[w++] = bytes[r++];
+    }
+
+    return w;
+}
+
+
+// MARK: Private Methods
+
+- (void)appendBytes:(const char *)bytes length:(size_t)length
+{
+    BOOL flushNow, schedule;
+
+    os_unfair_lock_lock(&_lock);
+
+    if (_closed)
+    {
+        os_unfair_lock_unlock(&_lock);
+
+        return;
+    }
+
+    NSUInteger offset = _buffer.length;
+
+    // Copy first, then strip in place, so there's no intermediate copy.
+    _buffer.length = offset + length + 1;
+    char *p = (char *)_buffer.mutableBytes + offset;
+    memcpy(p, bytes, length);
+
+    length = [self.class stripAnsiEscapes:p length:length];
+
+    if (length == 0 || p[length - 1] != '\n')
+    {
+        p[length++] = '\n';
+    }
+
+    _buffer.length = offset + length;
+
+    flushNow = _buffer.length >= self.flushThreshold;
+    schedule = !flushNow && !_flushScheduled;
+    _flushScheduled = YES;
+
+    os_unfair_lock_unlock(&_lock);
+
+    if (flushNow)
+    {
+        dispatch_async(_queue, ^{
+            [self flushBuffer];
+        });
+    }
+    else if (schedule)
+    {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.flushInterval * NSEC_PER_SEC)), _queue, ^{
+            [self flushBuffer];
+        });
+    }
+}
+
+/**
+ Needs to run on @c _queue.
+ */
+- (void)flushBuffer
+{
+    os_unfair_lock_lock(&_lock);
+
+    NSMutableData *data = _buffer;
+    _buffer = _spare ?: [NSMutableData new];
+    _spare = nil;
+    _flushScheduled = NO;
+
+    os_unfair_lock_unlock(&_lock);
+
+    if (data.length > 0)
+    {
+        [self writeData:data];
+    }
+
+    // Keep the capacity around for the next batch.
+    data.length = 0;
+
+    os_unfair_lock_lock(&_lock);
+    _spare = data;
+    os_unfair_lock_unlock(&_lock);
+}
+
+/**
+ Needs to run on @c _queue.
+ */
+- (void)writeData:(NSData *)data
+{
+    if (_maxFileSize > 0 && _fileSize > 0 && _fileSize + data.length > _maxFileSize)
+    {
+        [self rotate];
+    }
+
+    if (_fd < 0)
+    {
+        return;
+    }
+
+    const char *p = data.bytes;
+    size_t remaining = data.length;
+
+    while (remaining > 0)
+    {
+        ssize_t written = write(_fd, p, remaining);
+
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        p += written;
+        remaining -= (size_t)written;
+        _fileSize += (unsigned long long)written;
+    }
+}
+
+/**
+ Needs to run on @c _queue.
+ */
+- (void)open
+{
+    _fd = open(_url.fileSystemRepresentation, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+
+    struct stat st;
+
+    _fileSize = _fd >= 0 && fstat(_fd, &st) == 0 ? (unsigned long long)st.st_size : 0;
+}
+
+/**
+ Needs to run on @c _queue.
+ */
+- (void)rotate
+{
+    if (_fd >= 0)
+    {
+        close(_fd);
+        _fd = -1;
+    }
+
+    NSString *path = _url.path;
+
+    if (_maxFiles > 0)
+    {
+        for (NSUInteger i = _maxFiles; i > 1; i--)
+        {
+            NSString *from = [NSString stringWithFormat:@"%@.%lu", path, (unsigned long)(i - 1)];
+            NSString *to = [NSString stringWithFormat:@"%@.%lu", path, (unsigned long)i];
+
+            rename(from.fileSystemRepresentation, to.fileSystemRepresentation);
+        }
+
+        rename(path.fileSystemRepresentation, [path stringByAppendingString:@".1"].fileSystemRepresentation);
+    }
+    else {
+        unlink(path.fileSystemRepresentation);
+    }
+
+    [self open];
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
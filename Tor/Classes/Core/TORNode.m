@@ -6,6 +6,7 @@
 //
 
 #import "TORNode.h"
+#import "TORRelayIndex.h"
 #import "NSCharacterSet+PredefinedSets.h"
 
 @implementation TORNode
@@ -46,8 +47,10 @@ static NSRegularExpression *_ipv6Regex;
 
 + (NSArray<TORNode *>  * _Nonnull)parseFromNsString:(NSString * _Nullable)nsString exitOnly:(BOOL)exitOnly
 {
-    NSMutableArray<TORNode *> *nodes = [NSMutableArray new];
-    NSMutableArray<NSString *> *raw = [NSMutableArray new];
+    if (!nsString)
+    {
+        return @[];
+    }
 
     // A typical NS string for a Tor node might look like this:
     //  (Line breaks are not for readability but contained in original!)
@@ -57,35 +60,11 @@ static NSRegularExpression *_ipv6Regex;
     // s Exit Fast Running V2Dir Valid
     // w Bandwidth=37000
     //
-    // So, we watch out for a "r" line and add all lines which start with a valid prefix until the
-    // next "r" line to get the full description.
-    // But since we currently don't use the "w" line information, we ignore that as an optimization.
+    // The relay index reads the "r", "a" and "s" lines of all nodes in one pass.
 
-    for (NSString *line in [nsString componentsSeparatedByCharactersInSet:NSCharacterSet.newlineCharacterSet]) {
-        if ([line hasPrefix:@"r"])
-        {
-            if (raw.count > 0)
-            {
-                if (!exitOnly || [raw.lastObject rangeOfString:@"Exit"].location != NSNotFound)
-                {
-                    [nodes addObject:[[TORNode alloc] initFromNsString:[raw componentsJoinedByString:@"\n"]]];
-                }
-
-                raw = [[NSMutableArray alloc] initWithObjects:line, nil];
-            }
-        }
-        else if ([line hasPrefix:@"a"] || [line hasPrefix:@"s"])
-        {
-            [raw addObject:line];
-        }
-    }
+    TORRelayIndex *index = [[TORRelayIndex alloc] initWithNsString:(NSString * _Nonnull)nsString];
 
-    if (raw.count > 0 && (!exitOnly || [raw.lastObject rangeOfString:@"Exit"].location != NSNotFound))
-    {
-        [nodes addObject:[[TORNode alloc] initFromNsString:[raw componentsJoinedByString:@"\n"]]];
-    }
-
-    return nodes;
+    return [index nodesWithFlags:exitOnly ? TORRelayFlagExit : 0];
 }
 
 
@@ -114,33 +93,6 @@ static NSRegularExpression *_ipv6Regex;
     return self;
 }
 
-- (instancetype)initFromNsString:(NSString *)nsString
-{
-    self = [super init];
-
-    if (self)
-    {
-        NSRange r1 = [nsString rangeOfCharacterFromSet:NSCharacterSet.whitespaceAndNewlineCharacterSet];
-
-        if (r1.location != NSNotFound)
-        {
-            NSUInteger p1 = r1.location + r1.length;
-
-            NSRange r2 = [nsString rangeOfCharacterFromSet:NSCharacterSet.whitespaceAndNewlineCharacterSet
-                                                   options:0 range:NSMakeRange(p1, nsString.length - p1)];
-
-            if (r2.location != NSNotFound)
-            {
-                self.nickName = [nsString substringWithRange:NSMakeRange(p1, r2.location - p1)];
-            }
-        }
-
-        [self acquireIpAddressesFromNsResponse:nsString];
-    }
-
-    return self;
-}
-
 
 // MARK: Public Methods
 
@@ -0,0 +1,109 @@
+//
+//  TORRelayIndex.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+//  Documentation this class is modelled after:
+//
+//  https://spec.torproject.org/dir-spec/consensus-formats.html
+//  Section "r", "a" and "s" items of router status entries.
+
+#import <Foundation/Foundation.h>
+#import "TORNode.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The flags a relay can have in the consensus.
+ */
+typedef NS_OPTIONS(uint16_t, TORRelayFlags) {
+    TORRelayFlagAuthority     = 1 << 0,
+    TORRelayFlagBadExit       = 1 << 1,
+    TORRelayFlagExit          = 1 << 2,
+    TORRelayFlagFast          = 1 << 3,
+    TORRelayFlagGuard         = 1 << 4,
+    TORRelayFlagHSDir         = 1 << 5,
+    TORRelayFlagMiddleOnly    = 1 << 6,
+    TORRelayFlagNoEdConsensus = 1 << 7,
+    TORRelayFlagRunning       = 1 << 8,
+    TORRelayFlagStable        = 1 << 9,
+    TORRelayFlagStaleDesc     = 1 << 10,
+    TORRelayFlagSybil         = 1 << 11,
+    TORRelayFlagV2Dir         = 1 << 12,
+    TORRelayFlagValid         = 1 << 13,
+} NS_SWIFT_NAME(TorRelayFlags);
+
+/**
+ A compact, in-memory index of all relays of a network status as returned by "GETINFO ns/all".
+
+ Relays are stored as a struct of arrays: Binary identity digests, interned nicknames, binary
+ IPv4 and IPv6 addresses and flag bitsets. They are looked up by fingerprint through a hash table.
+ No objects are created per relay, unless a @c TORNode is requested.
+
+ The index is built in one streaming pass with @c parseBytes:length: and @c finish.
+ It is not thread-safe while being built, but can be read from any thread afterwards.
+ */
+NS_SWIFT_NAME(TorRelayIndex)
+@interface TORRelayIndex : NSObject
+
+/**
+ The number of relays in the index.
+ */
+@property (readonly) NSUInteger count;
+
+/**
+ Creates an index from a complete network status.
+
+ @param nsString Response from a `ns/all` call.
+ */
+- (instancetype)initWithNsString:(NSString *)nsString;
+
+/**
+ Feed the next chunk of a network status. Chunks may be split anywhere.
+
+ @param bytes The chunk.
+ @param length The length of the chunk.
+ */
+- (void)parseBytes:(const void *)bytes length:(size_t)length;
+
+/**
+ Processes an incomplete last line. Call after the last chunk.
+ */
+- (void)finish;
+
+/**
+ @param fingerprint The fingerprint of a relay as hexadecimal string with or without leading "$".
+ @return If the relay is in the index.
+ */
+- (BOOL)containsFingerprint:(NSString *)fingerprint;
+
+/**
+ @param fingerprint The fingerprint of a relay as hexadecimal string with or without leading "$".
+ @return The flags of the relay or 0, if not found.
+ */
+- (TORRelayFlags)flagsForFingerprint:(NSString *)fingerprint;
+
+/**
+ Sets the nickname, IP addresses and exit state of the given node from the index.
+
+ @param node A node with a fingerprint.
+ @return NO, if the node wasn't found in the index.
+ */
+- (BOOL)fillNode:(TORNode *)node;
+
+/**
+ @param fingerprint The fingerprint of a relay as hexadecimal string with or without leading "$".
+ @return A new @c TORNode or nil, if the relay is not in the index.
+ */
+- (nullable TORNode *)nodeForFingerprint:(NSString *)fingerprint;
+
+/**
+ @param flags Flags the relays need to have all of. 0 for all relays.
+ @return New @c TORNode objects for all relays with the given flags in the order they were parsed.
+ */
+- (NSArray<TORNode *> *)nodesWithFlags:(TORRelayFlags)flags;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,729 @@
+//
+//  TORRelayIndex.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "TORRelayIndex.h"
+
+#import <arpa/inet.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+#define TOR_DIGEST_LEN 20
+#define TOR_NO_RELAY SIZE_MAX
+
+typedef uint8_t TORDigest[TOR_DIGEST_LEN];
+typedef uint8_t TORIpv6Address[16];
+
+static const struct {
+    const char *name;
+    TORRelayFlags flag;
+} TORRelayFlagNames[] = {
+    {"Authority", TORRelayFlagAuthority},
+    {"BadExit", TORRelayFlagBadExit},
+    {"Exit", TORRelayFlagExit},
+    {"Fast", TORRelayFlagFast},
+    {"Guard", TORRelayFlagGuard},
+    {"HSDir", TORRelayFlagHSDir},
+    {"MiddleOnly", TORRelayFlagMiddleOnly},
+    {"NoEdConsensus", TORRelayFlagNoEdConsensus},
+    {"Running", TORRelayFlagRunning},
+    {"Stable", TORRelayFlagStable},
+    {"StaleDesc", TORRelayFlagStaleDesc},
+    {"Sybil", TORRelayFlagSybil},
+    {"V2Dir", TORRelayFlagV2Dir},
+    {"Valid", TORRelayFlagValid},
+};
+
+
+// MARK: Helpers
+
+static size_t TORDigestHash(const TORDigest digest)
+{
+    // The digest is a SHA-1 hash, so any part of it is evenly distributed.
+    uint32_t hash;
+    memcpy(&hash, digest, sizeof(hash));
+
+    return hash;
+}
+
+/**
+ Splits a line at spaces.
+
+ @return The number of tokens found, at most @c max.
+ */
+static size_t TORSplit(const uint8_t *p, size_t length, const uint8_t **tokens, size_t *lengths, size_t max)
+{
+    const uint8_t *end = p + length;
+    size_t count = 0;
+
+    while (p < end && count < max)
+    {
+        const uint8_t *space = memchr(p, ' ', (size_t)(end - p)) ?: end;
+
+        tokens[count] = p;
+        lengths[count] = (size_t)(space - p);
+        count++;
+
+        p = space + 1;
+    }
+
+    return count;
+}
+
+static int TORBase64Value(uint8_t c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+
+    return -1;
+}
+
+/**
+ Decodes the unpadded base64 identity of an "r" line, which is always 27 characters long.
+ */
+static BOOL TORDecodeBase64Digest(const uint8_t *p, size_t length, TORDigest digest)
+{
+    if (length < 27)
+    {
+        return NO;
+    }
+
+    uint32_t bits = 0;
+    int bitCount = 0;
+    size_t out = 0;
+
+    for (size_t i = 0; i < 27; i++)
+    {
+        int value = TORBase64Value(p[i]);
+
+        if (value < 0)
+        {
+            return NO;
+        }
+
+        bits = (bits << 6) | (uint32_t)value;
+        bitCount += 6;
+
+        if (bitCount >= 8)
+        {
+            bitCount -= 8;
+            digest[out++] = (uint8_t)(bits >> bitCount);
+        }
+    }
+
+    return out == TOR_DIGEST_LEN;
+}
+
+static int TORHexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+
+    return -1;
+}
+
+/**
+ Decodes a fingerprint like "$A1B2...", optionally followed by a nickname like "~Name".
+ */
+static BOOL TORDecodeHexDigest(const char *hex, TORDigest digest)
+{
+    if (*hex == '$')
+    {
+        hex++;
+    }
+
+    for (size_t i = 0; i < TOR_DIGEST_LEN; i++)
+    {
+        int high = TORHexValue(hex[i * 2]);
+        int low = high < 0 ? -1 : TORHexValue(hex[i * 2 + 1]);
+
+        if (low < 0)
+        {
+            return NO;
+        }
+
+        digest[i] = (uint8_t)(high << 4 | low);
+    }
+
+    char next = hex[TOR_DIGEST_LEN * 2];
+
+    return next == '\0' || next == '~' || next == '=';
+}
+
+/**
+ @return The address in host byte order or 0, if invalid.
+ */
+static uint32_t TORParseIpv4(const uint8_t *p, size_t length)
+{
+    uint32_t address = 0;
+    uint32_t octet = 0;
+    int digits = 0, dots = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (p[i] >= '0' && p[i] <= '9' && digits < 3)
+        {
+            octet = octet * 10 + (uint32_t)(p[i] - '0');
+            digits++;
+        }
+        else if (p[i] == '.' && digits > 0 && dots < 3)
+        {
+            if (octet > 255)
+            {
+                return 0;
+            }
+
+            address = address << 8 | octet;
+            octet = 0;
+            digits = 0;
+            dots++;
+        }
+        else {
+            return 0;
+        }
+    }
+
+    if (dots != 3 || digits < 1 || octet > 255)
+    {
+        return 0;
+    }
+
+    return address << 8 | octet;
+}
+
+@implementation TORRelayIndex {
+    // Struct of arrays, one entry per relay.
+    size_t _count;
+    size_t _capacity;
+    TORDigest *_ids;
+    uint32_t *_names;
+    uint32_t *_ipv4s;
+    TORIpv6Address *_ipv6s;
+    TORRelayFlags *_flags;
+
+    // Fingerprint hash table. Open addressing, contains relay index + 1, 0 is empty.
+    uint32_t *_slots;
+    size_t _slotCount;
+
+    // Interned nicknames: A length byte followed by the name. Referenced by offset.
+    uint8_t *_nameArena;
+    size_t _nameArenaLength;
+    size_t _nameArenaCapacity;
+
+    // Nickname hash table. Open addressing, contains arena offset + 1, 0 is empty.
+    uint32_t *_nameSlots;
+    size_t _nameSlotCount;
+    size_t _nameCount;
+
+    // The relay the current "a" and "s" lines belong to.
+    size_t _current;
+
+    // An incomplete line at the end of the last chunk.
+    NSMutableData *_partial;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+
+    if (self)
+    {
+        _current = TOR_NO_RELAY;
+        _partial = [NSMutableData new];
+    }
+
+    return self;
+}
+
+- (instancetype)initWithNsString:(NSString *)nsString
+{
+    self = [self init];
+
+    if (self)
+    {
+        const char *bytes = nsString.UTF8String;
+
+        if (bytes)
+        {
+            [self parseBytes:bytes length:strlen(bytes)];
+        }
+
+        [self finish];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_ids);
+    free(_names);
+    free(_ipv4s);
+    free(_ipv6s);
+    free(_flags);
+    free(_slots);
+    free(_nameArena);
+    free(_nameSlots);
+}
+
+
+// MARK: Public Properties
+
+- (NSUInteger)count
+{
+    return _count;
+}
+
+
+// MARK: Public Methods
+
+- (void)parseBytes:(const void *)bytes length:(size_t)length
+{
+    const uint8_t *p = bytes;
+    const uint8_t *end = p + length;
+
+    while (p < end)
+    {
+        const uint8_t *lf = memchr(p, '\n', (size_t)(end - p));
+
+        if (!lf)
+        {
+            [_partial appendBytes:p length:(size_t)(end - p)];
+
+            break;
+        }
+
+        if (_partial.length > 0)
+        {
+            [_partial appendBytes:p length:(size_t)(lf - p)];
+
+            [self parseLine:_partial.bytes length:_partial.length];
+
+            _partial.length = 0;
+        }
+        else {
+            [self parseLine:p length:(size_t)(lf - p)];
+        }
+
+        p = lf + 1;
+    }
+}
+
+- (void)finish
+{
+    if (_partial.length > 0)
+    {
+        [self parseLine:_partial.bytes length:_partial.length];
+
+        _partial.length = 0;
+    }
+
+    _current = TOR_NO_RELAY;
+}
+
+- (BOOL)containsFingerprint:(NSString *)fingerprint
+{
+    return [self indexOfFingerprint:fingerprint] != TOR_NO_RELAY;
+}
+
+- (TORRelayFlags)flagsForFingerprint:(NSString *)fingerprint
+{
+    size_t i = [self indexOfFingerprint:fingerprint];
+
+    return i == TOR_NO_RELAY ? 0 : _flags[i];
+}
+
+- (BOOL)fillNode:(TORNode *)node
+{
+    size_t i = node.fingerprint ? [self indexOfFingerprint:(NSString * _Nonnull)node.fingerprint] : TOR_NO_RELAY;
+
+    if (i == TOR_NO_RELAY)
+    {
+        return NO;
+    }
+
+    [self fillNode:node at:i];
+
+    return YES;
+}
+
+- (nullable TORNode *)nodeForFingerprint:(NSString *)fingerprint
+{
+    size_t i = [self indexOfFingerprint:fingerprint];
+
+    return i == TOR_NO_RELAY ? nil : [self nodeAt:i];
+}
+
+- (NSArray<TORNode *> *)nodesWithFlags:(TORRelayFlags)flags
+{
+    NSMutableArray<TORNode *> *nodes = [NSMutableArray new];
+
+    for (size_t i = 0; i < _count; i++)
+    {
+        if ((_flags[i] & flags) == flags)
+        {
+            [nodes addObject:[self nodeAt:i]];
+        }
+    }
+
+    return nodes;
+}
+
+
+// MARK: Private Methods
+
+- (void)parseLine:(const uint8_t *)line length:(size_t)length
+{
+    if (length > 0 && line[length - 1] == '\r')
+    {
+        length--;
+    }
+
+    if (length < 2 || line[1] != ' ')
+    {
+        return;
+    }
+
+    switch (line[0])
+    {
+        case 'r':
+            [self parseRouterLine:line + 2 length:length - 2];
+            break;
+
+        case 'a':
+            if (_current != TOR_NO_RELAY)
+            {
+                [self parseAddressLine:line + 2 length:length - 2];
+            }
+            break;
+
+        case 's':
+            if (_current != TOR_NO_RELAY)
+            {
+                [self parseFlagsLine:line + 2 length:length - 2];
+            }
+            break;
+    }
+}
+
+/**
+ "r" SP nickname SP identity SP digest SP publication SP IP SP ORPort SP DirPort NL
+ */
+- (void)parseRouterLine:(const uint8_t *)p length:(size_t)length
+{
+    const uint8_t *tokens[6];
+    size_t lengths[6];
+    size_t count = TORSplit(p, length, tokens, lengths, 6);
+
+    _current = TOR_NO_RELAY;
+
+    TORDigest digest;
+
+    if (count < 6 || !TORDecodeBase64Digest(tokens[1], lengths[1], digest))
+    {
+        return;
+    }
+
+    size_t i = [self indexOfDigest:digest];
+
+    if (i == TOR_NO_RELAY)
+    {
+        i = [self appendDigest:digest];
+    }
+
+    _names[i] = [self internName:tokens[0] length:MIN(lengths[0], 255)];
+    _ipv4s[i] = TORParseIpv4(tokens[5], lengths[5]);
+    memset(_ipv6s[i], 0, sizeof(TORIpv6Address));
+    _flags[i] = 0;
+
+    _current = i;
+}
+
+/**
+ "a" SP address ":" port NL, where IPv6 addresses are in square brackets.
+ */
+- (void)parseAddressLine:(const uint8_t *)p length:(size_t)length
+{
+    if (length < 2 || p[0] != '[')
+    {
+        return;
+    }
+
+    const uint8_t *close = memchr(p, ']', length);
+
+    if (!close || (size_t)(close - p - 1) >= INET6_ADDRSTRLEN)
+    {
+        return;
+    }
+
+    char buffer[INET6_ADDRSTRLEN];
+    memcpy(buffer, p + 1, (size_t)(close - p - 1));
+    buffer[close - p - 1] = '\0';
+
+    // Keep the first one only.
+    static const TORIpv6Address zero = {0};
+
+    if (memcmp(_ipv6s[_current], zero, sizeof(zero)) == 0)
+    {
+        inet_pton(AF_INET6, buffer, _ipv6s[_current]);
+    }
+}
+
+/**
+ "s" SP Flags NL, where Flags are separated by SP.
+ */
+- (void)parseFlagsLine:(const uint8_t *)p length:(size_t)length
+{
+    const uint8_t *end = p + length;
+    TORRelayFlags flags = 0;
+
+    while (p < end)
+    {
+        const uint8_t *space = memchr(p, ' ', (size_t)(end - p)) ?: end;
+        size_t tokenLength = (size_t)(space - p);
+
+        for (size_t j = 0; j < sizeof(TORRelayFlagNames) / sizeof(TORRelayFlagNames[0]); j++)
+        {
+            if (strlen(TORRelayFlagNames[j].name) == tokenLength
+                && memcmp(TORRelayFlagNames[j].name, p, tokenLength) == 0)
+            {
+                flags |= TORRelayFlagNames[j].flag;
+                break;
+            }
+        }
+
+        p = space + 1;
+    }
+
+    _flags[_current] = flags;
+}
+
+- (size_t)appendDigest:(const TORDigest)digest
+{
+    if (_count == _capacity)
+    {
+        _capacity = _capacity ? _capacity * 2 : 1024;
+
+        _ids = reallocf(_ids, _capacity * sizeof(*_ids));
+        _names = reallocf(_names, _capacity * sizeof(*_names));
+        _ipv4s = reallocf(_ipv4s, _capacity * sizeof(*_ipv4s));
+        _ipv6s = reallocf(_ipv6s, _capacity * sizeof(*_ipv6s));
+        _flags = reallocf(_flags, _capacity * sizeof(*_flags));
+
+        NSAssert(_ids && _names && _ipv4s && _ipv6s && _flags, @"Out of memory.");
+    }
+
+    size_t i = _count++;
+    memcpy(_ids[i], digest, TOR_DIGEST_LEN);
+
+    // Keep the load factor of the hash table below 50%.
+    if (_count * 2 > _slotCount)
+    {
+        [self rehash];
+    }
+    else {
+        [self insertSlot:i];
+    }
+
+    return i;
+}
+
+- (void)rehash
+{
+    free(_slots);
+
+    _slotCount = _slotCount ? _slotCount * 2 : 2048;
+    _slots = calloc(_slotCount, sizeof(*_slots));
+
+    NSAssert(_slots, @"Out of memory.");
+
+    for (size_t i = 0; i < _count; i++)
+    {
+        [self insertSlot:i];
+    }
+}
+
+- (void)insertSlot:(size_t)i
+{
+    size_t mask = _slotCount - 1;
+    size_t slot = TORDigestHash(_ids[i]) & mask;
+
+    while (_slots[slot])
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    _slots[slot] = (uint32_t)(i + 1);
+}
+
+- (size_t)indexOfDigest:(const TORDigest)digest
+{
+    if (_slotCount < 1)
+    {
+        return TOR_NO_RELAY;
+    }
+
+    size_t mask = _slotCount - 1;
+
+    for (size_t slot = TORDigestHash(digest) & mask; _slots[slot]; slot = (slot + 1) & mask)
+    {
+        size_t i = _slots[slot] - 1;
+
+        if (memcmp(_ids[i], digest, TOR_DIGEST_LEN) == 0)
+        {
+            return i;
+        }
+    }
+
+    return TOR_NO_RELAY;
+}
+
+- (size_t)indexOfFingerprint:(NSString *)fingerprint
+{
+    const char *hex = fingerprint.UTF8String;
+    TORDigest digest;
+
+    if (!hex || !TORDecodeHexDigest(hex, digest))
+    {
+        return TOR_NO_RELAY;
+    }
+
+    return [self indexOfDigest:digest];
+}
+
+/**
+ @return The offset of the (length-prefixed) name in the arena.
+ */
+- (uint32_t)internName:(const uint8_t *)name length:(size_t)length
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ name[i]) * 16777619u;
+    }
+
+    size_t mask = _nameSlotCount - 1;
+    size_t slot = 0;
+
+    if (_nameSlotCount > 0)
+    {
+        for (slot = hash & mask; _nameSlots[slot]; slot = (slot + 1) & mask)
+        {
+            uint32_t offset = _nameSlots[slot] - 1;
+
+            if (_nameArena[offset] == length && memcmp(_nameArena + offset + 1, name, length) == 0)
+            {
+                return offset;
+            }
+        }
+    }
+
+    if (_nameArenaLength + 1 + length > _nameArenaCapacity)
+    {
+        _nameArenaCapacity = MAX(_nameArenaCapacity * 2, 16384);
+        _nameArena = reallocf(_nameArena, _nameArenaCapacity);
+
+        NSAssert(_nameArena, @"Out of memory.");
+    }
+
+    uint32_t offset = (uint32_t)_nameArenaLength;
+    _nameArena[offset] = (uint8_t)length;
+    memcpy(_nameArena + offset + 1, name, length);
+    _nameArenaLength += 1 + length;
+
+    _nameCount++;
+
+    if (_nameCount * 2 > _nameSlotCount)
+    {
+        // Grow and re-insert all names, including the new one.
+        free(_nameSlots);
+
+        _nameSlotCount = _nameSlotCount ? _nameSlotCount * 2 : 2048;
+        _nameSlots = calloc(_nameSlotCount, sizeof(*_nameSlots));
+
+        NSAssert(_nameSlots, @"Out of memory.");
+
+        mask = _nameSlotCount - 1;
+
+        for (size_t o = 0; o < _nameArenaLength; o += 1 + _nameArena[o])
+        {
+            uint32_t h = 2166136261u;
+
+            for (size_t i = 0; i < _nameArena[o]; i++)
+            {
+                h = (h ^ _nameArena[o + 1 + i]) * 16777619u;
+            }
+
+            size_t s = h & mask;
+
+            while (_nameSlots[s])
+            {
+                s = (s + 1) & mask;
+            }
+
+            _nameSlots[s] = (uint32_t)(o + 1);
+        }
+    }
+    else {
+        _nameSlots[slot] = offset + 1;
+    }
+
+    return offset;
+}
+
+- (void)fillNode:(TORNode *)node at:(size_t)i
+{
+    node.nickName = [[NSString alloc] initWithBytes:_nameArena + _names[i] + 1 length:_nameArena[_names[i]]
+                                           encoding:NSUTF8StringEncoding];
+
+    char buffer[INET6_ADDRSTRLEN];
+
+    if (_ipv4s[i])
+    {
+        struct in_addr addr = { .s_addr = htonl(_ipv4s[i]) };
+
+        if (inet_ntop(AF_INET, &addr, buffer, sizeof(buffer)))
+        {
+            node.ipv4Address = @(buffer);
+        }
+    }
+
+    static const TORIpv6Address zero = {0};
+
+    if (memcmp(_ipv6s[i], zero, sizeof(zero)) != 0 && inet_ntop(AF_INET6, _ipv6s[i], buffer, sizeof(buffer)))
+    {
+        node.ipv6Address = @(buffer);
+    }
+
+    node.isExit = (_flags[i] & TORRelayFlagExit) == TORRelayFlagExit;
+}
+
+- (TORNode *)nodeAt:(size_t)i
+{
+    char fingerprint[2 + TOR_DIGEST_LEN * 2];
+    fingerprint[0] = '$';
+
+    for (size_t j = 0; j < TOR_DIGEST_LEN; j++)
+    {
+        snprintf(fingerprint + 1 + j * 2, 3, "%02X", _ids[i][j]);
+    }
+
+    TORNode *node = [TORNode new];
+    node.fingerprint = @(fingerprint);
+
+    [self fillNode:node at:i];
+
+    return node;
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
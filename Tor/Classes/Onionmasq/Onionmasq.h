@@ -7,15 +7,32 @@
 
 #import <Foundation/Foundation.h>
 #import <Tor/TORConfiguration.h>
+#import "OnionmasqEvent.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
 @interface Onionmasq : NSObject
 
 
+/**
+ A packet Onionmasq wants to write to the TUN interface.
+
+ The bytes are only valid during the call of the `BatchWriterCb`. Copy them, if you need them longer.
+ */
+typedef struct {
+    const uint8_t *bytes;
+    size_t length;
+    /**
+     The IP version of the packet. (4 or 6)
+     */
+    uint8_t version;
+} OnionmasqPacket;
+
 typedef void (^ReaderCb)(void);
 typedef bool (^WriterCb)(NSData *packet, NSNumber *version);
+typedef void (^BatchWriterCb)(const OnionmasqPacket *packets, NSUInteger count);
 typedef void (^EventCb)(id);
+typedef void (^TypedEventCb)(OnionmasqEvent *event);
 typedef void (^LogCb)(NSString *message);
 
 /**
@@ -37,6 +54,52 @@ typedef void (^LogCb)(NSString *message);
                 onEvent:(nullable EventCb)eventCallback
                   onLog:(nullable LogCb)logCallback;
 
+/**
+ Start Onionmasq with a writer, which receives outgoing packets in batches.
+
+ Outgoing packets are copied into a preallocated arena instead of individual `NSData` objects and handed
+ to the writer in batches, on a private serial queue, as soon as it's free. Use this on busy TUN interfaces
+ to avoid the per-packet allocation and block invocation overhead of the `WriterCb`.
+
+ @param readerCallback Called, when Onionmasq wants to read to the TUN interface. After read, this method **needs to call** one of the `receive` methods!
+ @param batchWriterCallback Called with a batch of packets, when Onionmasq wants to write to the TUN interface.
+ @param stateDir Directory, where Arti can store its state. OPTIONAL. If not provided, will use \c Library/Application \c Support/org.torproject.Arti.
+ @param cacheDir Directory, where Arti can store its caching data. OPTIONAL. If not providied, will use \c Library/Cache/org.torproject.Arti.
+ @param pcapFile File to write a network trace in PCAP format to.
+ @param eventCallback Callback, when an event happens.
+ @param logCallback Callback, when a log message arrives.
+ */
++ (void)startWithReader:(ReaderCb)readerCallback
+            batchWriter:(BatchWriterCb)batchWriterCallback
+               stateDir:(NSURL * _Nullable)stateDir
+               cacheDir:(NSURL * _Nullable)cacheDir
+               pcapFile:(NSURL * _Nullable)pcapFile
+                onEvent:(nullable EventCb)eventCallback
+                  onLog:(nullable LogCb)logCallback;
+
+/**
+ Start Onionmasq with a writer, which receives outgoing packets in batches, and typed events.
+
+ Events of types not contained in `eventMask` are dropped without being parsed.
+
+ @param readerCallback Called, when Onionmasq wants to read to the TUN interface. After read, this method **needs to call** one of the `receive` methods!
+ @param batchWriterCallback Called with a batch of packets, when Onionmasq wants to write to the TUN interface.
+ @param stateDir Directory, where Arti can store its state. OPTIONAL. If not provided, will use \c Library/Application \c Support/org.torproject.Arti.
+ @param cacheDir Directory, where Arti can store its caching data. OPTIONAL. If not providied, will use \c Library/Cache/org.torproject.Arti.
+ @param pcapFile File to write a network trace in PCAP format to.
+ @param eventMask The types of events to call `eventCallback` for.
+ @param eventCallback Callback, when an event of a type in `eventMask` happens.
+ @param logCallback Callback, when a log message arrives.
+ */
++ (void)startWithReader:(ReaderCb)readerCallback
+            batchWriter:(BatchWriterCb)batchWriterCallback
+               stateDir:(NSURL * _Nullable)stateDir
+               cacheDir:(NSURL * _Nullable)cacheDir
+               pcapFile:(NSURL * _Nullable)pcapFile
+                 events:(OnionmasqEventType)eventMask
+                onEvent:(nullable TypedEventCb)eventCallback
+                  onLog:(nullable LogCb)logCallback;
+
 /**
  Stop Onionmasq.
  */
@@ -82,6 +145,33 @@ typedef void (^LogCb)(NSString *message);
  */
 + (void)receive:(NSArray<NSData *> *)packets;
 
+/**
+ You need to call this, when your `readerCallback` has read data from the TUN device.
+
+ The packets are handed over without copying and can be reused, as soon as this method returns.
+
+ @param packets Pointers to the packets.
+ @param lengths The lengths of the packets.
+ @param count The number of packets.
+ */
++ (void)receivePackets:(const uint8_t * _Nonnull const * _Nonnull)packets
+               lengths:(const size_t *)lengths
+                 count:(NSUInteger)count;
+
+/**
+ You need to call this, when your `readerCallback` has read data from the TUN device.
+
+ Use this, when you read multiple packets into one buffer, back to back.
+ The arena is handed over without copying and can be reused, as soon as this method returns.
+
+ @param arena A buffer containing all packets, back to back.
+ @param lengths The lengths of the packets.
+ @param count The number of packets.
+ */
++ (void)receiveArena:(const uint8_t *)arena
+             lengths:(const size_t *)lengths
+               count:(NSUInteger)count;
+
 
 @end
 
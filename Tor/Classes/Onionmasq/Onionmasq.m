@@ -8,6 +8,19 @@
 #import "Onionmasq.h"
 #import "onionmasq_apple.h"
 
+#import <os/lock.h>
+
+// Sized for a burst of full-MTU packets.
+#define ONIONMASQ_ARENA_SIZE (256 * 1024)
+#define ONIONMASQ_ARENA_PACKETS 512
+
+typedef struct {
+    uint8_t *bytes;
+    size_t used;
+    OnionmasqPacket *packets;
+    NSUInteger count;
+} OnionmasqArena;
+
 @implementation Onionmasq
 
 BOOL initialized;
@@ -18,10 +31,42 @@ WriterCb writerBlock;
 
 EventCb eventBlock;
 
+TypedEventCb typedEventBlock;
+
+OnionmasqEventType typedEventMask;
+
 LogCb logBlock;
 
 NSRegularExpression *regex;
 
+BatchWriterCb batchWriterBlock;
+
+dispatch_queue_t batchWriterQueue;
+
+// Outgoing packets are collected in the active arena, while the other one is
+// handed to the batch writer. Guarded by arenaLock.
+OnionmasqArena arenas[2];
+
+NSUInteger activeArena;
+
+BOOL flushScheduled;
+
+os_unfair_lock arenaLock = OS_UNFAIR_LOCK_INIT;
+
+// Reused by the receive methods, instead of building arrays on the stack,
+// which can overflow on big bursts. Guarded by receiveLock.
+const uint8_t **receivePointers;
+
+unsigned long *receiveLengths;
+
+NSUInteger receiveCapacity;
+
+os_unfair_lock receiveLock = OS_UNFAIR_LOCK_INIT;
+
+static void reserveReceiveBuffers(NSUInteger count);
+static void flushArena(void);
+static bool batchWriterCb(const uint8_t *packet, size_t len);
+
 + (void)startWithReader:(ReaderCb)readerCallback
                  writer:(WriterCb)writerCallback
                stateDir:(NSURL * _Nullable)stateDir
@@ -30,9 +75,90 @@ NSRegularExpression *regex;
                 onEvent:(nullable EventCb)eventCallback
                   onLog:(nullable LogCb)logCallback
 {
+    [self startWithReader:readerCallback
+                   writer:writerCallback
+              batchWriter:nil
+                 stateDir:stateDir
+                 cacheDir:cacheDir
+                 pcapFile:pcapFile
+                   events:0
+                  onEvent:eventCallback
+             onTypedEvent:nil
+                    onLog:logCallback];
+}
+
++ (void)startWithReader:(ReaderCb)readerCallback
+            batchWriter:(BatchWriterCb)batchWriterCallback
+               stateDir:(NSURL * _Nullable)stateDir
+               cacheDir:(NSURL * _Nullable)cacheDir
+               pcapFile:(NSURL * _Nullable)pcapFile
+                onEvent:(nullable EventCb)eventCallback
+                  onLog:(nullable LogCb)logCallback
+{
+    [self startWithReader:readerCallback
+                   writer:nil
+              batchWriter:batchWriterCallback
+                 stateDir:stateDir
+                 cacheDir:cacheDir
+                 pcapFile:pcapFile
+                   events:0
+                  onEvent:eventCallback
+             onTypedEvent:nil
+                    onLog:logCallback];
+}
+
++ (void)startWithReader:(ReaderCb)readerCallback
+            batchWriter:(BatchWriterCb)batchWriterCallback
+               stateDir:(NSURL * _Nullable)stateDir
+               cacheDir:(NSURL * _Nullable)cacheDir
+               pcapFile:(NSURL * _Nullable)pcapFile
+                 events:(OnionmasqEventType)eventMask
+                onEvent:(nullable TypedEventCb)eventCallback
+                  onLog:(nullable LogCb)logCallback
+{
+    [self startWithReader:readerCallback
+                   writer:nil
+              batchWriter:batchWriterCallback
+                 stateDir:stateDir
+                 cacheDir:cacheDir
+                 pcapFile:pcapFile
+                   events:eventMask
+                  onEvent:nil
+             onTypedEvent:eventCallback
+                    onLog:logCallback];
+}
+
++ (void)startWithReader:(ReaderCb)readerCallback
+                 writer:(nullable WriterCb)writerCallback
+            batchWriter:(nullable BatchWriterCb)batchWriterCallback
+               stateDir:(NSURL * _Nullable)stateDir
+               cacheDir:(NSURL * _Nullable)cacheDir
+               pcapFile:(NSURL * _Nullable)pcapFile
+                 events:(OnionmasqEventType)eventMask
+                onEvent:(nullable EventCb)eventCallback
+           onTypedEvent:(nullable TypedEventCb)typedEventCallback
+                  onLog:(nullable LogCb)logCallback
+{
+    if (batchWriterCallback)
+    {
+        static dispatch_once_t onceToken;
+        dispatch_once(&onceToken, ^{
+            batchWriterQueue = dispatch_queue_create("org.torproject.Onionmasq.writer", DISPATCH_QUEUE_SERIAL);
+
+            for (int i = 0; i < 2; i++)
+            {
+                arenas[i].bytes = malloc(ONIONMASQ_ARENA_SIZE);
+                arenas[i].packets = malloc(ONIONMASQ_ARENA_PACKETS * sizeof(OnionmasqPacket));
+            }
+        });
+    }
+
     readerBlock = readerCallback;
     writerBlock = writerCallback;
+    batchWriterBlock = batchWriterCallback;
     eventBlock = eventCallback;
+    typedEventBlock = typedEventCallback;
+    typedEventMask = typedEventCallback ? eventMask : 0;
     logBlock = logCallback;
 
     NSFileManager *fm = NSFileManager.defaultManager;
@@ -71,9 +197,20 @@ NSRegularExpression *regex;
 {
     closeProxy();
 
+    if (batchWriterQueue)
+    {
+        // Deliver, what's left.
+        dispatch_sync(batchWriterQueue, ^{
+            flushArena();
+        });
+    }
+
     readerBlock = nil;
     writerBlock = nil;
+    batchWriterBlock = nil;
     eventBlock = nil;
+    typedEventBlock = nil;
+    typedEventMask = 0;
     logBlock = nil;
 }
 
@@ -118,15 +255,150 @@ NSRegularExpression *regex;
 
 + (void)receive:(NSArray<NSData *> *)packets
 {
-    const uint8_t * pointers[packets.count];
-    unsigned long lens[packets.count];
+    NSUInteger count = packets.count;
+
+    os_unfair_lock_lock(&receiveLock);
 
-    for (NSUInteger i = 0; i < packets.count; i++) {
-        pointers[i] = packets[i].bytes;
-        lens[i] = packets[i].length;
+    reserveReceiveBuffers(count);
+
+    for (NSUInteger i = 0; i < count; i++) {
+        receivePointers[i] = packets[i].bytes;
+        receiveLengths[i] = packets[i].length;
     }
 
-    receive(pointers, lens, packets.count);
+    receive(receivePointers, receiveLengths, count);
+
+    os_unfair_lock_unlock(&receiveLock);
+}
+
++ (void)receivePackets:(const uint8_t * _Nonnull const * _Nonnull)packets
+               lengths:(const size_t *)lengths
+                 count:(NSUInteger)count
+{
+    // size_t and unsigned long are the same on all Apple platforms, so no need to convert.
+    receive((const uint8_t **)packets, (const unsigned long *)lengths, count);
+}
+
++ (void)receiveArena:(const uint8_t *)arena
+             lengths:(const size_t *)lengths
+               count:(NSUInteger)count
+{
+    os_unfair_lock_lock(&receiveLock);
+
+    reserveReceiveBuffers(count);
+
+    size_t offset = 0;
+
+    for (NSUInteger i = 0; i < count; i++) {
+        receivePointers[i] = arena + offset;
+        offset += lengths[i];
+    }
+
+    receive(receivePointers, (const unsigned long *)lengths, count);
+
+    os_unfair_lock_unlock(&receiveLock);
+}
+
+
+/**
+ Grows the reused receive buffers, if needed. Needs `receiveLock` to be held.
+ */
+static void reserveReceiveBuffers(NSUInteger count)
+{
+    if (count <= receiveCapacity)
+    {
+        return;
+    }
+
+    receiveCapacity = MAX(count, MAX(receiveCapacity * 2, 64));
+    receivePointers = reallocf(receivePointers, receiveCapacity * sizeof(*receivePointers));
+    receiveLengths = reallocf(receiveLengths, receiveCapacity * sizeof(*receiveLengths));
+
+    assert(receivePointers && receiveLengths);
+}
+
+/**
+ Hands the active arena to the batch writer and makes the other one active. Needs to run on `batchWriterQueue`.
+ */
+static void flushArena(void)
+{
+    os_unfair_lock_lock(&arenaLock);
+
+    OnionmasqArena *arena = &arenas[activeArena];
+    activeArena ^= 1;
+    flushScheduled = NO;
+
+    os_unfair_lock_unlock(&arenaLock);
+
+    if (arena->count > 0 && batchWriterBlock)
+    {
+        batchWriterBlock(arena->packets, arena->count);
+    }
+
+    // Only ever touched here and under the lock while active, so safe to reset outside of the lock.
+    arena->used = 0;
+    arena->count = 0;
+}
+
+static bool batchWriterCb(const uint8_t *packet, size_t len)
+{
+    uint8_t version = len > 0 ? packet[0] >> 4 : 0;
+
+    // Doesn't fit into any arena: Deliver everything before, then this one without copying.
+    if (len > ONIONMASQ_ARENA_SIZE)
+    {
+        dispatch_sync(batchWriterQueue, ^{
+            flushArena();
+
+            OnionmasqPacket p = {packet, len, version};
+
+            if (batchWriterBlock)
+            {
+                batchWriterBlock(&p, 1);
+            }
+        });
+
+        return true;
+    }
+
+    os_unfair_lock_lock(&arenaLock);
+
+    OnionmasqArena *arena = &arenas[activeArena];
+
+    // Full: Wait for the writer to finish the other arena and swap.
+    while (arena->count == ONIONMASQ_ARENA_PACKETS || arena->used + len > ONIONMASQ_ARENA_SIZE)
+    {
+        os_unfair_lock_unlock(&arenaLock);
+
+        dispatch_sync(batchWriterQueue, ^{
+            flushArena();
+        });
+
+        os_unfair_lock_lock(&arenaLock);
+
+        arena = &arenas[activeArena];
+    }
+
+    uint8_t *bytes = arena->bytes + arena->used;
+    memcpy(bytes, packet, len);
+
+    arena->packets[arena->count++] = (OnionmasqPacket){bytes, len, version};
+    arena->used += len;
+
+    BOOL schedule = !flushScheduled;
+    flushScheduled = YES;
+
+    os_unfair_lock_unlock(&arenaLock);
+
+    // Coalesces all packets arriving until the writer queue gets to it.
+    if (schedule)
+    {
+        dispatch_async(batchWriterQueue, ^{
+            flushArena();
+        });
+    }
+
+    return true;
 }
 
 
@@ -140,6 +412,11 @@ void readerCb(void)
 
 bool writerCb(const uint8_t *packet, size_t len)
 {
+    if (batchWriterBlock)
+    {
+        return batchWriterCb(packet, len);
+    }
+
     if (writerBlock)
     {
         NSData *data = [[NSData alloc] initWithBytes:packet length:len];
@@ -155,21 +432,28 @@ bool writerCb(const uint8_t *packet, size_t len)
 
 void eventCb(const char * event)
 {
-    if (eventBlock)
+    if (typedEventBlock)
     {
-        NSString *evt = [[NSString alloc] initWithUTF8String:event];
-        NSData *data = [evt dataUsingEncoding:NSUTF8StringEncoding];
-        NSError *error = nil;
-
-        id object = [NSJSONSerialization JSONObjectWithData:data options:0 error:&error];
+        // Only parsed, if the type is in the mask.
+        OnionmasqEvent *evt = [OnionmasqEvent eventFromCString:event mask:typedEventMask];
 
-        if (error)
+        if (evt)
         {
-            eventBlock(evt);
+            typedEventBlock(evt);
         }
-        else {
-            eventBlock(object);
+    }
+
+    if (eventBlock)
+    {
+        id object = [OnionmasqEvent JSONObjectFromCString:event];
+
+        // Like NSJSONSerialization without fragments allowed: Only objects and arrays.
+        if (![object isKindOfClass:NSDictionary.class] && ![object isKindOfClass:NSArray.class])
+        {
+            object = [[NSString alloc] initWithUTF8String:event];
         }
+
+        eventBlock(object);
     }
 }
 
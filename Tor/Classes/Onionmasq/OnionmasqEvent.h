@@ -0,0 +1,72 @@
+//
+//  OnionmasqEvent.h
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ The types of events Onionmasq sends.
+ */
+typedef NS_OPTIONS(NSUInteger, OnionmasqEventType) {
+    OnionmasqEventTypeBootstrap        = 1 << 0,
+    OnionmasqEventTypeNewConnection    = 1 << 1,
+    OnionmasqEventTypeFailedConnection = 1 << 2,
+    OnionmasqEventTypeClosedConnection = 1 << 3,
+    OnionmasqEventTypeNewDirectory     = 1 << 4,
+    /**
+     Any event type, which isn't known, yet.
+     */
+    OnionmasqEventTypeOther            = 1 << 5,
+
+    OnionmasqEventTypeConnection       = OnionmasqEventTypeNewConnection | OnionmasqEventTypeFailedConnection | OnionmasqEventTypeClosedConnection,
+    OnionmasqEventTypeAll              = NSUIntegerMax,
+};
+
+/**
+ An event sent by Onionmasq.
+
+ Onionmasq sends events as JSON. These are decoded by a small purpose-built parser, which first
+ only looks at the type, so events nobody is interested in are dropped without being parsed.
+ */
+@interface OnionmasqEvent : NSObject
+
+/**
+ The type of this event.
+ */
+@property (readonly) OnionmasqEventType type;
+
+/**
+ The type of this event as sent by Onionmasq, e.g. "BootstrapStatus".
+ */
+@property (readonly) NSString *name;
+
+/**
+ The fields of this event.
+ */
+@property (readonly) NSDictionary<NSString *, id> *payload;
+
+- (instancetype)init NS_UNAVAILABLE;
+
+/**
+ @param json A JSON encoded event as sent by Onionmasq.
+ @param mask The types of events to decode.
+ @return nil, if the event isn't of one of the types in the given mask or isn't valid JSON.
+ */
++ (nullable instancetype)eventFromCString:(const char *)json mask:(OnionmasqEventType)mask;
+
+/**
+ Decodes JSON into Foundation objects, like `NSJSONSerialization` does, but without going through `NSData`.
+
+ @param json A NUL-terminated, UTF-8 encoded JSON document.
+ @return nil, if the given string isn't valid JSON.
+ */
++ (nullable id)JSONObjectFromCString:(const char *)json;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,665 @@
+//
+//  OnionmasqEvent.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import "OnionmasqEvent.h"
+
+#import <errno.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Events are flat. Just protect the stack against garbage.
+#define ONIONMASQ_JSON_MAX_DEPTH 32
+
+
+// MARK: JSON Parser
+
+static id _Nullable OnionmasqParseValue(const char **p, int depth);
+
+static void OnionmasqSkipWhitespace(const char **p)
+{
+    while (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r')
+    {
+        (*p)++;
+    }
+}
+
+/**
+ Finds the end of a string without decoding it.
+
+ @param p Needs to point to the opening quote. Will point behind the closing quote afterwards.
+ @param start Will point to the first character of the string.
+ @param length Will contain the length of the raw string.
+ @return NO, if the string isn't terminated or contains escapes.
+ */
+static BOOL OnionmasqScanRawString(const char **p, const char **start, size_t *length)
+{
+    const char *s = *p + 1;
+    const char *e = s;
+
+    while (*e && *e != '"' && *e != '\\')
+    {
+        e++;
+    }
+
+    if (*e != '"')
+    {
+        return NO;
+    }
+
+    *start = s;
+    *length = (size_t)(e - s);
+    *p = e + 1;
+
+    return YES;
+}
+
+static int OnionmasqHexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+    return -1;
+}
+
+static BOOL OnionmasqParseHex4(const char *p, uint32_t *value)
+{
+    *value = 0;
+
+    for (int i = 0; i < 4; i++)
+    {
+        int v = OnionmasqHexValue(p[i]);
+
+        if (v < 0)
+        {
+            return NO;
+        }
+
+        *value = *value << 4 | (uint32_t)v;
+    }
+
+    return YES;
+}
+
+static size_t OnionmasqEncodeUtf8(uint32_t c, char *out)
+{
+    if (c < 0x80)
+    {
+        out[0] = (char)c;
+
+        return 1;
+    }
+
+    if (c < 0x800)
+    {
+        out[0] = (char)(0xc0 | c >> 6);
+        out[1] = (char)(0x80 | (c & 0x3f));
+
+        return 2;
+    }
+
+    if (c < 0x10000)
+    {
+        out[0] = (char)(0xe0 | c >> 12);
+        out[1] = (char)(0x80 | (c >> 6 & 0x3f));
+        out[2] = (char)(0x80 | (c & 0x3f));
+
+        return 3;
+    }
+
+    out[0] = (char)(0xf0 | c >> 18);
+    out[1] = (char)(0x80 | (c >> 12 & 0x3f));
+    out[2] = (char)(0x80 | (c >> 6 & 0x3f));
+    out[3] = (char)(0x80 | (c & 0x3f));
+
+    return 4;
+}
+
+static NSString * _Nullable OnionmasqParseString(const char **p)
+{
+    const char *start;
+    size_t length;
+
+    // Fast path: Most strings don't contain escapes.
+    if (OnionmasqScanRawString(p, &start, &length))
+    {
+        return [[NSString alloc] initWithBytes:start length:length encoding:NSUTF8StringEncoding];
+    }
+
+    NSMutableData *buffer = [NSMutableData new];
+    const char *s = *p + 1;
+
+    while (*s != '"')
+    {
+        if (!*s)
+        {
+            return nil;
+        }
+
+        if (*s != '\\')
+        {
+            const char *e = s;
+
+            while (*e && *e != '"' && *e != '\\')
+            {
+                e++;
+            }
+
+            [buffer appendBytes:s length:(size_t)(e - s)];
+            s = e;
+
+            continue;
+        }
+
+        char c;
+
+        switch (s[1])
+        {
+            case '"': c = '"'; break;
+            case '\\': c = '\\'; break;
+            case '/': c = '/'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+
+            case 'u': {
+                uint32_t code;
+
+                if (!OnionmasqParseHex4(s + 2, &code))
+                {
+                    return nil;
+                }
+
+                s += 6;
+
+                // Surrogate pair.
+                if (code >= 0xd800 && code < 0xdc00 && s[0] == '\\' && s[1] == 'u')
+                {
+                    uint32_t low;
+
+                    if (OnionmasqParseHex4(s + 2, &low) && low >= 0xdc00 && low < 0xe000)
+                    {
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                        s += 6;
+                    }
+                }
+
+                char utf8[4];
+                [buffer appendBytes:utf8 length:OnionmasqEncodeUtf8(code, utf8)];
+
+                continue;
+            }
+
+            default:
+                return nil;
+        }
+
+        [buffer appendBytes:&c length:1];
+        s += 2;
+    }
+
+    *p = s + 1;
+
+    return [[NSString alloc] initWithData:buffer encoding:NSUTF8StringEncoding];
+}
+
+static BOOL OnionmasqSkipDigits(const char **s)
+{
+    const char *start = *s;
+
+    while (**s >= '0' && **s <= '9')
+    {
+        (*s)++;
+    }
+
+    return *s > start;
+}
+
+/**
+ Follows JSON's number grammar strictly, so neither leading zeros nor a lone "." or "e" pass.
+
+ Integers, which don't fit into 64 bits, are returned as doubles, like @c NSJSONSerialization does.
+ */
+static NSNumber * _Nullable OnionmasqParseNumber(const char **p)
+{
+    const char *s = *p;
+    BOOL isFloat = NO;
+
+    if (*s == '-')
+    {
+        s++;
+    }
+
+    if (*s == '0')
+    {
+        s++;
+    }
+    else if (!OnionmasqSkipDigits(&s))
+    {
+        return nil;
+    }
+
+    if (*s == '.')
+    {
+        s++;
+        isFloat = YES;
+
+        if (!OnionmasqSkipDigits(&s))
+        {
+            return nil;
+        }
+    }
+
+    if (*s == 'e' || *s == 'E')
+    {
+        s++;
+        isFloat = YES;
+
+        if (*s == '+' || *s == '-')
+        {
+            s++;
+        }
+
+        if (!OnionmasqSkipDigits(&s))
+        {
+            return nil;
+        }
+    }
+
+    // Leading zeros, like "01", end the number after the "0".
+    if (*s >= '0' && *s <= '9')
+    {
+        return nil;
+    }
+
+    NSNumber *number;
+
+    if (!isFloat)
+    {
+        errno = 0;
+        long long value = strtoll(*p, NULL, 10);
+
+        if (errno != ERANGE)
+        {
+            number = @(value);
+        }
+    }
+
+    if (!number)
+    {
+        number = @(strtod(*p, NULL));
+    }
+
+    *p = s;
+
+    return number;
+}
+
+static NSDictionary * _Nullable OnionmasqParseObject(const char **p, int depth)
+{
+    NSMutableDictionary *object = [NSMutableDictionary new];
+
+    (*p)++;
+    OnionmasqSkipWhitespace(p);
+
+    if (**p == '}')
+    {
+        (*p)++;
+
+        return object;
+    }
+
+    while (YES)
+    {
+        if (**p != '"')
+        {
+            return nil;
+        }
+
+        NSString *key = OnionmasqParseString(p);
+
+        OnionmasqSkipWhitespace(p);
+
+        if (!key || **p != ':')
+        {
+            return nil;
+        }
+
+        (*p)++;
+
+        id value = OnionmasqParseValue(p, depth + 1);
+
+        if (!value)
+        {
+            return nil;
+        }
+
+        object[key] = value;
+
+        OnionmasqSkipWhitespace(p);
+
+        if (**p == ',')
+        {
+            (*p)++;
+            OnionmasqSkipWhitespace(p);
+
+            continue;
+        }
+
+        if (**p == '}')
+        {
+            (*p)++;
+
+            return object;
+        }
+
+        return nil;
+    }
+}
+
+static NSArray * _Nullable OnionmasqParseArray(const char **p, int depth)
+{
+    NSMutableArray *array = [NSMutableArray new];
+
+    (*p)++;
+    OnionmasqSkipWhitespace(p);
+
+    if (**p == ']')
+    {
+        (*p)++;
+
+        return array;
+    }
+
+    while (YES)
+    {
+        id value = OnionmasqParseValue(p, depth + 1);
+
+        if (!value)
+        {
+            return nil;
+        }
+
+        [array addObject:value];
+
+        OnionmasqSkipWhitespace(p);
+
+        if (**p == ',')
+        {
+            (*p)++;
+
+            continue;
+        }
+
+        if (**p == ']')
+        {
+            (*p)++;
+
+            return array;
+        }
+
+        return nil;
+    }
+}
+
+static id _Nullable OnionmasqParseValue(const char **p, int depth)
+{
+    if (depth > ONIONMASQ_JSON_MAX_DEPTH)
+    {
+        return nil;
+    }
+
+    OnionmasqSkipWhitespace(p);
+
+    switch (**p)
+    {
+        case '{':
+            return OnionmasqParseObject(p, depth);
+
+        case '[':
+            return OnionmasqParseArray(p, depth);
+
+        case '"':
+            return OnionmasqParseString(p);
+
+        case 't':
+            if (strncmp(*p, "true", 4) == 0)
+            {
+                *p += 4;
+
+                return @YES;
+            }
+
+            return nil;
+
+        case 'f':
+            if (strncmp(*p, "false", 5) == 0)
+            {
+                *p += 5;
+
+                return @NO;
+            }
+
+            return nil;
+
+        case 'n':
+            if (strncmp(*p, "null", 4) == 0)
+            {
+                *p += 4;
+
+                return NSNull.null;
+            }
+
+            return nil;
+
+        default:
+            return OnionmasqParseNumber(p);
+    }
+}
+
+
+// MARK: Type Detection
+
+static OnionmasqEventType OnionmasqTypeFromName(const char *name, size_t length)
+{
+    static const struct {
+        const char *name;
+        OnionmasqEventType type;
+    } types[] = {
+        {"BootstrapStatus", OnionmasqEventTypeBootstrap},
+        {"NewConnection", OnionmasqEventTypeNewConnection},
+        {"FailedConnection", OnionmasqEventTypeFailedConnection},
+        {"ClosedConnection", OnionmasqEventTypeClosedConnection},
+        {"NewDirectory", OnionmasqEventTypeNewDirectory},
+    };
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+    {
+        if (strlen(types[i].name) == length && memcmp(types[i].name, name, length) == 0)
+        {
+            return types[i].type;
+        }
+    }
+
+    return OnionmasqEventTypeOther;
+}
+
+typedef NS_ENUM(NSUInteger, OnionmasqTagging) {
+    // Unknown, the whole event needs to be parsed to find the type.
+    OnionmasqTaggingUnknown,
+    // `"Name"`
+    OnionmasqTaggingUnit,
+    // `{"type": "Name", ...}`
+    OnionmasqTaggingInternal,
+    // `{"Name": {...}}`
+    OnionmasqTaggingExternal,
+};
+
+/**
+ Finds the name of an event by only looking at its beginning, without allocating anything.
+ */
+static OnionmasqTagging OnionmasqScanName(const char *json, const char **name, size_t *length)
+{
+    const char *p = json;
+
+    OnionmasqSkipWhitespace(&p);
+
+    if (*p == '"')
+    {
+        return OnionmasqScanRawString(&p, name, length) ? OnionmasqTaggingUnit : OnionmasqTaggingUnknown;
+    }
+
+    if (*p != '{')
+    {
+        return OnionmasqTaggingUnknown;
+    }
+
+    p++;
+    OnionmasqSkipWhitespace(&p);
+
+    const char *key;
+    size_t keyLength;
+
+    if (*p != '"' || !OnionmasqScanRawString(&p, &key, &keyLength))
+    {
+        return OnionmasqTaggingUnknown;
+    }
+
+    OnionmasqSkipWhitespace(&p);
+
+    if (*p != ':')
+    {
+        return OnionmasqTaggingUnknown;
+    }
+
+    p++;
+    OnionmasqSkipWhitespace(&p);
+
+    if (keyLength == 4 && memcmp(key, "type", 4) == 0 && *p == '"')
+    {
+        return OnionmasqScanRawString(&p, name, length) ? OnionmasqTaggingInternal : OnionmasqTaggingUnknown;
+    }
+
+    if (*p == '{')
+    {
+        *name = key;
+        *length = keyLength;
+
+        return OnionmasqTaggingExternal;
+    }
+
+    return OnionmasqTaggingUnknown;
+}
+
+
+@implementation OnionmasqEvent
+
++ (nullable instancetype)eventFromCString:(const char *)json mask:(OnionmasqEventType)mask
+{
+    const char *name = NULL;
+    size_t length = 0;
+
+    OnionmasqTagging tagging = OnionmasqScanName(json, &name, &length);
+
+    if (tagging != OnionmasqTaggingUnknown)
+    {
+        OnionmasqEventType type = OnionmasqTypeFromName(name, length);
+
+        // Not interested: Nothing allocated, nothing parsed.
+        if (!(mask & type))
+        {
+            return nil;
+        }
+
+        NSString *nameString = [[NSString alloc] initWithBytes:name length:length encoding:NSUTF8StringEncoding];
+
+        if (tagging == OnionmasqTaggingUnit)
+        {
+            return [[self alloc] initWithType:type name:nameString payload:@{}];
+        }
+
+        NSDictionary *object = [self JSONObjectFromCString:json];
+
+        if (![object isKindOfClass:NSDictionary.class])
+        {
+            return nil;
+        }
+
+        if (tagging == OnionmasqTaggingExternal)
+        {
+            object = object[nameString];
+
+            if (![object isKindOfClass:NSDictionary.class])
+            {
+                return nil;
+            }
+        }
+
+        return [[self alloc] initWithType:type name:nameString payload:object];
+    }
+
+    // Unusual layout, need to parse everything first.
+    NSDictionary *object = [self JSONObjectFromCString:json];
+
+    if (![object isKindOfClass:NSDictionary.class] || ![object[@"type"] isKindOfClass:NSString.class])
+    {
+        return nil;
+    }
+
+    NSString *nameString = object[@"type"];
+    const char *utf8 = nameString.UTF8String;
+    OnionmasqEventType type = OnionmasqTypeFromName(utf8, strlen(utf8));
+
+    if (!(mask & type))
+    {
+        return nil;
+    }
+
+    return [[self alloc] initWithType:type name:nameString payload:object];
+}
+
++ (nullable id)JSONObjectFromCString:(const char *)json
+{
+    const char *p = json;
+
+    id object = OnionmasqParseValue(&p, 0);
+
+    OnionmasqSkipWhitespace(&p);
+
+    // Trailing garbage.
+    if (*p)
+    {
+        return nil;
+    }
+
+    return object;
+}
+
+- (instancetype)initWithType:(OnionmasqEventType)type name:(NSString *)name payload:(NSDictionary<NSString *, id> *)payload
+{
+    self = [super init];
+
+    if (self)
+    {
+        _type = type;
+        _name = name;
+        _payload = payload;
+    }
+
+    return self;
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@: name=%@, payload=%@>", self.class, _name, _payload];
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
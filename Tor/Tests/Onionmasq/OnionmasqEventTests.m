@@ -0,0 +1,114 @@
+//
+//  OnionmasqEventTests.m
+//  Tor
+//
+//  Created by Benjamin Erhart on 17.10.26.
+//
+
+#import <XCTest/XCTest.h>
+#import <Tor/Tor.h>
+
+@interface OnionmasqEventTests : XCTestCase
+
+@end
+
+@implementation OnionmasqEventTests
+
+- (void)testJSON {
+    id object = [OnionmasqEvent JSONObjectFromCString:
+                 " {\"a\": [1, -2.5, 3e2, true, false, null], \"b\": \"x\\\"y\\\\z\\n\\u00e4\\ud83e\\uddc5\", \"c\": {}} "];
+
+    XCTAssertEqualObjects(object, (@{@"a": @[@1, @(-2.5), @300, @YES, @NO, NSNull.null],
+                                     @"b": @"x\"y\\z\nä\U0001F9C5",
+                                     @"c": @{}}));
+
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"{\"a\": 1"]);
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"{\"a\": 1} x"]);
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"[1,]"]);
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"\"unterminated"]);
+}
+
+- (void)testNumbers {
+    XCTAssertEqualObjects([OnionmasqEvent JSONObjectFromCString:"[0, -0, 10, 0.5, -1e-3, 1E+2]"],
+                          (@[@0, @0, @10, @0.5, @(-0.001), @100]));
+
+    XCTAssertEqualObjects([OnionmasqEvent JSONObjectFromCString:"[9223372036854775807, -9223372036854775808]"],
+                          (@[@(INT64_MAX), @(INT64_MIN)]));
+
+    // Too big for 64 bits: Falls back to a double instead of saturating.
+    NSArray<NSNumber *> *big = [OnionmasqEvent JSONObjectFromCString:"[9223372036854775808, -18446744073709551616]"];
+
+    XCTAssertEqual(big.count, 2);
+    XCTAssertEqual(strcmp(big[0].objCType, @encode(double)), 0);
+    XCTAssertEqual(big[0].doubleValue, 9223372036854775808.0);
+    XCTAssertEqual(big[1].doubleValue, -18446744073709551616.0);
+
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"[01]"]);
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"[-01]"]);
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"[00]"]);
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"[1.]"]);
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"[.5]"]);
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"[1e]"]);
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"[1-2]"]);
+    XCTAssertNil([OnionmasqEvent JSONObjectFromCString:"[-]"]);
+}
+
+- (void)testTagging {
+    OnionmasqEvent *event = [OnionmasqEvent eventFromCString:"{\"type\": \"BootstrapStatus\", \"is_ready_for_traffic\": true}"
+                                                        mask:OnionmasqEventTypeAll];
+
+    XCTAssertEqual(event.type, OnionmasqEventTypeBootstrap);
+    XCTAssertEqualObjects(event.name, @"BootstrapStatus");
+    XCTAssertEqualObjects(event.payload[@"is_ready_for_traffic"], @YES);
+
+    event = [OnionmasqEvent eventFromCString:"{\"NewConnection\": {\"proxy_src\": \"10.0.0.1:1234\"}}"
+                                        mask:OnionmasqEventTypeConnection];
+
+    XCTAssertEqual(event.type, OnionmasqEventTypeNewConnection);
+    XCTAssertEqualObjects(event.payload, @{@"proxy_src": @"10.0.0.1:1234"});
+
+    event = [OnionmasqEvent eventFromCString:"\"NewDirectory\"" mask:OnionmasqEventTypeAll];
+
+    XCTAssertEqual(event.type, OnionmasqEventTypeNewDirectory);
+    XCTAssertEqualObjects(event.payload, @{});
+
+    event = [OnionmasqEvent eventFromCString:"{\"x\": 1, \"type\": \"SomethingNew\"}" mask:OnionmasqEventTypeAll];
+
+    XCTAssertEqual(event.type, OnionmasqEventTypeOther);
+    XCTAssertEqualObjects(event.name, @"SomethingNew");
+}
+
+- (void)testMask {
+    XCTAssertNil([OnionmasqEvent eventFromCString:"{\"type\": \"BootstrapStatus\"}" mask:OnionmasqEventTypeConnection]);
+    XCTAssertNil([OnionmasqEvent eventFromCString:"{\"type\": \"SomethingNew\"}" mask:OnionmasqEventTypeBootstrap]);
+
+    // Filtered events aren't parsed at all, so even garbage after the type doesn't matter.
+    XCTAssertNil([OnionmasqEvent eventFromCString:"{\"type\": \"NewDirectory\", garbage" mask:OnionmasqEventTypeBootstrap]);
+    XCTAssertNil([OnionmasqEvent eventFromCString:"{\"type\": \"NewDirectory\", garbage" mask:OnionmasqEventTypeAll]);
+}
+
+- (void)testPerformance {
+    NSMutableString *relays = [NSMutableString new];
+
+    for (int i = 0; i < 50; i++)
+    {
+        [relays appendFormat:@"%@{\"rsa_identity\": \"$%040d\", \"ed_identity\": \"abc%d\", \"addresses\": [\"10.0.0.%d:9001\"]}",
+         i ? @"," : @"", i, i, i];
+    }
+
+    // Keep the string, so its UTF-8 buffer lives as long as the measurement.
+    NSString *connection = [NSString stringWithFormat:@"{\"type\": \"NewConnection\", \"proxy_src\": \"10.0.0.1:1234\", "
+                            "\"proxy_dst\": \"1.1.1.1:443\", \"tor_dst\": \"one.one.one.one:443\", \"circuit\": [%@]}", relays];
+
+    [self measureBlock:^{
+        const char *json = connection.UTF8String;
+
+        for (int i = 0; i < 10000; i++)
+        {
+            [OnionmasqEvent eventFromCString:json mask:OnionmasqEventTypeConnection];
+            [OnionmasqEvent eventFromCString:"{\"type\": \"BootstrapStatus\", \"bootstrap_percent\": 50}" mask:OnionmasqEventTypeConnection];
+        }
+    }];
+}
+
+@end
@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# Packs the directory cache of a bootstrapped Tor into `Tor/DirCache`, which the `DirCache`
+# subspec ships as resource bundle.
+#
+# Usage: ./dircache.sh <cache directory>
+#
+# The cache directory is the `CacheDirectory` (or `DataDirectory`, if not set) of a Tor which
+# recently finished bootstrapping, e.g. from the Example app or a `tor` on the build machine.
+#
+# The consensus is signed by the directory authorities and Tor verifies it, when it loads the cache.
+# `manifest.json` contains its `valid-after` time, to tell, which cache is more recent, and SHA-256
+# digests of all files, to detect corrupted copies.
+
+SRC="$1"
+DST="$(cd "$(dirname "$0")" && pwd)/DirCache"
+
+if [[ ! -s "${SRC}/cached-microdesc-consensus" ]]; then
+    echo "error: No consensus found in \"${SRC}\". Usage: $0 <cache directory>" >&2
+    exit 1
+fi
+
+VALID_AFTER=$(grep -m 1 '^valid-after ' "${SRC}/cached-microdesc-consensus" | cut -d ' ' -f 2-)
+
+if [[ -z "${VALID_AFTER}" ]]; then
+    echo "error: \"${SRC}/cached-microdesc-consensus\" is no consensus." >&2
+    exit 1
+fi
+
+rm -rf "${DST}"
+mkdir -p "${DST}"
+
+FILES=""
+
+for FILE in cached-certs cached-microdesc-consensus cached-microdescs cached-microdescs.new
+do
+    if [[ ! -s "${SRC}/${FILE}" ]]; then
+        continue
+    fi
+
+    cp "${SRC}/${FILE}" "${DST}/${FILE}"
+
+    DIGEST=$(shasum -a 256 "${DST}/${FILE}" | cut -d ' ' -f 1)
+
+    FILES="${FILES}${FILES:+,}\n    \"${FILE}\": \"${DIGEST}\""
+done
+
+printf '{\n  "valid-after": "%s",\n  "files": {%b\n  }\n}\n' "${VALID_AFTER}" "${FILES}" > "${DST}/manifest.json"
+
+echo "Packed directory cache valid after ${VALID_AFTER} UTC into \"${DST}\"."
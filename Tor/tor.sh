@@ -13,7 +13,30 @@ ARCHS=($ARCHS)
 PATH=$PATH:/usr/local/bin:/usr/local/opt/gettext/bin:/usr/local/opt/automake/bin:/usr/local/opt/aclocal/bin:/opt/homebrew/bin
 
 ## Apply patches:
-git apply --quiet ../mmap-cache.patch
+# Set TOR_SKIP_PATCHES=1 to build an unpatched Tor, e.g. to compare against it with
+# TORBootstrapBenchmarks. Needs a clean build to take effect.
+for PATCH in ../patches/*.patch; do
+    # No patches at all leaves the unexpanded pattern.
+    [[ -e "$PATCH" ]] || continue
+
+    # Already applied by an earlier build?
+    if git apply --reverse --check "$PATCH" 2> /dev/null; then
+        if [[ "${TOR_SKIP_PATCHES}" = "1" ]]; then
+            git apply --reverse "$PATCH"
+        fi
+
+        continue
+    fi
+
+    if [[ "${TOR_SKIP_PATCHES}" = "1" ]]; then
+        continue
+    fi
+
+    if ! git apply "$PATCH"; then
+        echo "error: $PATCH doesn't apply to this Tor version anymore. Update or remove it." >&2
+        exit 1
+    fi
+done
 
 # If there is a space in BUILT_PRODUCTS_DIR, make a symlink without a space and use that.
 if [[ "${BUILT_PRODUCTS_DIR}" =~ \  ]]; then